@@ -0,0 +1,85 @@
+#include "pipeline.h"
+#include <Arduino.h>
+
+#ifndef acquisition_h
+#define acquisition_h
+
+#define MPU6050_ADDR 0x68
+#define HMC5883_ADDR 0x1E
+
+// The MPU6050 samples into its FIFO at SAMPLE_RATE; the IMU task is woken
+// once per ACQ_BURST frames and drains them in a single I2C read. A wake
+// is a control period (CONTROL_DECIMATION in executive.h).
+#define ACQ_BURST 4
+#define ACQ_MAX_FRAMES 32
+#define ACQ_TIMEOUT_MS (4 * 1000 * ACQ_BURST / SAMPLE_RATE)
+// I2C time allowed per cycle: half the time between two bursts
+#define ACQ_BUDGET_US (500000 * ACQ_BURST / SAMPLE_RATE)
+
+enum HMCRate {
+  HMC_RATE_15HZ = 0b100,
+  HMC_RATE_30HZ = 0b101,
+  HMC_RATE_75HZ = 0b110,
+};
+
+struct AcquisitionStats {
+  uint32_t frames;
+  uint32_t drains;
+  uint32_t overflows;
+  uint32_t magReads;
+  uint32_t staleCycles;
+};
+
+struct AcquisitionResult {
+  int frames;    // complete frames copied, MPU_BURST_LEN each
+  bool magFresh; // magBuf holds a new reading
+  bool stale;    // the bus did not deliver in time, nothing new this cycle
+};
+
+// FIFO frames carry no time of their own, they are spaced by the MPU's
+// oscillator, which is only within a few percent of SAMPLE_RATE. The sample
+// clock follows the wake-ups of the IMU task with a phase-locked loop, so
+// every frame gets a timestamp one measured period after the previous one.
+// A wake further than CLOCK_RESYNC_US from the clock (frames lost to an
+// overflow, a long stall) restarts it at the wake.
+#define CLOCK_PHASE_GAIN 0.1f
+#define CLOCK_PERIOD_GAIN 0.01f
+#define CLOCK_RESYNC_US (2 * ACQ_BURST * 1000000 / SAMPLE_RATE)
+
+// Wake-up jitter, |wake interval - ACQ_BURST periods|, in TIMING_BIN_US
+// bins; the last one takes everything beyond. An overrun is a wake that
+// found more than ACQ_BURST frames, i.e. at least one sample late.
+#define TIMING_BINS 12
+#define TIMING_BIN_US 100
+
+struct TimingStats {
+  uint32_t wakes;
+  uint32_t overruns;
+  uint32_t resyncs;
+  uint32_t maxCycleUs; // IMU task busy time, the budget is ACQ_BURST periods
+  float periodUs;      // measured sample period
+  uint32_t jitter[TIMING_BINS];
+};
+
+extern AcquisitionStats acqStats;
+extern TimingStats timingStats;
+
+// Configures sample rate, DLPF, FIFO (accel + temp + gyro, the same 14-byte
+// layout as a 0x3B burst) and the data-ready interrupt. I2C bypass is kept
+// so the HMC5883 stays reachable.
+bool setupMPUFifo(uint16_t rateHz);
+bool setupHMCContinuous(HMCRate rate);
+
+// One cycle through the I2C engine: FIFO count plus the magnetometer when
+// wantMag, then up to maxFrames FIFO frames. Never waits past deadline, the
+// FIFO resets after an overflow or a broken read are queued the same way.
+AcquisitionResult acquire(uint8_t *frames, int maxFrames, uint8_t *magBuf,
+                          bool wantMag, uint32_t deadline);
+
+// Timestamps (micros()) for the frames of the acquire() of a wake at
+// wakeTime, oldest first. Called on every wake, with 0 frames if none.
+void stampFrames(uint32_t wakeTime, int frames, uint32_t *stamps);
+// Busy time of one IMU task cycle, from the wake to going back to sleep.
+void recordCycleTime(uint32_t us);
+
+#endif
@@ -0,0 +1,85 @@
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef actuator_h
+#define actuator_h
+
+// PWM outputs for the rudder servo and the ESC, in microseconds. Control
+// code commands a pulse width whenever it runs; actuatorTick() runs on its
+// own timer at ACTUATOR_RATE, takes the newest command of each channel,
+// applies its range and slew limits and hands the pulse to halPWMWrite().
+// LEDC only latches a new duty at the end of a frame, so two updates per
+// 50 Hz frame keep what the timer adds to the latency under half a frame.
+#define ACTUATOR_RATE 100
+#define ACTUATOR_MAX_ARM_STEPS 4
+// commands further apart than this are steps, not a stream to smooth
+#define ACTUATOR_INTERPOLATE_MAX_US 100000
+
+// The mapping the Servo library used for degrees, so calibration.servoMiddle
+// keeps its meaning.
+#define ACTUATOR_SERVO_MIN_US 544
+#define ACTUATOR_SERVO_MAX_US 2400
+
+// The ESC's stop, also where the missions' speeds count from.
+#define ACTUATOR_MOTOR_NEUTRAL_US 1500
+
+inline float servoDegreesToUs(float degrees) {
+  return ACTUATOR_SERVO_MIN_US +
+         degrees * (ACTUATOR_SERVO_MAX_US - ACTUATOR_SERVO_MIN_US) / 180;
+}
+
+enum ActuatorChannel : uint8_t {
+  ACT_SERVO,
+  ACT_MOTOR,
+  ACT_COUNT,
+};
+
+struct ActuatorArmStep {
+  uint16_t us;
+  uint16_t ms;
+};
+
+struct ActuatorConfig {
+  uint8_t pin;
+  uint16_t hz;        // PWM frame rate
+  float minUs, maxUs; // commands are clamped into this
+  float slewUsPerS;   // 0 for no limit
+  // commands that come slower than the outputs are ramped into over the
+  // time between them instead of stepped
+  bool interpolate;
+  // pulses held in order by actuatorArm() before commands go out, for ESCs
+  // that want to see neutral or a throttle range first
+  uint8_t armSteps;
+  ActuatorArmStep arming[ACTUATOR_MAX_ARM_STEPS];
+};
+
+enum ActuatorState : uint8_t {
+  ACT_DISARMED, // no pulses
+  ACT_ARMING,
+  ACT_ARMED,
+};
+
+struct ActuatorStats {
+  float output; // us, last written
+  uint32_t clamped;     // commands out of range
+  uint32_t slewLimited; // ticks the slew limit held the output back
+};
+
+extern ActuatorStats actuatorStats[ACT_COUNT];
+extern const char *const actuatorNames[ACT_COUNT];
+
+bool actuatorBegin(ActuatorChannel channel, const ActuatorConfig &config);
+// Starts the arming sequence on the next tick, the channel is live right
+// away without one.
+void actuatorArm(ActuatorChannel channel);
+ActuatorState actuatorState(ActuatorChannel channel);
+
+// One writer per channel, the command is a single-writer SeqLock: in the
+// firmware that is the IMU task (control group and packet handlers), or
+// setup() and loop() while there is no IMU task. now is micros(). Commands
+// while arming are kept, the newest one goes out once the sequence is over.
+void actuatorCommand(ActuatorChannel channel, float us, uint32_t now);
+// From the output timer only.
+void actuatorTick(uint32_t now);
+
+#endif
@@ -0,0 +1,76 @@
+#include <Arduino.h>
+
+#ifndef autotune_h
+#define autotune_h
+
+// Relay-feedback identification of the heading loop (Åström–Hägglund). The
+// servo is switched between +amplitude and -amplitude whenever the heading
+// error leaves the hysteresis band, which settles into a limit cycle at the
+// loop's ultimate period Tu. With a the error amplitude and d the relay
+// amplitude, the describing function gives the ultimate gain
+//   Ku = 4 d / (pi * sqrt(a^2 - h^2)).
+// The first period is a transient and is discarded.
+#define AUTOTUNE_TIMEOUT_S 120
+#define AUTOTUNE_MAX_ERROR 60.0f // degrees, gives up if the boat runs away
+// periods of a few seconds, more would not fit in the timeout anyway
+#define AUTOTUNE_MAX_CYCLES 20
+
+enum AutotuneRule : uint8_t {
+  TUNE_ZIEGLER_NICHOLS, // Kp = 0.6 Ku, Ti = Tu / 2, Td = Tu / 8
+  TUNE_TYREUS_LUYBEN,   // Kp = Ku / 2.2, Ti = 2.2 Tu, Td = Tu / 6.3
+};
+
+enum AutotunePhase : uint8_t { AT_IDLE, AT_RUNNING, AT_DONE, AT_FAILED };
+
+struct AutotuneConfig {
+  float amplitude;  // servo degrees
+  float hysteresis; // degrees of heading error
+  uint8_t cycles;   // periods averaged after the first, at most
+                    // AUTOTUNE_MAX_CYCLES
+  AutotuneRule rule;
+};
+
+// kp, ki, kd in the units HeadingPID takes: ki = Kp / Ti, kd = Kp * Td.
+struct AutotuneResult {
+  float ku, tu;
+  float kp, ki, kd;
+};
+
+class RelayAutotuner {
+public:
+  void start(const AutotuneConfig &config, uint32_t timestamp);
+  void stop();
+
+  // Relay output for one sample of the heading error tickPID() would see
+  // (headingError()); 0 once the experiment is over.
+  float update(float error, uint32_t timestamp);
+
+  AutotunePhase getPhase() const { return phase; }
+  bool running() const { return phase == AT_RUNNING; }
+  float getProgress() const;
+  const AutotuneResult &getResult() const { return result; }
+  // Why the last run failed, NULL otherwise.
+  const char *getFailure() const { return failure; }
+
+private:
+  void fail(const char *reason);
+  void finish();
+
+  AutotuneConfig config = {};
+  AutotunePhase phase = AT_IDLE;
+  const char *failure = NULL;
+  float output = 0;
+
+  uint32_t startTime = 0, lastRise = 0;
+  float peakHigh = 0, peakLow = 0;
+  uint8_t rises = 0;
+  float periodSum = 0, amplitudeSum = 0;
+  float minPeriod = 0, maxPeriod = 0;
+
+  AutotuneResult result = {};
+};
+
+void autotuneGains(AutotuneRule rule, float ku, float tu,
+                   AutotuneResult *result);
+
+#endif
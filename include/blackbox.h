@@ -0,0 +1,50 @@
+#include "telemetry.h"
+#include <Arduino.h>
+
+#ifndef blackbox_h
+#define blackbox_h
+
+// Compact log format shared by the recorder and the native decoder.
+//
+// A log is "BBX2", a uint16 length + BlackboxHeader, then blocks of uint16
+// length + records. Every field
+// of a record is quantized to an integer (sensors back to their register
+// counts), stored as the zigzag varint of its difference to the previous
+// record, after a flags byte and the varint timestamp delta. Each block
+// starts from zero, so a block can be decoded without the ones before it.
+
+#define BB_MAGIC "BBX2"
+#define BB_FIELDS 19
+#define BB_MAX_RECORD (1 + 5 + BB_FIELDS * 5)
+
+#define BB_STALE 0x01
+#define BB_ANCHORING 0x02
+#define BB_MISSION 0x04 // with BB_ANCHORING, yawAnchor follows the mission
+#define BB_CONTROL 0x08 // the control group ran on this sample, before it
+
+// What the control loop started the run with, so a replay can continue from
+// the same calibration and PID state. Raw struct bytes: only a decoder built
+// from the same sources reads it, others skip it by its length.
+struct BlackboxHeader {
+  CalibrationStore calibration;
+  HeadingPID pid;
+};
+
+struct BlackboxCodec {
+  uint32_t timestamp;
+  int32_t fields[BB_FIELDS];
+};
+
+void blackboxBeginBlock(BlackboxCodec *codec);
+
+// Writes at most BB_MAX_RECORD bytes, returns the number written.
+size_t blackboxEncode(BlackboxCodec *codec, const TelemetrySample *sample,
+                      uint8_t flags, uint8_t *out);
+
+// Fills the estimator timestamp, stale, yaw, yawRate and raw fields, the
+// anchor, PID terms and outputs. Returns the bytes consumed, 0 if the record
+// is cut off.
+size_t blackboxDecode(BlackboxCodec *codec, const uint8_t *in, size_t len,
+                      TelemetrySample *sample, uint8_t *flags);
+
+#endif
@@ -0,0 +1,33 @@
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef boot_h
+#define boot_h
+
+// Boot timeline: when each startup phase was first reached, in ms since
+// power on. Phases are marked from whichever task reaches them and read
+// without a lock, as with the other stats.
+#define BOOT_PHASE_LIST(P)                                                     \
+  P(setup)        /* params, recorder and PID loaded, servo centred */         \
+  P(imu)          /* sensors configured, IMU task running */                   \
+  P(heading)      /* first fused sample */                                     \
+  P(mode)         /* button window closed: web control or autopilot */         \
+  P(wifi)         /* joined the access point */                                \
+  P(softap)       /* gave up on it and opened an access point of its own */    \
+  P(controllable) /* web control: server listening on a network */
+
+#define BOOT_ID(name) BOOT_##name,
+enum BootPhase : uint8_t { BOOT_PHASE_LIST(BOOT_ID) BOOT_PHASE_COUNT };
+#undef BOOT_ID
+
+extern uint32_t bootTimeline[BOOT_PHASE_COUNT]; // 0 until reached
+extern const char *const bootPhaseNames[BOOT_PHASE_COUNT];
+
+// Only the first mark of a phase counts.
+void bootMark(BootPhase phase);
+
+// "boot: setup 41 ms, imu 180 ms, ...", the phases reached so far. Returns
+// the length written, truncated to size - 1.
+size_t formatBootTimeline(char *buf, size_t size);
+
+#endif
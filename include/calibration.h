@@ -1,5 +1,4 @@
 #include <Arduino.h>
-#include <Preferences.h>
 
 #ifndef calibration_h
 #define calibration_h
@@ -20,10 +19,6 @@ struct CalibrationStore {
   float maxAPSpeed;
 };
 
-extern Preferences calPrefs;
 extern CalibrationStore calibration;
 
-void saveBiasStore(CalibrationStore *store);
-bool setupBiasesStorage();
-
 #endif
\ No newline at end of file
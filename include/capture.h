@@ -0,0 +1,31 @@
+#include "pipeline.h"
+#include <Arduino.h>
+
+#ifndef capture_h
+#define capture_h
+
+// Raw capture stream for calibration datasets. While enabled, every sample
+// the IMU task reads goes out unfiltered as register counts, CAPTURE_BATCH
+// samples per 0x31 frame:
+//   0x31, uint32 sequence of the first sample, uint32 its timestamp (us),
+//   uint8 count, then per sample int16 ax ay az gx gy gz mx my mz and a
+//   flags byte (CAPTURE_MAG_FRESH).
+// Sequence numbers count captured samples, so a frame lost on the way shows
+// up as a jump; a FIFO overflow on the sensor shows up as a timestamp gap.
+#define CAPTURE_BATCH 10
+#define CAPTURE_HEADER_LEN (1 + 4 + 4 + 1)
+#define CAPTURE_SAMPLE_LEN (9 * 2 + 1)
+
+#define CAPTURE_MAG_FRESH 0x01
+
+void setCapture(bool enabled);
+bool captureEnabled();
+
+// IMU task only. timestamp as in EstimatorState.
+void captureSample(uint32_t timestamp, const RawICUData *raw, bool magFresh);
+
+// Inverse of decodeMPU6050/decodeHMC5883; exact for values they produced.
+void rawToCounts(const RawICUData *raw, int16_t *counts);
+void countsToRaw(const int16_t *counts, RawICUData *raw);
+
+#endif
@@ -0,0 +1,96 @@
+#include "pipeline.h"
+#include "telemetry.h"
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef executive_h
+#define executive_h
+
+// Rate groups, each a list of jobs run at a fixed rate and priority.
+//
+// sensor and control run on the IMU task, on the sample clock: control at
+// most once per wake, on its newest sample, once CONTROL_DECIMATION fresh
+// samples have built up; then sensor after every sample (and once per stale
+// cycle). ACQ_BURST is CONTROL_DECIMATION, so that is every wake unless one
+// comes early or stale. A control task of its own would not help, a task
+// below the IMU task would only run once the whole burst is done.
+//
+// telemetry and housekeeping have periodic tasks of their own. Priorities
+// are rate monotonic and the IMU task's is above AsyncTCP's (10), so a busy
+// websocket cannot delay a control cycle; the network and loop() get what
+// is left. The telemetry group runs at TLM_RATE, which subscription
+// decimations are relative to.
+#define CONTROL_RATE 50
+#define CONTROL_DECIMATION (SAMPLE_RATE / CONTROL_RATE)
+#define EXEC_IMU_PRIORITY 12
+
+#define RATE_GROUP_LIST(G)                                                     \
+  G(sensor, SAMPLE_RATE, EXEC_IMU_PRIORITY)                                    \
+  G(control, CONTROL_RATE, EXEC_IMU_PRIORITY)                                  \
+  G(telemetry, TLM_RATE, 5)                                                    \
+  G(housekeeping, 1, 2)
+
+#define GROUP_ID(name, rate, priority) GROUP_##name,
+enum RateGroupId : uint8_t { RATE_GROUP_LIST(GROUP_ID) RATE_GROUP_COUNT };
+#undef GROUP_ID
+
+struct RateContext {
+  uint32_t release; // us: sample timestamp, or micros() at the task's wake
+  float dt;         // s since the group's previous release, 0 when stale
+  bool stale;       // sensor: the cycle delivered no sample
+  uint8_t released; // groups released with this sample, 1 << RateGroupId
+};
+
+// Jobs run at every release of their group while active, in the order they
+// were added; one that returns false is deactivated. start() and stop() are
+// safe from any task, a job started from its own group's task runs from its
+// next release on.
+class Job {
+public:
+  typedef bool (*Run)(const RateContext &ctx);
+
+  Job(const char *name, RateGroupId group, Run run)
+      : name(name), group(group), run(run) {}
+
+  void start() { enabled = true; }
+  void stop() { enabled = false; }
+  bool active() const { return enabled; }
+
+  const char *const name;
+  const RateGroupId group;
+
+private:
+  friend void rateGroupRun(RateGroupId id, const RateContext &ctx);
+  friend void executiveAdd(Job *job);
+
+  Run run;
+  std::atomic<bool> enabled{false};
+  Job *next = NULL;
+};
+
+// At setup, before executiveStart().
+void executiveAdd(Job *job);
+// Starts the tasks of the clock driven groups.
+bool executiveStart();
+// IMU task, after every fused sample and once per stale cycle; newest on
+// the last sample of the wake.
+void executiveSample(const EstimatorState &state, bool newest);
+
+// One release of a group: runs its active jobs and accounts for them. A
+// release whose jobs take longer than a period, or that comes more than one
+// and a half periods after the previous one, is an overrun.
+void rateGroupRun(RateGroupId id, const RateContext &ctx);
+
+struct RateGroupStats {
+  uint32_t releases, overruns;
+  uint32_t lastUs, maxUs; // busy time of one release
+  uint32_t busyUs;        // total, wraps
+  float utilization;      // percent of the CPU over the last second
+};
+
+extern RateGroupStats rateGroupStats[RATE_GROUP_COUNT];
+extern const char *const rateGroupNames[RATE_GROUP_COUNT];
+extern const uint16_t rateGroupRates[RATE_GROUP_COUNT]; // Hz
+
+#endif
@@ -0,0 +1,141 @@
+#include <Arduino.h>
+
+#ifndef fastmath_h
+#define fastmath_h
+
+// Math kernels for the control path. The ESP32-C3 has no FPU: every float
+// op is a libgcc call, divides and fmodf are the slowest of them, and libm
+// sinf/cosf/atan2f do full-precision range reduction. With FAST_MATH (the
+// default) the math*() wrappers below use the polynomial kernels and the
+// Q16 calibration transform; build with -D FAST_MATH=0 for the float/libm
+// reference. `program math` measures both.
+#ifndef FAST_MATH
+#define FAST_MATH 1
+#endif
+
+// Error bounds, checked by `program math` against libm:
+//   fastSin/fastCos  |err| < 3e-7 for |x| < 100 rad
+//   fastAtan2        |err| < 1e-5 rad (0.0006 deg)
+//   fastWrap360/180  exact up to float rounding of the multiple of 360
+
+#define FM_PI 3.14159265358979f
+#define FM_TWO_PI 6.28318530717959f
+
+// Cody-Waite reduction to [-pi, pi]: 2 pi split into an exact 6.28125 and a
+// small remainder, so the reduction itself adds no error for |x| < 100.
+inline float fastReduceAngle(float x) {
+  float n = floorf(x * (1 / FM_TWO_PI) + 0.5f);
+  return (x - n * 6.28125f) - n * 1.9353071795864769e-3f;
+}
+
+// Odd Taylor polynomial to x^11 on [-pi/2, pi/2]; its remainder at pi/2 is
+// (pi/2)^13 / 13! = 5.7e-8.
+inline float fastSinHalfPi(float x) {
+  float x2 = x * x;
+  return x *
+         (1 + x2 * (-1.0f / 6 +
+                    x2 * (1.0f / 120 +
+                          x2 * (-1.0f / 5040 +
+                                x2 * (1.0f / 362880 +
+                                      x2 * (-1.0f / 39916800))))));
+}
+
+// sin(pi - x) = sin(x) and cos(x) = sin(pi/2 - |x|) fold into [-pi/2, pi/2]
+inline float fastSin(float x) {
+  x = fastReduceAngle(x);
+  if (x > FM_PI / 2)
+    x = FM_PI - x;
+  else if (x < -FM_PI / 2)
+    x = -FM_PI - x;
+  return fastSinHalfPi(x);
+}
+
+inline float fastCos(float x) {
+  return fastSinHalfPi(FM_PI / 2 - fabsf(fastReduceAngle(x)));
+}
+
+// atan on [0, 1] (minimax, 11th order), octants by swapping and mirroring.
+// One divide remains for the ratio.
+inline float fastAtan2(float y, float x) {
+  float ax = fabsf(x), ay = fabsf(y);
+  float mx = ax > ay ? ax : ay, mn = ax > ay ? ay : ax;
+  if (mx == 0)
+    return 0;
+
+  float z = mn / mx, z2 = z * z;
+  float a =
+      z * (0.99997726f +
+           z2 * (-0.33262347f +
+                 z2 * (0.19354346f +
+                       z2 * (-0.11643287f +
+                             z2 * (0.05265332f + z2 * -0.01172120f)))));
+
+  if (ay > ax)
+    a = FM_PI / 2 - a;
+  if (x < 0)
+    a = FM_PI - a;
+  return y < 0 ? -a : a;
+}
+
+// fmodf-free wraps: one multiply and a floor instead of a divide loop.
+inline float fastWrap360(float deg) {
+  deg -= 360.0f * floorf(deg * (1.0f / 360));
+  return deg < 360.0f ? deg : 0.0f;
+}
+
+inline float fastWrap180(float deg) {
+  return deg - 360.0f * floorf(deg * (1.0f / 360) + 0.5f);
+}
+
+// Q16.16 fixed point.
+typedef int32_t q16_t;
+
+// truncates, within 2^-16 of v
+inline q16_t toQ16(float v) { return (q16_t)(v * 65536.0f); }
+inline float fromQ16(q16_t v) { return v * (1.0f / 65536); }
+inline q16_t mulQ16(q16_t a, q16_t b) { return ((int64_t)a * b) >> 16; }
+
+// out = m * (in - offset) in Q16: 3 float->int and 3 int->float conversions
+// and 9 integer multiplies instead of 12 soft-float ops. Inputs must stay
+// within +-32768 (the magnetometer is within +-800 uT).
+struct Q16Affine3 {
+  q16_t offset[3];
+  q16_t m[3][3];
+
+  void set(const float *newOffset, const float (*newM)[3]) {
+    for (int i = 0; i < 3; i++) {
+      offset[i] = toQ16(newOffset[i]);
+      for (int j = 0; j < 3; j++)
+        m[i][j] = toQ16(newM[i][j]);
+    }
+  }
+
+  void apply(const float *in, float *out) const {
+    q16_t v[3];
+    for (int i = 0; i < 3; i++)
+      v[i] = toQ16(in[i]) - offset[i];
+    for (int i = 0; i < 3; i++)
+      out[i] = fromQ16(mulQ16(m[i][0], v[0]) + mulQ16(m[i][1], v[1]) +
+                       mulQ16(m[i][2], v[2]));
+  }
+};
+
+#if FAST_MATH
+inline float mathSin(float x) { return fastSin(x); }
+inline float mathCos(float x) { return fastCos(x); }
+inline float mathAtan2(float y, float x) { return fastAtan2(y, x); }
+inline float mathWrap360(float deg) { return fastWrap360(deg); }
+inline float mathWrap180(float deg) { return fastWrap180(deg); }
+#else
+inline float mathSin(float x) { return sinf(x); }
+inline float mathCos(float x) { return cosf(x); }
+inline float mathAtan2(float y, float x) { return atan2f(y, x); }
+inline float mathWrap360(float deg) {
+  return fmodf(fmodf(deg, 360.0f) + 360.0f, 360.0f);
+}
+inline float mathWrap180(float deg) {
+  return fmodf(deg + 540.0f, 360.0f) - 180.0f;
+}
+#endif
+
+#endif
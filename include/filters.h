@@ -0,0 +1,132 @@
+#include "fastmath.h"
+#include <Arduino.h>
+#include <algorithm>
+
+#ifndef filters_h
+#define filters_h
+
+// Filters for angles in degrees [0, 360). All of them handle the 359 -> 0
+// wrap, which a plain moving average does not.
+
+inline float wrap180(float deg) {
+  while (deg >= 180.0f)
+    deg -= 360.0f;
+  while (deg < -180.0f)
+    deg += 360.0f;
+  return deg;
+}
+
+inline float wrap360(float deg) {
+  while (deg >= 360.0f)
+    deg -= 360.0f;
+  while (deg < 0.0f)
+    deg += 360.0f;
+  return deg;
+}
+
+// Sliding-window mean on the unit circle. The sin/cos of every sample is kept
+// so the running sums update in O(1): one sin/cos pair and one atan2 per
+// sample regardless of the window length. The sums are rebuilt from the stored
+// values once per window to stop float drift from accumulating.
+template <int N> class CircularMean {
+public:
+  float update(float deg) {
+    float rad = deg * DEG_TO_RAD;
+    float s = mathSin(rad), c = mathCos(rad);
+
+    if (count == N) {
+      sumSin -= sins[index];
+      sumCos -= coss[index];
+    } else {
+      count++;
+    }
+
+    sins[index] = s;
+    coss[index] = c;
+    sumSin += s;
+    sumCos += c;
+
+    if (++index == N) {
+      index = 0;
+      resum();
+    }
+
+    return wrap360(mathAtan2(sumSin, sumCos) * RAD_TO_DEG);
+  }
+
+  // Length of the mean resultant vector: 1 for a steady heading, towards 0
+  // when the window is spread all around the circle.
+  float concentration() const {
+    return count ? sqrtf(sumSin * sumSin + sumCos * sumCos) / count : 0.0f;
+  }
+
+  void reset() {
+    index = count = 0;
+    sumSin = sumCos = 0.0f;
+  }
+
+private:
+  void resum() {
+    sumSin = sumCos = 0.0f;
+    for (int i = 0; i < count; i++) {
+      sumSin += sins[i];
+      sumCos += coss[i];
+    }
+  }
+
+  float sins[N], coss[N];
+  float sumSin = 0.0f, sumCos = 0.0f;
+  int index = 0, count = 0;
+};
+
+// Exponential moving average that steps along the shortest arc, no trig.
+class CircularEMA {
+public:
+  explicit CircularEMA(float alpha) : alpha(alpha) {}
+
+  float update(float deg) {
+    if (!primed) {
+      value = wrap360(deg);
+      primed = true;
+    } else {
+      value = wrap360(value + alpha * wrap180(deg - value));
+    }
+    return value;
+  }
+
+  void setAlpha(float newAlpha) { alpha = newAlpha; }
+  void reset() { primed = false; }
+
+private:
+  float alpha;
+  float value = 0.0f;
+  bool primed = false;
+};
+
+// Sliding-window median. Samples are unwrapped around the newest one before
+// selecting, so a window straddling north does not split into two clusters.
+// Robust against single-sample magnetometer spikes; O(N) without trig.
+template <int N> class CircularMedian {
+public:
+  float update(float deg) {
+    window[index] = wrap360(deg);
+    index = (index + 1) % N;
+    if (count < N)
+      count++;
+
+    float centred[N];
+    for (int i = 0; i < count; i++)
+      centred[i] = wrap180(window[i] - deg);
+
+    std::nth_element(centred, centred + count / 2, centred + count);
+    return wrap360(deg + centred[count / 2]);
+  }
+
+  void reset() { index = count = 0; }
+
+private:
+  float window[N];
+  int index = 0, count = 0;
+};
+
+#endif
@@ -0,0 +1,104 @@
+#include "fastmath.h"
+#include "pipeline.h"
+#include <Adafruit_AHRS.h>
+#include <Arduino.h>
+
+#ifndef fusion_h
+#define fusion_h
+
+// Fusion backends for fuseSample(). Each one is a plain class with
+//   void begin(float sampleRate);
+//   void update(const CalibratedICUData &c, float dt); // dps, g, uT; s
+//   float getYaw();                          // degrees, [0, 360)
+//   void getQuaternion(float *w, float *x, float *y, float *z);
+//   static const char *name();
+// and fuseSample is a template over it, so nothing is dispatched at run time.
+// The firmware uses FusionFilter, picked with -D FUSION_BACKEND=...;
+// `program fusion` compares all of them on the same data.
+#define FUSION_NXP 0
+#define FUSION_MADGWICK 1
+#define FUSION_MAHONY 2
+#define FUSION_COMPLEMENTARY 3
+
+#ifndef FUSION_BACKEND
+#define FUSION_BACKEND FUSION_NXP
+#endif
+
+// Adafruit_AHRS filters. Their methods are virtual (Adafruit_AHRS_Fusion-
+// Interface); the qualified calls bind them statically. They integrate over
+// the period given to begin(), the rates are scaled so they integrate dt.
+template <typename AHRS, const char *Name> class AHRSFusion {
+public:
+  void begin(float sampleRate) {
+    rate = sampleRate;
+    ahrs.AHRS::begin(sampleRate);
+  }
+
+  void update(const CalibratedICUData &c, float dt) {
+    float k = dt * rate;
+    ahrs.AHRS::update(c.gx * k, c.gy * k, c.gz * k, c.ax, c.ay, c.az, c.mx,
+                      c.my, c.mz);
+  }
+
+  float getYaw() { return ahrs.AHRS::getYaw(); }
+
+  void getQuaternion(float *w, float *x, float *y, float *z) {
+    ahrs.AHRS::getQuaternion(w, x, y, z);
+  }
+
+  static const char *name() { return Name; }
+
+private:
+  AHRS ahrs;
+  float rate = SAMPLE_RATE;
+};
+
+extern const char fusionNameNXP[], fusionNameMadgwick[], fusionNameMahony[];
+
+typedef AHRSFusion<Adafruit_NXPSensorFusion, fusionNameNXP> NXPFusion;
+typedef AHRSFusion<Adafruit_Madgwick, fusionNameMadgwick> MadgwickFusion;
+typedef AHRSFusion<Adafruit_Mahony, fusionNameMahony> MahonyFusion;
+
+// Heading of the horizontal magnetic field about up (unit, a / |a| of a
+// resting sensor): 0 along the body x axis projected on the horizontal
+// plane, increasing with rotation about up, i.e. with gz on a level board.
+inline float tiltHeading(const CalibratedICUData &c, const float *up) {
+  float along = c.mx * up[0] + c.my * up[1] + c.mz * up[2];
+  float e1 = c.mx - up[0] * along;
+  float e2 = c.my * up[2] - c.mz * up[1]; // (up x x) . m
+  return mathAtan2(-e2, e1) * RAD_TO_DEG;
+}
+
+// Cheapest of the lot: up is the low-passed accelerometer, the gyro rate
+// about up is integrated and pulled towards tiltHeading() with a time
+// constant of COMPLEMENTARY_MAG_S. No trig besides one atan2 per update.
+#define COMPLEMENTARY_TILT_S 0.5f
+#define COMPLEMENTARY_MAG_S 2.0f
+
+class ComplementaryFusion {
+public:
+  void begin(float sampleRate) { started = false; }
+  void update(const CalibratedICUData &c, float dt);
+  float getYaw() { return yaw; }
+  void getQuaternion(float *w, float *x, float *y, float *z);
+  static const char *name() { return "complementary"; }
+
+private:
+  float up[3] = {0, 0, 1};
+  float yaw = 0;
+  bool started = false;
+};
+
+#if FUSION_BACKEND == FUSION_NXP
+typedef NXPFusion FusionFilter;
+#elif FUSION_BACKEND == FUSION_MADGWICK
+typedef MadgwickFusion FusionFilter;
+#elif FUSION_BACKEND == FUSION_MAHONY
+typedef MahonyFusion FusionFilter;
+#elif FUSION_BACKEND == FUSION_COMPLEMENTARY
+typedef ComplementaryFusion FusionFilter;
+#else
+#error "unknown FUSION_BACKEND"
+#endif
+
+#endif
@@ -0,0 +1,92 @@
+#include "calibration.h"
+#include "pipeline.h"
+#include <Arduino.h>
+
+#ifndef gyro_bias_h
+#define gyro_bias_h
+
+// Gyro bias tracked while the boat runs. The bias of a sample is
+//   calibration.gyro + slope * (temperature - reference) + offset
+// where the model (calibration.gyro, GyroTempModel) is persisted and offset
+// is the correction learnt since boot:
+//  - still windows (gyro and accel steady for a second) measure the bias of
+//    all three axes directly and feed the temperature fit;
+//  - heading windows compare the gyro rate about gravity, integrated, with
+//    the change of the tilt-compensated magnetometer heading, which measures
+//    the vertical component while turning.
+#define GYRO_STILL_SAMPLES SAMPLE_RATE
+#define GYRO_STILL_RANGE 1.5f // dps, max - min of each axis within a window
+#define GYRO_STILL_RATE 3.0f  // dps, from the current bias
+#define GYRO_STILL_ACCEL 0.03f // g, max - min of |accel|
+#define GYRO_STILL_GAIN 0.3f
+
+#define GYRO_HEADING_SAMPLES (20 * SAMPLE_RATE)
+#define GYRO_HEADING_MAX_ERROR 1.0f // dps, larger is a disturbed magnetometer
+#define GYRO_HEADING_MAX_ACCEL 0.2f // g, larger tilts the gravity estimate
+#define GYRO_HEADING_GAIN 0.2f
+
+// The temperature fit runs at most once per period, with enough still
+// windows; the slope needs GYRO_FIT_MIN_SPREAD of temperature spread.
+#define GYRO_FIT_PERIOD (60 * SAMPLE_RATE)
+#define GYRO_FIT_MIN_WINDOWS 30
+#define GYRO_FIT_MAX_WINDOWS 600 // older windows fade out beyond this
+#define GYRO_FIT_MIN_SPREAD 2.0f // degC, standard deviation
+#define GYRO_FIT_MIN_CHANGE 0.02f // dps at the current temperature
+
+struct GyroTempModel {
+  float reference; // degC, where calibration.gyro applies
+  float slope[3];  // dps per degC
+};
+
+extern GyroTempModel gyroTempModel;
+
+class GyroBiasEstimator {
+public:
+  // Forget the learnt offset and the fit, e.g. after a manual calibration.
+  void reset();
+
+  // Replaces the bias calibration subtracted from c->g* with the tracked one.
+  void correct(const RawICUData *raw, const CalibrationStore *cal,
+               const GyroTempModel *model, CalibratedICUData *c);
+
+  // Learns from a fused sample. True when it refitted cal->gyro* and model,
+  // which the caller persists.
+  bool update(const EstimatorState *state, CalibrationStore *cal,
+              GyroTempModel *model);
+
+  const float *getBias() const { return bias; }
+  uint32_t getStillWindows() const { return stillWindows; }
+  uint32_t getHeadingWindows() const { return headingWindows; }
+  uint32_t getFits() const { return fits; }
+
+private:
+  void modelBias(const CalibrationStore *cal, const GyroTempModel *model,
+                 float temp, float *out) const;
+  void endStillWindow(const CalibrationStore *cal, const GyroTempModel *model);
+  void onMag(const EstimatorState *state);
+  bool fit(CalibrationStore *cal, GyroTempModel *model);
+
+  float offset[3] = {0, 0, 0};
+  float bias[3] = {0, 0, 0};
+
+  // still window
+  uint16_t stillSamples = 0;
+  float gyroMin[3], gyroMax[3], accelMin, accelMax;
+  double gyroSum[3], tempSum;
+
+  // heading window, from one fresh mag reading to one GYRO_HEADING_SAMPLES on
+  bool headingStarted = false;
+  uint32_t headingSamples = 0;
+  float lastHeading = 0, maxAccelError = 0, upLast[3] = {0, 0, 1};
+  double gyroTurn = 0, magTurn = 0, headingTime = 0, upSum[3] = {0, 0, 0};
+
+  // temperature fit over still windows
+  double fitN = 0, fitT = 0, fitTT = 0, fitB[3] = {0, 0, 0},
+         fitTB[3] = {0, 0, 0};
+  uint32_t samplesSinceFit = 0;
+  float temp = 0; // of the last sample
+
+  uint32_t stillWindows = 0, headingWindows = 0, fits = 0;
+};
+
+#endif
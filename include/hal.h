@@ -0,0 +1,66 @@
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef hal_h
+#define hal_h
+
+// Thin hardware layer shared by the firmware and the native build. The clock
+// comes from Arduino.h (millis/micros), NVS from Preferences.h; both have
+// native stand-ins in include/native.
+
+enum I2CResult : uint8_t {
+  I2C_OK,
+  I2C_NACK,
+  I2C_TIMEOUT,
+  I2C_BUS_ERROR,
+  I2C_EXPIRED, // deadline passed before the transfer started
+  I2C_PENDING,
+};
+
+bool halI2CBegin();
+I2CResult halI2CRead(uint8_t addr, uint8_t reg, uint8_t *buf, size_t len,
+                     uint32_t timeoutMs);
+I2CResult halI2CWrite(uint8_t addr, uint8_t reg, uint8_t value,
+                      uint32_t timeoutMs);
+// Clocks SCL until a slave holding SDA lets go, then reinstalls the driver.
+void halI2CRecover();
+
+// Hooks for i2c_engine: wake the worker that calls i2cEngineRun(), and block
+// the submitting task until the worker has finished a batch.
+void halI2CEngineKick();
+void halI2CEngineWait(uint32_t timeoutMs);
+
+// LEDC PWM, one timer per channel at hz and its full duty resolution. us is
+// the pulse width, 0 stops the pulses.
+bool halPWMBegin(uint8_t channel, uint8_t pin, uint32_t hz);
+void halPWMWrite(uint8_t channel, float us);
+
+// Calls callback every periodUs from a timer task above the application
+// tasks, so it keeps its rate while they are busy. Does nothing on the host,
+// where the simulations call their periodic work themselves.
+bool halTimerStart(uint32_t periodUs, void (*callback)());
+
+// Calls run(arg) every periodMs from a task of its own at priority. A task
+// that falls a whole period behind skips the releases it missed instead of
+// running them back to back. Does nothing on the host, like halTimerStart.
+bool halTaskStart(const char *name, uint8_t priority, uint32_t periodMs,
+                  void (*run)(void *), void *arg);
+// The calling task (thread on the host), only to compare against.
+void *halTaskCurrent();
+
+// Socket side of ws_queue. halWSWrite hands a frame to the client's socket,
+// which copies it, or returns false while the socket is still busy with the
+// earlier ones. halWSClose drops the connection; the server reports it back
+// through wsClose().
+bool halWSWrite(uint32_t client, const uint8_t *data, size_t len);
+void halWSClose(uint32_t client);
+
+// Free-running counter for timing short sections, subtract to get a
+// duration. CPU cycles on the ESP32, nanoseconds on the host.
+uint32_t halCycles();
+uint32_t halCyclesPerUs();
+
+uint32_t halFreeHeap();
+uint32_t halMinFreeHeap();
+
+#endif
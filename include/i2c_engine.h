@@ -0,0 +1,51 @@
+#include "hal.h"
+#include <atomic>
+
+#ifndef i2c_engine_h
+#define i2c_engine_h
+
+#define I2C_QUEUE_LEN 8
+#define I2C_RECOVERY_THRESHOLD 3
+
+// Queued register reads and single-byte writes executed by a dedicated
+// worker. The control task
+// submits a batch, then waits for completions up to its own deadline and
+// carries on without them if the bus is slow; each transfer is also given
+// only the time left until its deadline, never a fixed long timeout.
+struct I2CTransaction {
+  uint8_t addr;
+  uint8_t reg;
+  uint8_t *buf; // NULL for a write of value
+  uint16_t len;
+  uint8_t value;
+  uint32_t deadline; // micros()
+  std::atomic<I2CResult> status{I2C_OK};
+
+  bool pending() const { return status.load() == I2C_PENDING; }
+};
+
+struct I2CStats {
+  uint32_t transactions;
+  uint32_t nacks;
+  uint32_t timeouts;
+  uint32_t busErrors;
+  uint32_t expired;
+  uint32_t rejected; // queue full
+  uint32_t recoveries;
+};
+
+extern I2CStats i2cStats;
+
+bool i2cSubmitRead(I2CTransaction *t, uint8_t addr, uint8_t reg, uint8_t *buf,
+                   uint16_t len, uint32_t deadline);
+bool i2cSubmitWrite(I2CTransaction *t, uint8_t addr, uint8_t reg,
+                    uint8_t value, uint32_t deadline);
+
+// True once none of the transactions is pending; false if the deadline
+// passed first. Transactions still in flight must not be resubmitted.
+bool i2cAwait(I2CTransaction *const *ts, int n, uint32_t deadline);
+
+// Worker side: executes everything queued, in order.
+void i2cEngineRun();
+
+#endif
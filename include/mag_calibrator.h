@@ -0,0 +1,24 @@
+#include "mag_fit.h"
+#include "pipeline.h"
+#include <Arduino.h>
+
+#ifndef mag_calibrator_h
+#define mag_calibrator_h
+
+// On-device magnetometer calibration. The control task adds each fresh
+// reading to a MagScatter (O(1)) and publishes it; a low-priority task
+// re-solves the fit every MAG_SOLVE_PERIOD_MS while points keep arriving.
+#define MAG_SOLVE_PERIOD_MS 500
+
+// Starts the solver task.
+bool setupMagCalibrator();
+
+// Control task only.
+void magCalibratorReset();
+void magCalibratorAdd(const RawICUData *raw);
+
+// Any task. Latest fit, false before the first one; *generation changes
+// with every new fit.
+bool magCalibratorResult(MagFit *fit, uint32_t *generation);
+
+#endif
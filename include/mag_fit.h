@@ -0,0 +1,37 @@
+#include <Arduino.h>
+
+#ifndef mag_fit_h
+#define mag_fit_h
+
+// Ellipsoid fit of magnetometer readings (MotionCal's 10-parameter fit, as
+// the calibration page used to run it). Every reading adds its outer product
+// v v^T, v = [x^2, 2xy, 2xz, y^2, 2yz, z^2, x, y, z, 1], to a scatter matrix
+// in O(1); a fit takes the eigenvector of the scatter's smallest eigenvalue
+// as the ellipsoid and derives the hard-iron offset, the soft-iron matrix
+// (applied as in applyCalibration) and the field strength from it.
+#define MAG_FIT_MIN_POINTS 150
+#define MAG_FIT_TERMS 10
+#define MAG_FIT_SUMS (MAG_FIT_TERMS * (MAG_FIT_TERMS + 1) / 2)
+
+struct MagScatter {
+  float origin[3]; // first reading, readings are fitted relative to it
+  uint32_t points;
+  double sums[MAG_FIT_SUMS]; // upper triangle, row by row
+};
+
+struct MagFit {
+  float offset[3];
+  float scale[3][3];
+  float fitError;      // percent of the field strength
+  float fieldStrength; // uT
+  uint32_t points;
+};
+
+void magScatterReset(MagScatter *scatter);
+void magScatterAdd(MagScatter *scatter, float mx, float my, float mz);
+
+// Tens of milliseconds of soft-float on the ESP32-C3, keep it off the
+// control task. False with fewer than MAG_FIT_MIN_POINTS or no ellipsoid.
+bool magFitSolve(const MagScatter *scatter, MagFit *fit);
+
+#endif
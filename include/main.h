@@ -1,3 +1,2 @@
 
-#define WS_MAX_QUEUED_MESSAGES 1024
 #define SERVO_MAX_DIFF 52.0f
\ No newline at end of file
@@ -0,0 +1,70 @@
+#include "hal.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef metrics_h
+#define metrics_h
+
+// Scoped probes on the hot path. PROBE_SCOPE(name) times the rest of the
+// enclosing block in CPU cycles (nanoseconds on the host, see halCycles)
+// into probeStats[PROBE_name]. Each probe is written by one task only;
+// readers may see a sample half-applied, as with the other stats structs.
+// Build with -D PROBES=0 to compile them out.
+#ifndef PROBES
+#define PROBES 1
+#endif
+
+#define PROBE_LIST(P)                                                          \
+  P(i2c)         /* acquire(): FIFO count, magnetometer, FIFO drain */         \
+  P(calibration) /* applyCalibration and the gyro bias correction */           \
+  P(fusion)      /* the fusion backend update */                               \
+  P(callback)    /* the sensor and control jobs, tickPID included */           \
+  P(pid)         /* tickPID */                                                 \
+  P(loop)        /* one pass of loop() */
+
+#define PROBE_ID(name) PROBE_##name,
+enum ProbeId : uint8_t { PROBE_LIST(PROBE_ID) PROBE_COUNT };
+#undef PROBE_ID
+
+// Durations land in quarter-octave bins from 2^PROBE_MIN_LOG2 cycles up,
+// so percentiles are within 19% (they report the upper edge of the bin).
+#define PROBE_MIN_LOG2 6
+#define PROBE_BINS 64
+
+struct ProbeStats {
+  uint32_t count;
+  uint32_t min, max; // cycles
+  uint64_t sum;
+  uint32_t bins[PROBE_BINS];
+};
+
+extern ProbeStats probeStats[PROBE_COUNT];
+extern const char *const probeNames[PROBE_COUNT];
+
+void probeRecord(ProbeId id, uint32_t cycles);
+// Cycles below which fraction of the recorded durations fall.
+uint32_t probePercentile(const ProbeStats *stats, float fraction);
+
+#if PROBES
+class ProbeScope {
+public:
+  explicit ProbeScope(ProbeId id) : id(id), start(halCycles()) {}
+  ~ProbeScope() { probeRecord(id, halCycles() - start); }
+
+private:
+  ProbeId id;
+  uint32_t start;
+};
+
+#define PROBE_SCOPE(name) ProbeScope probe_##name(PROBE_##name)
+#else
+#define PROBE_SCOPE(name)
+#endif
+
+// Prometheus text exposition of the probes, the counters of the other
+// modules (acquisition, packet queue, websocket queues, rate groups, heap)
+// and the boot timeline. Returns the length written, truncated to size - 1.
+#define METRICS_MAX_LEN 8192
+size_t formatMetrics(char *buf, size_t size);
+
+#endif
@@ -0,0 +1,112 @@
+#include "actuator.h"
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef mission_h
+#define mission_h
+
+// Autopilot missions: a list of legs, each with a heading target, a speed
+// profile and a duration, run one after the other. Speeds are percent of the
+// motor range as on the control page (neutral + 5 us per percent), capped at
+// calibration.maxAPSpeed.
+#define MISSION_MAX_LEGS 16
+#define MISSION_MAX_LEG_S 240 // keeps a whole mission inside the micros() wrap
+#define MISSION_MOTOR_MIN_US 35 // below this past neutral the ESC stands still
+#define MISSION_LEGS_PER_PACKET 4 // SetMission / Mission carry legs in chunks
+
+enum MissionHeadingMode : uint8_t {
+  LEG_HEADING_HOLD,     // keep the heading the leg starts with
+  LEG_HEADING_ABSOLUTE, // turn to heading, degrees from north
+  LEG_HEADING_RELATIVE, // turn by heading, positive clockwise
+};
+
+enum MissionSpeedProfile : uint8_t {
+  LEG_SPEED_RAMP,  // linear from the speed the leg starts with to speed
+  LEG_SPEED_HOLD,  // speed from the start of the leg
+  LEG_SPEED_COAST, // motor at neutral, the heading is still held
+};
+
+struct MissionLeg {
+  uint8_t headingMode;
+  uint8_t speedProfile;
+  float heading;  // degrees
+  float speed;    // percent
+  float duration; // s
+  float turnRate; // dps the heading setpoint moves at, 0 steps it
+};
+
+struct MissionPlan {
+  uint8_t count;
+  MissionLeg legs[MISSION_MAX_LEGS];
+};
+
+// The run the autopilot button did before missions: hold the heading, ramp
+// up to maxSpeed at 50 us/s, hold it until 30 s.
+void missionDefault(MissionPlan *plan, float maxSpeed);
+// NULL if the plan can be run, what is wrong with it otherwise.
+const char *missionValidate(const MissionPlan *plan);
+
+inline float missionMotorUs(float speed) {
+  if (speed <= 0)
+    return ACTUATOR_MOTOR_NEUTRAL_US;
+
+  float us = 5 * speed;
+  return ACTUATOR_MOTOR_NEUTRAL_US +
+         (us > MISSION_MOTOR_MIN_US ? us : MISSION_MOTOR_MIN_US);
+}
+
+enum MissionState : uint8_t {
+  MISSION_IDLE,
+  MISSION_RUNNING,
+  MISSION_DONE,
+  MISSION_STOPPED,
+};
+
+struct MissionSetpoint {
+  float heading; // [0, 360)
+  float speed;
+};
+
+// One piece of the setpoint trajectory, linear in time. Headings are
+// unwrapped so a turn through north stays a straight line.
+struct MissionSegment {
+  uint32_t start, end; // ms from the start of the mission
+  float heading, headingRate; // deg, deg/ms
+  float speed, speedRate;     // percent, percent/ms
+  uint8_t leg;
+};
+
+// A leg is at most a turn and the rest of it at the target heading.
+#define MISSION_MAX_SEGMENTS (2 * MISSION_MAX_LEGS)
+
+// load() turns the legs into the segment table once, from the heading the
+// boat has when it starts; update() then only walks the table forward and
+// interpolates, on the control task, every sample. Only the state may be
+// read from other tasks.
+class MissionExecutor {
+public:
+  bool load(const MissionPlan &plan, float heading, float maxSpeed);
+  void start(uint32_t timestamp);
+  void stop();
+
+  // Setpoint for the sample at timestamp. After the last leg the state is
+  // MISSION_DONE and the setpoint holds the final heading at neutral speed.
+  MissionSetpoint update(uint32_t timestamp);
+
+  MissionState getState() const { return (MissionState)state.load(); }
+  bool running() const { return state == MISSION_RUNNING; }
+  uint8_t getLeg() const { return segments[current].leg; }
+  uint8_t getLegCount() const { return legs; }
+  float getElapsed() const { return elapsed * 1e-3f; }  // s
+  float getDuration() const { return duration * 1e-3f; } // s
+  const MissionSegment *getSegments(size_t *n) const;
+
+private:
+  MissionSegment segments[MISSION_MAX_SEGMENTS] = {};
+  uint8_t count = 0, current = 0, legs = 0;
+  uint32_t startTime = 0, elapsed = 0, duration = 0;
+  std::atomic<uint8_t> state{MISSION_IDLE};
+};
+
+#endif
@@ -0,0 +1,38 @@
+// Minimal Arduino surface for the native build. Only what the portable
+// modules (pipeline, calibration, pid, packets) use is provided here.
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <math.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+#define PI 3.1415926535897932384626433832795
+#define DEG_TO_RAD 0.017453292519943295769236907684886
+#define RAD_TO_DEG 57.295779513082320876798154814105
+
+typedef uint8_t byte;
+
+uint32_t millis();
+uint32_t micros();
+void delay(uint32_t ms);
+void yield();
+
+class String {
+public:
+  String() {}
+  String(const char *str) : str(str ? str : "") {}
+
+  const char *c_str() const { return str.c_str(); }
+  unsigned int length() const { return str.length(); }
+
+private:
+  std::string str;
+};
+
+#endif
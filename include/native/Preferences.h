@@ -0,0 +1,32 @@
+// In-memory stand-in for the ESP32 NVS Preferences class.
+
+#ifndef Preferences_h
+#define Preferences_h
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+class Preferences {
+public:
+  bool begin(const char *name, bool readOnly = false,
+             const char *partition = NULL);
+  void end();
+
+  bool isKey(const char *key);
+  bool remove(const char *key);
+
+  size_t putFloat(const char *key, float value);
+  float getFloat(const char *key, float defaultValue = NAN);
+
+  size_t putBytes(const char *key, const void *value, size_t len);
+  size_t getBytesLength(const char *key);
+  size_t getBytes(const char *key, void *buf, size_t maxLen);
+
+private:
+  std::string ns;
+  bool readOnly = false;
+};
+
+#endif
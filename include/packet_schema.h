@@ -0,0 +1,145 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifndef packet_schema_h
+#define packet_schema_h
+
+// Every fixed-layout websocket packet, in one place. The firmware structs,
+// encoders, decoders and dispatch lengths below are expanded from this list,
+// and `program schema` (native build) prints web/src/schema.ts from it.
+//
+//   X(direction, id, Name, fields)   IN: web -> boat, OUT: boat -> web
+//   F(type, name)                    scalar field
+//   A(type, name, n)                 array field
+//
+// Fields are packed in order, little-endian, without padding. An id may be
+// used once per direction. Variable-length frames (0xbb message, 0x20
+// telemetry, 0x31 capture) are built by their own senders.
+#define PACKET_SCHEMA(X, F, A)                                                 \
+  X(IN, 0x01, InitRequest, )                                                   \
+  X(OUT, 0x01, Init, F(float, kp) F(float, ki) F(float, kd))                   \
+  X(IN, 0x0a, SetAnchoring, F(bool, anchoring))                                \
+  X(OUT, 0x0a, Anchoring, F(bool, anchoring))                                  \
+  X(IN, 0x0c, Control, F(float, angle) F(float, speed))                        \
+  X(IN, 0x11, SetYawAnchor, F(float, yaw))                                     \
+  X(OUT, 0x11, YawAnchor, F(float, yaw))                                       \
+  X(IN, 0x21, Subscribe, A(uint8_t, decimation, 6) F(uint8_t, streams))        \
+  X(OUT, 0x22, LoopTiming,                                                     \
+    F(float, periodUs) F(uint32_t, wakes) F(uint32_t, overruns)                \
+        F(uint32_t, resyncs) F(uint32_t, maxCycleUs) A(uint32_t, jitter, 12))  \
+  X(OUT, 0x23, Stats,                                                          \
+    A(float, meanUs, 6) A(float, p99Us, 6) A(float, maxUs, 6)                  \
+        F(uint32_t, wsFrames) F(uint32_t, wsDropped) F(uint32_t, wsClosed)     \
+            A(uint32_t, wsDepth, 4) A(uint32_t, wsClientDropped, 4)            \
+                F(uint32_t, packetsDropped) F(uint32_t, freeHeap)              \
+                    F(uint32_t, minFreeHeap) A(float, groupLoad, 4)            \
+                        A(uint32_t, groupOverruns, 4))                         \
+  X(IN, 0x30, Capture, F(bool, enabled))                                       \
+  X(IN, 0x40, StartAutotune,                                                   \
+    F(float, amplitude) F(float, hysteresis) F(uint8_t, cycles)                \
+        F(uint8_t, rule))                                                      \
+  X(OUT, 0x40, AutotuneProgress, F(uint8_t, phase) F(float, percentage))       \
+  X(IN, 0x41, StopAutotune, )                                                  \
+  X(OUT, 0x41, AutotuneResult,                                                 \
+    F(float, ku) F(float, tu) F(float, kp) F(float, ki) F(float, kd))          \
+  X(IN, 0x42, ApplyAutotune, )                                                 \
+  X(IN, 0x50, SetMission,                                                      \
+    F(uint8_t, first) F(uint8_t, count) F(uint8_t, total)                      \
+        A(uint8_t, headingMode, 4) A(uint8_t, speedProfile, 4)                 \
+            A(float, heading, 4) A(float, speed, 4) A(float, duration, 4)      \
+                A(float, turnRate, 4))                                         \
+  X(OUT, 0x50, Mission,                                                        \
+    F(uint8_t, first) F(uint8_t, count) F(uint8_t, total)                      \
+        A(uint8_t, headingMode, 4) A(uint8_t, speedProfile, 4)                 \
+            A(float, heading, 4) A(float, speed, 4) A(float, duration, 4)      \
+                A(float, turnRate, 4))                                         \
+  X(IN, 0x51, MissionRequest, )                                                \
+  X(IN, 0x52, StartMission, )                                                  \
+  X(OUT, 0x52, MissionProgress,                                                \
+    F(uint8_t, state) F(uint8_t, leg) F(uint8_t, legs) F(float, elapsed)       \
+        F(float, duration) F(float, heading) F(float, speed))                  \
+  X(IN, 0x53, StopMission, )                                                   \
+  X(IN, 'p', SetKp, F(float, value))                                           \
+  X(IN, 'i', SetKi, F(float, value))                                           \
+  X(IN, 'd', SetKd, F(float, value))                                           \
+  X(IN, 0xa0, CalibrationRequest, )                                            \
+  X(OUT, 0xa0, Calibration,                                                    \
+    A(float, gyro, 3) A(float, accel, 3) A(float, mag, 3)                      \
+        A(float, magScale, 9) F(float, north) F(float, servoMiddle)            \
+            F(float, maxAPSpeed))                                              \
+  X(IN, 0xa1, SetCalibration,                                                  \
+    A(float, gyro, 3) A(float, accel, 3) A(float, mag, 3)                      \
+        A(float, magScale, 9) F(float, north) F(float, servoMiddle)            \
+            F(float, maxAPSpeed))                                              \
+  X(IN, 0xa2, ParamsRequest, )                                                 \
+  X(OUT, 0xa2, Params,                                                         \
+    F(uint8_t, first) F(uint8_t, count) A(float, values, 16))                  \
+  X(IN, 0xa3, SetParams,                                                       \
+    F(uint8_t, first) F(uint8_t, count) A(float, values, 16))                  \
+  X(IN, 0xc1, MagCalibration, A(float, offset, 3) A(float, scale, 9))          \
+  X(IN, 0xc2, StartGyroCalibration, )                                          \
+  X(OUT, 0xc2, GyroCalibrationProgress, F(float, percentage))                  \
+  X(IN, 0xc3, StartMagCalibration, )                                           \
+  X(OUT, 0xc3, MagCalibrationStatus,                                           \
+    F(uint32_t, points) F(float, fitError) F(float, fieldStrength)             \
+        A(float, offset, 3) A(float, scale, 9))                                \
+  X(IN, 0xc4, StartAccelCalibration, F(uint8_t, axis))                         \
+  X(IN, 0xc5, AccelCalibration, A(float, bias, 3))                             \
+  X(OUT, 0xc6, AccelCalibrationProgress,                                       \
+    F(float, percentage) F(uint8_t, axis))                                     \
+  X(OUT, 0xc7, AccelCalibrationData,                                           \
+    F(uint8_t, axis) F(float, ax) F(float, ay) F(float, az))                   \
+  X(IN, 0xc8, StopMagCalibration, F(bool, apply))                              \
+  X(IN, 0xc9, SetNorth, )                                                      \
+  X(IN, 0xff, Ping, )
+
+enum PacketDirection : uint8_t { PACKET_IN, PACKET_OUT };
+
+#define PACKET_MEMBER(type, name) type name;
+#define PACKET_ARRAY_MEMBER(type, name, n) type name[n];
+#define PACKET_STRUCT(dir, packetId, Name, fields)                             \
+  struct Name##Packet {                                                        \
+    static constexpr PacketDirection direction = PACKET_##dir;                 \
+    static constexpr uint8_t id = packetId;                                    \
+    fields                                                                     \
+  };
+
+PACKET_SCHEMA(PACKET_STRUCT, PACKET_MEMBER, PACKET_ARRAY_MEMBER)
+
+// Payload length on the wire, without the id byte.
+template <typename P> struct PacketTraits;
+
+#define PACKET_FIELD_SIZE(type, name) +sizeof(type)
+#define PACKET_ARRAY_SIZE(type, name, n) +(n) * sizeof(type)
+#define PACKET_TRAITS(dir, packetId, Name, fields)                             \
+  template <> struct PacketTraits<Name##Packet> {                              \
+    enum : size_t { size = 0 fields };                                         \
+  };
+
+PACKET_SCHEMA(PACKET_TRAITS, PACKET_FIELD_SIZE, PACKET_ARRAY_SIZE)
+
+// Field by field copies, so struct padding never reaches the wire.
+#define PACKET_PUT(type, name, ...)                                            \
+  memcpy(p, &packet.name, sizeof(packet.name));                                \
+  p += sizeof(packet.name);
+#define PACKET_GET(type, name, ...)                                            \
+  memcpy(&packet->name, p, sizeof(packet->name));                              \
+  p += sizeof(packet->name);
+#define PACKET_ENCODER(dir, packetId, Name, fields)                            \
+  inline void encodePacket(uint8_t *p, const Name##Packet &packet) {           \
+    fields                                                                     \
+    (void)p;                                                                   \
+    (void)packet;                                                              \
+  }
+#define PACKET_DECODER(dir, packetId, Name, fields)                            \
+  inline void decodePacket(const uint8_t *p, Name##Packet *packet) {           \
+    fields                                                                     \
+    (void)p;                                                                   \
+    (void)packet;                                                              \
+  }
+
+PACKET_SCHEMA(PACKET_ENCODER, PACKET_PUT, PACKET_PUT)
+PACKET_SCHEMA(PACKET_DECODER, PACKET_GET, PACKET_GET)
+
+#endif
@@ -1,23 +1,85 @@
 #include "calibration.h"
-#include "ws.h"
+#include "hal.h"
+#include "packet_schema.h"
+#include "ws_queue.h"
 #include <Arduino.h>
 
-void sendMessagePacket(String str);
+#ifndef packets_h
+#define packets_h
+
+#define PACKET_QUEUE_LEN 16
+#define PACKET_MAX_LEN 88 // id + the largest incoming payload
+
+// Incoming packets are dispatched through a table indexed by id. A thunk
+// decodes the payload into the packet struct and calls the typed handler.
+typedef void (*PacketCallback)();
+typedef void (*PacketThunk)(const uint8_t *data, PacketCallback handler);
+
+void routePacket(uint8_t id, size_t len, PacketThunk thunk,
+                 PacketCallback handler, bool coalesce);
 
-void sendInitPacket(float kp, float ki, float kd);
+// With coalesce, a packet directly followed in the queue by another one with
+// the same id is skipped: only the latest setpoint is applied.
+template <typename P>
+void onPacket(void (*handler)(const P &packet), bool coalesce = false) {
+  static_assert(P::direction == PACKET_IN, "only incoming packets are routed");
+  static_assert(1 + PacketTraits<P>::size <= PACKET_MAX_LEN,
+                "packet does not fit a queue slot");
 
-void sendAnchoringPacket(bool *anchoring);
+  routePacket(
+      P::id, PacketTraits<P>::size,
+      [](const uint8_t *data, PacketCallback callback) {
+        P packet;
+        decodePacket(data, &packet);
+        reinterpret_cast<void (*)(const P &)>(callback)(packet);
+      },
+      reinterpret_cast<PacketCallback>(handler), coalesce);
+}
 
-void sendRotationPacket(float yaw);
+// frame is id + payload as received. False for an id nothing is routed to
+// or a payload length that does not match the schema.
+bool dispatchPacket(const uint8_t *frame, size_t len);
 
-void sendYawAnchorPacket(float yaw);
+struct PacketQueueStats {
+  uint32_t queued;
+  uint32_t applied;
+  uint32_t coalesced;
+  uint32_t dropped; // queue full
+  uint32_t maxDepth;
+};
 
-void sendMagPointPacket(float mx, float my, float mz);
+extern PacketQueueStats packetQueueStats;
 
-void sendGyroCalibrationProgressPacket(float percentage);
+// Network side, the only producer: validates the frame like dispatchPacket
+// and queues it for the control task. A full queue drops the packet and
+// counts it; false only for frames dispatchPacket would refuse.
+bool queuePacket(const uint8_t *frame, size_t len);
 
-void sendAccelCalibrationProgressPacket(uint8_t axis, float percentage);
+// Control side, the only consumer: runs the handlers of everything queued,
+// at a point of the control cycle where nothing else is using the state they
+// change.
+void applyQueuedPackets();
+size_t packetQueueDepth();
+
+// Encodes straight into the websocket frame. Reliable and to every client
+// unless told otherwise; stream limits it to the clients subscribed to it.
+template <typename P>
+void sendPacket(const P &packet, WSDelivery delivery = WS_RELIABLE,
+                uint8_t stream = 0) {
+  static_assert(P::direction == PACKET_OUT, "only outgoing packets are sent");
+
+  auto frame = wsFrame(1 + PacketTraits<P>::size);
+  if (frame.data == NULL)
+    return;
+  frame.data[0] = P::id;
+  encodePacket(frame.data + 1, packet);
+  wsSend(frame, delivery, wsSubscribers(stream));
+}
+
+void sendMessagePacket(String str);
 
-void sendAccelCalibrationDataPacket(uint8_t axis, float ax, float ay, float az);
+void sendCalibrationPacket(const CalibrationStore *cal);
+void storeCalibrationPacket(const SetCalibrationPacket &packet,
+                            CalibrationStore *cal);
 
-void sendCalibrationDataPacket(CalibrationStore *cal);
\ No newline at end of file
+#endif
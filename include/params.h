@@ -0,0 +1,74 @@
+#include "calibration.h"
+#include "gyro_bias.h"
+#include "mission.h"
+#include <Arduino.h>
+
+#ifndef params_h
+#define params_h
+
+// Every persisted parameter, in blob order: CalibrationStore followed by the
+// PID gains. Names double as the keys of the per-value NVS layout that came
+// before the blob (namespaces "calibration" and "pid", "none" for parameters
+// added since), read once to migrate.
+// New parameters go at the end; a blob saved before them still loads and
+// keeps their defaults.
+#define PARAM_LIST(P)                                                          \
+  P(gyroX, calibration) P(gyroY, calibration) P(gyroZ, calibration)            \
+  P(accelX, calibration) P(accelY, calibration) P(accelZ, calibration)         \
+  P(magX, calibration) P(magY, calibration) P(magZ, calibration)               \
+  P(magScale0, calibration) P(magScale1, calibration)                          \
+  P(magScale2, calibration) P(magScale3, calibration)                          \
+  P(magScale4, calibration) P(magScale5, calibration)                          \
+  P(magScale6, calibration) P(magScale7, calibration)                          \
+  P(magScale8, calibration) P(north, calibration)                              \
+  P(servoMiddle, calibration) P(maxAPSpeed, calibration) P(kp, pid)            \
+  P(ki, pid) P(kd, pid) P(gyroTempRef, none) P(gyroSlopeX, none)               \
+  P(gyroSlopeY, none) P(gyroSlopeZ, none)
+
+#define PARAM_ENUM(name, legacy) PARAM_##name,
+enum ParamId : uint8_t { PARAM_LIST(PARAM_ENUM) PARAM_COUNT };
+#undef PARAM_ENUM
+
+// bumped when a parameter changes meaning, not when one is appended
+#define PARAMS_VERSION 1
+#define PARAMS_DEBOUNCE_MS 1000
+#define PARAMS_PER_PACKET 16
+
+struct ParamValues {
+  CalibrationStore calibration;
+  float kp, ki, kd;
+  GyroTempModel gyroTemp;
+};
+
+static_assert(sizeof(ParamValues) == PARAM_COUNT * sizeof(float),
+              "PARAM_LIST out of sync with ParamValues");
+
+struct ParamsStats {
+  uint32_t saves;
+  uint32_t writeErrors;
+  uint32_t maxWriteUs;
+  uint32_t sequence; // of the blob last loaded or saved
+};
+
+extern ParamsStats paramsStats;
+
+// One NVS read of both slots into calibration and the PID gains (call after
+// setupPID()), then starts the write-behind task. Falls back to the legacy
+// keys, then to defaults.
+bool setupParams();
+
+// Control task (whoever owns calibration and pid). Snapshots the current
+// values; the task saves them once nothing changed for PARAMS_DEBOUNCE_MS.
+void paramsChanged();
+
+// The mission the autopilot runs, count 0 when none is stored. Owned by the
+// control task like calibration; missionChanged() has the writer task save
+// it, in its own NVS key next to the parameter slots.
+extern MissionPlan missionPlan;
+void missionChanged();
+
+// Bulk access by ParamId, for the Params/SetParams packets.
+void getParams(ParamValues *values);
+void setParams(const ParamValues *values);
+
+#endif
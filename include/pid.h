@@ -1,11 +1,53 @@
 #include "Arduino.h"
 #include "main.h"
-#include "uPID.h"
 
-extern uPIDfast<I_SATURATE | PID_REVERSE> pid;
+#ifndef pid_h
+#define pid_h
+
+struct PIDTerms {
+  float error;
+  float p, i, d;
+  float output;
+};
+
+// Same behaviour the heading loop had with uPIDfast<I_SATURATE | PID_REVERSE>
+// (error = input - setpoint, integral clamped to the output range), but with
+// the individual terms kept for telemetry.
+class HeadingPID {
+public:
+  explicit HeadingPID(float dtMs = 30) : dt(dtMs / 1000.0f) {}
+
+  float setpoint = 0;
+  float outMin = 0, outMax = 255;
+
+  void setKp(float p) { kp = p; }
+  void setKi(float i) { ki = i; }
+  void setKd(float d) { kd = d; }
+  float getKp() const { return kp; }
+  float getKi() const { return ki; }
+  float getKd() const { return kd; }
+
+  // dt in s, the measured sample period; 0 holds the integral and D term
+  float compute(float input, float dt);
+  float compute(float input) { return compute(input, dt); }
+  void reset();
+
+  const PIDTerms &getTerms() const { return terms; }
+
+private:
+  float dt;
+  float kp = 0, ki = 0, kd = 0;
+  float integral = 0, prevError = 0;
+  PIDTerms terms = {};
+};
+
+extern HeadingPID pid;
 
 void setupPID();
-float tickPID(float yawAnchor, float yaw);
+// yaw - yawAnchor folded into [-90, 90], what tickPID() acts on.
+float headingError(float yawAnchor, float yaw);
+float tickPID(float yawAnchor, float yaw, float dt);
+// Terms of the last tickPID(), safe to read from any task.
+PIDTerms getPIDTerms();
 
-void saveCoefficients();
-bool loadCoefficients();
\ No newline at end of file
+#endif
@@ -0,0 +1,79 @@
+#include "calibration.h"
+#include <Arduino.h>
+
+#ifndef pipeline_h
+#define pipeline_h
+
+#define SAMPLE_RATE 200
+// fuseSample integrates the time between sample timestamps, at most this
+// many nominal periods: frames lost to a FIFO overflow are not made up.
+#define SAMPLE_DT_MAX_PERIODS 4
+
+#define MPU_BURST_LEN 14
+#define MAG_BURST_LEN 6
+
+// LSB per unit at the ranges setupIMU() selects. decodeMPU6050() and
+// decodeHMC5883() divide by them, captures and blackbox logs multiply by
+// them to store the register counts.
+#define ACCEL_LSB_PER_G 4096.0f
+#define GYRO_LSB_PER_DPS 32.8f
+#define MAG_LSB_PER_UT_XZ 11.0f
+#define MAG_LSB_PER_UT_Y 9.8f
+// the same for the RawICUData fields ax to mz, in order
+#define RAW_LSB_PER_UNIT                                                       \
+  ACCEL_LSB_PER_G, ACCEL_LSB_PER_G, ACCEL_LSB_PER_G, GYRO_LSB_PER_DPS,         \
+      GYRO_LSB_PER_DPS, GYRO_LSB_PER_DPS, MAG_LSB_PER_UT_XZ, MAG_LSB_PER_UT_Y, \
+      MAG_LSB_PER_UT_XZ
+
+struct RawICUData {
+  float ax, ay, az;
+  float gx, gy, gz;
+  float mx, my, mz;
+  float temp; // degC, MPU6050 die
+};
+
+struct CalibratedICUData {
+  float ax, ay, az;
+  float gx, gy, gz;
+  float mx, my, mz;
+};
+
+// Everything the estimator publishes for one sample. Written by imuTask and
+// read as a whole through a SeqLock, so fields always belong together.
+struct EstimatorState {
+  uint32_t timestamp; // micros() at acquisition
+  float dt;           // s, since the previous sample, what fusion integrated
+  uint32_t sample;    // 0 until the first sample has been fused
+  float yaw;          // degrees from north, [0, 360)
+  float q[4];         // w, x, y, z
+  float yawRate;      // dps, bias corrected
+  bool stale;         // I2C missed its deadline, fields are the last good ones
+  bool magFresh;      // raw.m* is a new magnetometer reading
+  RawICUData raw;
+  CalibratedICUData cal;
+};
+
+// Register bursts starting at ACCEL_XOUT_H (0x3B) and DATA_OUT_X_H (0x03).
+void decodeMPU6050(const uint8_t *buf, RawICUData *raw);
+void decodeHMC5883(const uint8_t *buf, RawICUData *raw);
+
+void applyCalibration(const RawICUData *raw, const CalibrationStore *cal,
+                      CalibratedICUData *out);
+
+class GyroBiasEstimator;
+struct GyroTempModel;
+
+// One sample of imuTask: calibration, fusion and the published fields of
+// state. The native replay runs logs through the same function. With
+// gyroBias, its tracked bias replaces cal->gyro*. Filter is one of the
+// backends in fusion.h, instantiated in pipeline.cpp.
+template <typename Filter>
+void fuseSample(Filter *fusion, const RawICUData *raw,
+                const CalibrationStore *cal, uint32_t timestamp,
+                EstimatorState *state, GyroBiasEstimator *gyroBias = NULL,
+                const GyroTempModel *gyroModel = NULL);
+
+float wrapYaw(float fusionYaw, float north);
+float filterYaw(float newYawDeg);
+
+#endif
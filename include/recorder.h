@@ -0,0 +1,44 @@
+#include "blackbox.h"
+#include <Arduino.h>
+
+#ifndef recorder_h
+#define recorder_h
+
+// Blackbox recorder: the control task encodes every sample into RAM blocks,
+// a low-priority task writes full blocks to LittleFS, one file per run under
+// BB_DIR. When no free block is left the sample is dropped and counted, the
+// control task never waits for flash.
+#define BB_DIR "/bb"
+#define BB_BLOCK_SIZE 2048
+#define BB_BLOCKS 8
+#define BB_MAX_RUNS 8
+
+struct RecorderStats {
+  uint32_t samples;
+  uint32_t dropped; // no free block
+  uint32_t blocks;
+  uint32_t bytes;
+  uint32_t maxWriteUs;
+  uint32_t writeErrors;
+};
+
+extern RecorderStats recorderStats;
+
+// Mounts LittleFS if needed and starts the flush task.
+bool setupRecorder();
+
+// Any task. A start while recording ends the current run first; both take
+// effect on the next recordSample(), which also snapshots calibration and
+// the PID state for the run header.
+void recorderStart();
+void recorderStop();
+// A run is being recorded or its last blocks are not on flash yet.
+bool recorderActive();
+
+// Control task only.
+void recordSample(const TelemetrySample *sample, uint8_t flags);
+
+// "<file> <bytes>" per line.
+String listRecorderRuns();
+
+#endif
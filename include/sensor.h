@@ -1,16 +1,26 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "gyro_bias.h"
+#include "pipeline.h"
 #include <Arduino.h>
 
-#define SAMPLE_RATE 5
+// Called for every fused sample, and once per cycle with the last good
+// values and stale set when the I2C bus did not deliver in time. dt is the
+// measured time since the previous sample in s, 0 on stale cycles. newest
+// is set on the last sample of the cycle, and on a stale one.
+typedef void (*IMUCallback)(float yaw, float dt, RawICUData raw, bool stale,
+                            bool newest);
+// Called once per cycle before any sample of it is fused, on the IMU task.
+typedef void (*IMUCycleCallback)();
 
-struct RawICUData {
-  float ax, ay, az;
-  float gx, gy, gz;
-  float mx, my, mz;
-};
+bool setupIMU(IMUCallback pidCallback, IMUCycleCallback cycleCallback);
+// The IMU task exists and calls back every cycle, even with a dead bus.
+bool imuRunning();
 
-typedef void (*IMUCallback)(float yaw, RawICUData raw);
+// Latest published estimate; never blocks. sample == 0 until the IMU has
+// produced its first reading.
+EstimatorState getEstimatorState();
 
-bool setupIMU(IMUCallback pidCallback);
-float getYaw();
\ No newline at end of file
+// IMU task only, its callbacks included.
+extern GyroBiasEstimator gyroBias;
+float getYaw();
@@ -0,0 +1,80 @@
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <type_traits>
+
+#ifndef seqlock_h
+#define seqlock_h
+
+// Single-writer / multi-reader snapshot of a trivially copyable value.
+//
+// The value is kept twice. The writer bumps the sequence to odd, updates copy
+// 0, bumps it to even and updates copy 1; readers pick the copy that is not
+// being written (sequence & 1) and retry only if the sequence moved while they
+// were copying. A reader that preempts the writer on the single core therefore
+// never spins waiting for it, and the writer never waits at all.
+template <typename T> class SeqLock {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "SeqLock needs a trivially copyable type");
+
+  static constexpr size_t WORDS = (sizeof(T) + 3) / 4;
+
+public:
+  SeqLock() {
+    T empty{};
+    store(0, empty);
+    store(1, empty);
+  }
+
+  void write(const T &value) {
+    uint32_t s = seq.load(std::memory_order_relaxed);
+
+    seq.store(s + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    store(0, value);
+
+    // the release store keeps copy 0 before it, the fence keeps copy 1
+    // after it, or a reader of copy 1 could accept half of the new value
+    seq.store(s + 2, std::memory_order_release);
+    std::atomic_thread_fence(std::memory_order_release);
+    store(1, value);
+  }
+
+  T read() const {
+    T value;
+    uint32_t s1, s2;
+
+    do {
+      s1 = seq.load(std::memory_order_acquire);
+      load(s1 & 1, value);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      s2 = seq.load(std::memory_order_relaxed);
+    } while (s1 != s2);
+
+    return value;
+  }
+
+  // Number of completed writes; cheap way to see if anything new arrived.
+  uint32_t version() const { return seq.load(std::memory_order_acquire) / 2; }
+
+private:
+  void store(int slot, const T &value) {
+    uint32_t words[WORDS] = {};
+    memcpy(words, &value, sizeof(T));
+    for (size_t i = 0; i < WORDS; i++)
+      data[slot][i].store(words[i], std::memory_order_relaxed);
+  }
+
+  void load(int slot, T &value) const {
+    uint32_t words[WORDS];
+    for (size_t i = 0; i < WORDS; i++)
+      words[i] = data[slot][i].load(std::memory_order_relaxed);
+    memcpy(&value, words, sizeof(T));
+  }
+
+  std::atomic<uint32_t> seq{0};
+  std::atomic<uint32_t> data[2][WORDS];
+};
+
+#endif
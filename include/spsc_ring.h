@@ -0,0 +1,57 @@
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <type_traits>
+
+#ifndef spsc_ring_h
+#define spsc_ring_h
+
+// Bounded single-producer / single-consumer queue. head is only written by
+// the producer and tail only by the consumer, so neither side ever waits or
+// takes a lock; a full ring rejects the push instead of blocking.
+template <typename T, size_t N> class SPSCRing {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "SPSCRing needs a trivially copyable type");
+  static_assert(N && (N & (N - 1)) == 0, "SPSCRing size must be a power of 2");
+
+public:
+  bool push(const T &item) {
+    uint32_t h = head.load(std::memory_order_relaxed);
+    if (h - tail.load(std::memory_order_acquire) == N)
+      return false;
+
+    items[h % N] = item;
+    head.store(h + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side: the item pop() would return next, left in the ring.
+  const T *peek() const {
+    uint32_t t = tail.load(std::memory_order_relaxed);
+    if (head.load(std::memory_order_acquire) == t)
+      return NULL;
+    return &items[t % N];
+  }
+
+  bool pop(T *item) {
+    uint32_t t = tail.load(std::memory_order_relaxed);
+    if (head.load(std::memory_order_acquire) == t)
+      return false;
+
+    *item = items[t % N];
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+  }
+
+  size_t size() const {
+    return head.load(std::memory_order_acquire) -
+           tail.load(std::memory_order_acquire);
+  }
+
+private:
+  T items[N];
+  std::atomic<uint32_t> head{0};
+  std::atomic<uint32_t> tail{0};
+};
+
+#endif
@@ -0,0 +1,48 @@
+#include "pid.h"
+#include "pipeline.h"
+#include "ws_queue.h"
+#include <Arduino.h>
+
+#ifndef telemetry_h
+#define telemetry_h
+
+#define TLM_RATE 100
+
+// Channels a client can subscribe to. A frame is
+//   0x20, uint32 timestamp (us), uint16 channel mask,
+// followed by the payload of every channel in the mask, in this order, as
+// little-endian floats.
+enum TelemetryChannel : uint8_t {
+  TLM_YAW,      // yaw, yaw anchor
+  TLM_YAW_RATE, // dps
+  TLM_PID,      // error, p, i, d, output
+  TLM_OUTPUT,   // servo (deg from middle), motor (us)
+  TLM_RAW,      // RawICUData
+  TLM_CAL,      // CalibratedICUData
+  TLM_CHANNEL_COUNT,
+};
+
+struct TelemetrySample {
+  EstimatorState estimator;
+  float yawAnchor;
+  PIDTerms pid;
+  float servo, motor;
+};
+
+// Each client subscribes with one decimation per channel relative to
+// TLM_RATE (WSSubscription::decimation), 0 turns a channel off.
+//
+// Advances the telemetry tick and fills masks, by client slot, with the
+// channels due on it. False when no client has anything due.
+bool nextTelemetryMasks(uint16_t masks[WS_MAX_CLIENTS]);
+
+size_t telemetryFrameSize(uint16_t mask);
+size_t packTelemetry(uint8_t *buf, uint16_t mask,
+                     const TelemetrySample *sample);
+// One frame per distinct mask, shared by the clients that asked for it and
+// packed in place in a frame from the websocket pool; nothing is allocated
+// from the heap. A mask the pool has no room for is skipped for this tick.
+void sendTelemetry(const uint16_t masks[WS_MAX_CLIENTS],
+                   const TelemetrySample *sample);
+
+#endif
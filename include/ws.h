@@ -13,10 +13,34 @@
 // #define SSID "RT-GPON-4988"
 // #define PASSWORD "fK46Mkqt"
 
+// Without the access point above the boat opens its own after
+// WIFI_ATTEMPTS tries of WIFI_ATTEMPT_MS each; the page is then at
+// http://192.168.4.1. Its credentials are its own, set them with
+// -D SOFTAP_SSID=... -D SOFTAP_PASSWORD=... in build_flags.
+#ifndef SOFTAP_SSID
+#define SOFTAP_SSID "Quanta"
+#endif
+#ifndef SOFTAP_PASSWORD
+#define SOFTAP_PASSWORD "quanta-boat"
+#endif
+#define WIFI_ATTEMPT_MS 8000
+#define WIFI_ATTEMPTS 3
+// While its own access point is up and nobody is on it, the boat tries the
+// one above again this often.
+#define WIFI_RETRY_MS 60000
+
 extern AsyncWebSocket ws;
 
+// Mounts LittleFS and registers the handlers; nothing listens before
+// startWS().
 bool setupWS(
     std::function<void(AsyncWebSocket *server, AsyncWebSocketClient *client,
                        const uint8_t *data, size_t len)>
         onMessage);
-void tickWS();
\ No newline at end of file
+void startWS();
+
+// Connecting goes on in the background, driven by tickWS().
+void startWiFi();
+void stopWiFi();
+
+void tickWS();
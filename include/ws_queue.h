@@ -0,0 +1,108 @@
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef ws_queue_h
+#define ws_queue_h
+
+// Outgoing websocket traffic. A frame is built once and shared, by
+// reference, between the queues of the clients it goes to. Each client has
+// its own queue bounded in messages and bytes, drained by wsPump() only as
+// fast as that client's socket takes frames, so a slow browser holds at most
+// WS_QUEUE_BYTES and never delays the others.
+#define WS_MAX_CLIENTS 4
+#define WS_QUEUE_MESSAGES 32
+#define WS_QUEUE_BYTES 8192
+#define WS_CHANNELS 8
+// Frames are carved from a static pool of WS_POOL_CHUNK byte chunks, sized
+// for every queue at its caps plus WS_POOL_SLACK for frames being built or
+// written, so memory use does not move with the traffic.
+#define WS_POOL_CHUNK 32
+#define WS_POOL_SLACK 4096
+// Frames built on the handoff task skip the lock and the pool: they go into
+// a ring of their own, a power of two in bytes, which wsPump() drains.
+#define WS_HANDOFF_BYTES 4096
+
+// What a frame does when it finds its client's queue full.
+enum WSDelivery : uint8_t {
+  // acks, state and results: never dropped. A client that cannot keep up
+  // with even these is closed and has to reload.
+  WS_RELIABLE,
+  // streams: the oldest queued stream frame makes room
+  WS_DROP_OLDEST,
+  // status: takes the place of a queued frame with the same id, so only
+  // the newest one is ever waiting
+  WS_LATEST,
+};
+
+// Optional streams, picked per client with the Subscribe packet. Frames
+// sent without a stream go to every client.
+enum WSStream : uint8_t {
+  WS_STREAM_STATS = 1 << 0,       // LoopTiming, Stats
+  WS_STREAM_AUTOTUNE = 1 << 1,    // autotune progress
+  WS_STREAM_CALIBRATION = 1 << 2, // calibration progress, mag fit status
+  WS_STREAM_CAPTURE = 1 << 3,     // raw capture batches
+  WS_STREAM_MISSION = 1 << 4,     // mission progress
+  WS_STREAM_ALL = 0xff,
+};
+
+// Telemetry decimations are per client too, stored here with the streams;
+// telemetry.cpp gives them their meaning.
+struct WSSubscription {
+  uint8_t streams;
+  uint8_t decimation[WS_CHANNELS];
+};
+
+// Until a client subscribes it gets every stream and yaw telemetry at the
+// old 180 ms cadence.
+#define WS_DEFAULT_SUBSCRIPTION {WS_STREAM_ALL, {18}}
+
+struct WSFrame {
+  void *handle;
+  uint8_t *data;
+};
+
+// From here on the calling task builds its frames in the handoff ring, and
+// wsFrame(), wsSend() and wsSubscribers() never wait on another task from
+// it. For one task, the IMU task, so control does not wait on the network
+// or the loop; its frames go out at the next wsPump().
+void wsUseHandoff();
+
+// clients is a mask of slots; a frame nobody takes is freed right away.
+// With the pool out of room the frame is counted as dropped and comes back
+// with NULL data, which wsSend() ignores; check data before writing.
+WSFrame wsFrame(size_t len);
+void wsSend(WSFrame frame, WSDelivery delivery, uint32_t clients);
+// Mask of the connected clients subscribed to stream (0 for every client).
+uint32_t wsSubscribers(uint8_t stream);
+
+// Connection events from the server. wsOpen returns the slot, or -1 when
+// every slot is taken and the connection should be refused.
+int wsOpen(uint32_t id);
+void wsClose(uint32_t id);
+void wsSubscribe(uint32_t id, uint8_t streams, const uint8_t *decimation,
+                 size_t len);
+// Subscriptions of the connected clients by slot, returns their mask.
+uint32_t wsSubscriptions(WSSubscription *subs);
+
+// Moves queued frames into the sockets that can take them and closes the
+// clients that overflowed with reliable frames. Run from one task only.
+void wsPump();
+
+struct WSStats {
+  uint32_t frames;  // built
+  uint32_t dropped; // all clients together, and frames the pool or the
+                    // handoff ring had no room for
+  uint32_t closed;  // clients closed on a full queue
+};
+
+struct WSClientStats {
+  uint32_t id; // 0 for a free slot
+  uint32_t depth, maxDepth;
+  uint32_t bytes;
+  uint32_t sent, dropped, replaced;
+};
+
+extern WSStats wsStats;
+extern WSClientStats wsClientStats[WS_MAX_CLIENTS];
+
+#endif
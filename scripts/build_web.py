@@ -0,0 +1,37 @@
+# PlatformIO pre-script: builds the web page into data/ before the LittleFS
+# image, so the page on the boat always matches the firmware's protocol.
+# data/index.html.gz and its ETag are build outputs, not sources.
+import os
+import shutil
+import subprocess
+
+Import("env")
+
+PROJECT = env.subst("$PROJECT_DIR")
+WEB = os.path.join(PROJECT, "web")
+PAGE = os.path.join(PROJECT, "data", "index.html.gz")
+
+# the image is made from data/, which git does not keep while it is empty
+os.makedirs(os.path.dirname(PAGE), exist_ok=True)
+
+
+def newest_source():
+    newest = 0
+    for root, dirs, files in os.walk(WEB):
+        dirs[:] = [d for d in dirs if d not in ("node_modules", "dist")]
+        for name in files:
+            newest = max(newest, os.path.getmtime(os.path.join(root, name)))
+    return newest
+
+
+def build_web(source, target, env):
+    if os.path.exists(PAGE) and os.path.getmtime(PAGE) >= newest_source():
+        return
+
+    tool = "bun" if shutil.which("bun") else "npm"
+    if not os.path.isdir(os.path.join(WEB, "node_modules")):
+        subprocess.run([tool, "install"], cwd=WEB, check=True)
+    subprocess.run([tool, "run", "build"], cwd=WEB, check=True)
+
+
+env.AddPreAction("$BUILD_DIR/${ESP32_FS_IMAGE_NAME}.bin", build_web)
@@ -0,0 +1,220 @@
+#include "acquisition.h"
+#include "hal.h"
+#include "i2c_engine.h"
+
+#define MPU_SMPLRT_DIV 0x19
+#define MPU_CONFIG 0x1A
+#define MPU_FIFO_EN 0x23
+#define MPU_INT_PIN_CFG 0x37
+#define MPU_INT_ENABLE 0x38
+#define MPU_USER_CTRL 0x6A
+#define MPU_FIFO_COUNTH 0x72
+#define MPU_FIFO_R_W 0x74
+#define MPU_FIFO_SIZE 1024
+
+#define HMC_CONFIG_A 0x00
+#define HMC_MODE 0x02
+#define HMC_DATA 0x03
+
+#define I2C_TIMEOUT_MS 10
+
+AcquisitionStats acqStats;
+TimingStats timingStats;
+
+static I2CTransaction countTx, dataTx, magTx, resetTx[2];
+static uint8_t countBuf[2];
+static bool dataOutstanding = false;
+static bool resetPending = false;
+
+static bool clockStarted = false;
+static uint32_t clockLast, lastWake;
+
+static bool writeMPU(uint8_t reg, uint8_t value) {
+  return halI2CWrite(MPU6050_ADDR, reg, value, I2C_TIMEOUT_MS) == I2C_OK;
+}
+
+static bool resetFifo() {
+  return writeMPU(MPU_USER_CTRL, 0x04) && // FIFO_RESET
+         writeMPU(MPU_USER_CTRL, 0x40);   // FIFO_EN
+}
+
+// The FIFO_RESET and FIFO_EN pair of resetFifo(), through the I2C engine so
+// a glitching bus costs the cycle and no more. Until both went through the
+// FIFO is not read, the next cycle tries again.
+static void queueFifoReset(uint32_t deadline) {
+  I2CTransaction *batch[2] = {&resetTx[0], &resetTx[1]};
+  int n = 0;
+
+  resetPending = true;
+  if (i2cSubmitWrite(&resetTx[0], MPU6050_ADDR, MPU_USER_CTRL, 0x04, deadline))
+    n++;
+  if (n == 1 &&
+      i2cSubmitWrite(&resetTx[1], MPU6050_ADDR, MPU_USER_CTRL, 0x40, deadline))
+    n++;
+
+  if (n == 2 && i2cAwait(batch, n, deadline))
+    resetPending =
+        resetTx[0].status != I2C_OK || resetTx[1].status != I2C_OK;
+}
+
+bool setupMPUFifo(uint16_t rateHz) {
+  // DLPF 3 (44 Hz accel, 42 Hz gyro) keeps the gyro output at 1 kHz
+  if (!writeMPU(MPU_CONFIG, 3) ||
+      !writeMPU(MPU_SMPLRT_DIV, 1000 / rateHz - 1))
+    return false;
+
+  // active high 50 us pulse, keep I2C_BYPASS_EN for the magnetometer
+  if (!writeMPU(MPU_INT_PIN_CFG, 0x02))
+    return false;
+
+  return writeMPU(MPU_FIFO_EN, 0xF8) && // TEMP, XG, YG, ZG, ACCEL
+         resetFifo() && writeMPU(MPU_INT_ENABLE, 0x01); // DATA_RDY_EN
+}
+
+bool setupHMCContinuous(HMCRate rate) {
+  uint8_t value;
+
+  if (halI2CRead(HMC5883_ADDR, HMC_CONFIG_A, &value, 1, I2C_TIMEOUT_MS) !=
+      I2C_OK)
+    return false;
+
+  value &= 0b11100011;
+  value |= rate << 2;
+
+  return halI2CWrite(HMC5883_ADDR, HMC_CONFIG_A, value, I2C_TIMEOUT_MS) ==
+             I2C_OK &&
+         halI2CWrite(HMC5883_ADDR, HMC_MODE, 0x00, I2C_TIMEOUT_MS) == I2C_OK;
+}
+
+AcquisitionResult acquire(uint8_t *frames, int maxFrames, uint8_t *magBuf,
+                          bool wantMag, uint32_t deadline) {
+  AcquisitionResult result = {0, false, true};
+
+  // a transfer we stopped waiting for still owns its buffer
+  if (countTx.pending() || dataTx.pending() || magTx.pending() ||
+      resetTx[0].pending() || resetTx[1].pending()) {
+    acqStats.staleCycles++;
+    return result;
+  }
+
+  // a FIFO read that failed part way leaves the frame boundary unknown
+  if (dataOutstanding && dataTx.status != I2C_OK &&
+      dataTx.status != I2C_EXPIRED)
+    resetPending = true;
+  dataOutstanding = false;
+
+  // the reset gets the cycle, the frames after it are read on the next one
+  if (resetPending) {
+    queueFifoReset(deadline);
+    acqStats.staleCycles++;
+    return result;
+  }
+
+  I2CTransaction *batch[2] = {&countTx, &magTx};
+  bool magSubmitted = false;
+
+  if (!i2cSubmitRead(&countTx, MPU6050_ADDR, MPU_FIFO_COUNTH, countBuf, 2,
+                     deadline)) {
+    acqStats.staleCycles++;
+    return result;
+  }
+
+  if (wantMag)
+    magSubmitted = i2cSubmitRead(&magTx, HMC5883_ADDR, HMC_DATA, magBuf,
+                                 MAG_BURST_LEN, deadline);
+
+  if (!i2cAwait(batch, magSubmitted ? 2 : 1, deadline)) {
+    acqStats.staleCycles++;
+    return result;
+  }
+
+  if (magSubmitted && magTx.status == I2C_OK) {
+    result.magFresh = true;
+    acqStats.magReads++;
+  }
+
+  if (countTx.status != I2C_OK) {
+    acqStats.staleCycles++;
+    return result;
+  }
+
+  result.stale = false;
+  uint16_t count = countBuf[0] << 8 | countBuf[1];
+
+  // Once full, the FIFO drops its oldest bytes and 1024 is not a multiple of
+  // the frame size, so everything after that point is misaligned.
+  if (count > MPU_FIFO_SIZE - MPU_BURST_LEN) {
+    acqStats.overflows++;
+    queueFifoReset(deadline);
+    return result;
+  }
+
+  int n = count / MPU_BURST_LEN;
+  if (n > maxFrames)
+    n = maxFrames;
+  if (n == 0)
+    return result;
+
+  I2CTransaction *data = &dataTx;
+  if (!i2cSubmitRead(&dataTx, MPU6050_ADDR, MPU_FIFO_R_W, frames,
+                     n * MPU_BURST_LEN, deadline)) {
+    result.stale = true;
+    acqStats.staleCycles++;
+    return result;
+  }
+
+  dataOutstanding = true;
+  if (!i2cAwait(&data, 1, deadline) || dataTx.status != I2C_OK) {
+    result.stale = true;
+    acqStats.staleCycles++;
+    return result;
+  }
+
+  dataOutstanding = false;
+  acqStats.drains++;
+  acqStats.frames += n;
+  result.frames = n;
+  return result;
+}
+
+void stampFrames(uint32_t wakeTime, int frames, uint32_t *stamps) {
+  if (timingStats.periodUs == 0)
+    timingStats.periodUs = 1000000.0f / SAMPLE_RATE;
+
+  if (timingStats.wakes++ > 0) {
+    float interval = (int32_t)(wakeTime - lastWake);
+    float late = fabsf(interval - ACQ_BURST * timingStats.periodUs);
+    int bin = late / TIMING_BIN_US;
+    timingStats.jitter[bin < TIMING_BINS ? bin : TIMING_BINS - 1]++;
+  }
+  lastWake = wakeTime;
+
+  if (frames <= 0)
+    return;
+  if (frames > ACQ_BURST)
+    timingStats.overruns++;
+
+  // the last frame is the newest, it was produced just before the wake
+  uint32_t predicted = clockLast + lroundf(frames * timingStats.periodUs);
+  int32_t error = wakeTime - predicted;
+  uint32_t last;
+
+  if (!clockStarted || abs(error) > CLOCK_RESYNC_US) {
+    if (clockStarted)
+      timingStats.resyncs++;
+    clockStarted = true;
+    last = wakeTime;
+  } else {
+    timingStats.periodUs += CLOCK_PERIOD_GAIN * error / frames;
+    last = predicted + lroundf(CLOCK_PHASE_GAIN * error);
+  }
+
+  for (int i = 0; i < frames; i++)
+    stamps[i] = last - lroundf((frames - 1 - i) * timingStats.periodUs);
+  clockLast = last;
+}
+
+void recordCycleTime(uint32_t us) {
+  if (us > timingStats.maxCycleUs)
+    timingStats.maxCycleUs = us;
+}
@@ -0,0 +1,161 @@
+#include "actuator.h"
+#include "hal.h"
+#include "seqlock.h"
+#include <atomic>
+#include <math.h>
+
+struct ActuatorCommand {
+  float us;
+  uint32_t time;
+};
+
+// command, armRequested and state cross tasks, the rest belongs to
+// actuatorTick
+struct Actuator {
+  ActuatorConfig config;
+  bool attached;
+  SeqLock<ActuatorCommand> command;
+  std::atomic<bool> armRequested{false};
+  std::atomic<uint8_t> state{ACT_DISARMED};
+
+  uint32_t seen;        // command version
+  bool commanded;
+  uint32_t lastCommand; // time of the command in to
+  uint8_t step;
+  uint32_t stepStart, lastTick;
+  float from, to;
+  uint32_t rampStart, ramp;
+  float output; // 0 until the first pulse
+};
+
+ActuatorStats actuatorStats[ACT_COUNT];
+const char *const actuatorNames[ACT_COUNT] = {"servo", "motor"};
+
+static Actuator actuators[ACT_COUNT];
+
+bool actuatorBegin(ActuatorChannel channel, const ActuatorConfig &config) {
+  Actuator &a = actuators[channel];
+
+  a.config = config;
+  a.state = ACT_DISARMED;
+  a.seen = a.command.version(); // older commands were for the old config
+  a.commanded = false;
+  a.output = 0;
+  a.attached = halPWMBegin(channel, config.pin, config.hz);
+  return a.attached;
+}
+
+void actuatorArm(ActuatorChannel channel) {
+  actuators[channel].armRequested = true;
+}
+
+ActuatorState actuatorState(ActuatorChannel channel) {
+  return (ActuatorState)actuators[channel].state.load();
+}
+
+void actuatorCommand(ActuatorChannel channel, float us, uint32_t now) {
+  Actuator &a = actuators[channel];
+  if (isnan(us))
+    return;
+
+  if (us < a.config.minUs || us > a.config.maxUs) {
+    actuatorStats[channel].clamped++;
+    us = fmaxf(a.config.minUs, fminf(a.config.maxUs, us));
+  }
+  a.command.write({us, now});
+}
+
+static void writeOutput(ActuatorChannel channel, float us) {
+  halPWMWrite(channel, us);
+  actuators[channel].output = us;
+  actuatorStats[channel].output = us;
+}
+
+static float rampTarget(const Actuator &a, uint32_t now) {
+  uint32_t t = now - a.rampStart;
+
+  if (a.ramp == 0 || t >= a.ramp)
+    return a.to;
+  return a.from + (a.to - a.from) * t / a.ramp;
+}
+
+// Holds each arming pulse for its time, true once the sequence is over.
+static bool tickArming(ActuatorChannel channel, uint32_t now) {
+  Actuator &a = actuators[channel];
+  const ActuatorConfig &c = a.config;
+
+  while (a.step < c.armSteps &&
+         now - a.stepStart >= c.arming[a.step].ms * 1000u) {
+    a.stepStart += c.arming[a.step].ms * 1000u;
+    a.step++;
+  }
+  if (a.step < c.armSteps) {
+    writeOutput(channel, c.arming[a.step].us);
+    return false;
+  }
+
+  // commands ramp and slew from the last arming pulse
+  a.from = a.to = a.output;
+  a.ramp = 0;
+  a.state = ACT_ARMED;
+  return true;
+}
+
+static void tickChannel(ActuatorChannel channel, uint32_t now) {
+  Actuator &a = actuators[channel];
+  const ActuatorConfig &c = a.config;
+
+  if (a.armRequested.exchange(false)) {
+    a.step = 0;
+    a.stepStart = now;
+    a.state = ACT_ARMING;
+  }
+
+  if (a.state == ACT_ARMING && !tickArming(channel, now)) {
+    a.lastTick = now;
+    return;
+  }
+  if (a.state != ACT_ARMED)
+    return;
+
+  uint32_t version = a.command.version();
+  if (version != a.seen) {
+    ActuatorCommand command = a.command.read();
+    uint32_t period = command.time - a.lastCommand;
+    bool stream = a.commanded && period > 1000000 / ACTUATOR_RATE &&
+                  period <= ACTUATOR_INTERPOLATE_MAX_US;
+
+    a.from = a.output > 0 ? rampTarget(a, now) : command.us;
+    a.to = command.us;
+    a.rampStart = now;
+    a.ramp = c.interpolate && stream ? period : 0;
+    a.lastCommand = command.time;
+    a.seen = version;
+    a.commanded = true;
+  }
+
+  // nothing to send before the first command
+  if (!a.commanded && a.output == 0)
+    return;
+
+  float target = rampTarget(a, now);
+  float output = target;
+
+  if (c.slewUsPerS > 0 && a.output > 0) {
+    float step = c.slewUsPerS * (now - a.lastTick) * 1e-6f;
+
+    if (fabsf(target - a.output) > step) {
+      output = a.output + copysignf(step, target - a.output);
+      actuatorStats[channel].slewLimited++;
+    }
+  }
+
+  writeOutput(channel, output);
+  a.lastTick = now;
+}
+
+void actuatorTick(uint32_t now) {
+  for (int i = 0; i < ACT_COUNT; i++)
+    if (actuators[i].attached)
+      tickChannel((ActuatorChannel)i, now);
+}
@@ -0,0 +1,119 @@
+#include "autotune.h"
+
+static_assert(AUTOTUNE_MAX_CYCLES + 2 <= UINT8_MAX,
+              "rises counts up to cycles + 2 in a uint8_t");
+
+void autotuneGains(AutotuneRule rule, float ku, float tu,
+                   AutotuneResult *result) {
+  float kp, ti, td;
+
+  if (rule == TUNE_TYREUS_LUYBEN) {
+    kp = ku / 2.2f;
+    ti = 2.2f * tu;
+    td = tu / 6.3f;
+  } else {
+    kp = 0.6f * ku;
+    ti = tu / 2;
+    td = tu / 8;
+  }
+
+  result->ku = ku;
+  result->tu = tu;
+  result->kp = kp;
+  result->ki = kp / ti;
+  result->kd = kp * td;
+}
+
+void RelayAutotuner::start(const AutotuneConfig &cfg, uint32_t timestamp) {
+  config = cfg;
+  phase = AT_RUNNING;
+  failure = NULL;
+  output = 0;
+  startTime = timestamp;
+  peakHigh = peakLow = 0;
+  rises = 0;
+  periodSum = amplitudeSum = 0;
+  result = {};
+}
+
+void RelayAutotuner::stop() {
+  if (phase == AT_RUNNING)
+    fail("stopped");
+}
+
+void RelayAutotuner::fail(const char *reason) {
+  phase = AT_FAILED;
+  failure = reason;
+  output = 0;
+}
+
+float RelayAutotuner::update(float error, uint32_t timestamp) {
+  if (phase != AT_RUNNING)
+    return 0;
+
+  if (timestamp - startTime > AUTOTUNE_TIMEOUT_S * 1000000u) {
+    fail("no steady oscillation before the timeout");
+    return 0;
+  }
+  if (fabsf(error) > AUTOTUNE_MAX_ERROR) {
+    fail("heading error out of range, relay amplitude too small?");
+    return 0;
+  }
+
+  float h = config.hysteresis;
+  if (output == 0)
+    output = error >= 0 ? config.amplitude : -config.amplitude;
+
+  peakHigh = fmaxf(peakHigh, error);
+  peakLow = fminf(peakLow, error);
+
+  if (output > 0 && error < -h) {
+    output = -config.amplitude;
+  } else if (output < 0 && error > h) {
+    // a rise closes one period: rise to rise, with one peak on either side
+    output = config.amplitude;
+
+    if (rises > 1) {
+      float period = (timestamp - lastRise) / 1e6f;
+      periodSum += period;
+      amplitudeSum += (peakHigh - peakLow) / 2;
+      minPeriod = rises == 2 ? period : fminf(minPeriod, period);
+      maxPeriod = rises == 2 ? period : fmaxf(maxPeriod, period);
+    }
+
+    lastRise = timestamp;
+    peakHigh = peakLow = error;
+    if (++rises > config.cycles + 1)
+      finish();
+  }
+
+  return output;
+}
+
+void RelayAutotuner::finish() {
+  float tu = periodSum / config.cycles;
+  float a = amplitudeSum / config.cycles;
+  float h = config.hysteresis;
+
+  if (maxPeriod - minPeriod > 0.3f * tu) {
+    fail("period not steady, disturbance or too few cycles");
+    return;
+  }
+  if (a <= h) {
+    fail("oscillation smaller than the hysteresis");
+    return;
+  }
+
+  float ku = 4 * config.amplitude / (PI * sqrtf(a * a - h * h));
+  autotuneGains(config.rule, ku, tu, &result);
+  phase = AT_DONE;
+  output = 0;
+}
+
+float RelayAutotuner::getProgress() const {
+  if (phase == AT_DONE)
+    return 100;
+  // the first rise starts the transient period, the second the first
+  // measured one
+  return 100.0f * rises / (config.cycles + 2);
+}
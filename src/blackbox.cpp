@@ -0,0 +1,103 @@
+#include "blackbox.h"
+
+// Quantization of each field; raw sensor values go back to register counts
+// (see decodeMPU6050/decodeHMC5883), so those survive the round trip exactly.
+static const float scales[BB_FIELDS] = {
+    100, 100, 100,           // yaw, anchor, yaw rate
+    100, 100, 100, 100, 100, // PID error, p, i, d, output
+    100, 10,                 // servo, motor
+    RAW_LSB_PER_UNIT,        // accel, gyro, mag
+};
+
+// Record field order, matching scales.
+static void fieldsOf(TelemetrySample *s, float **fields) {
+  RawICUData &raw = s->estimator.raw;
+  float *order[BB_FIELDS] = {
+      &s->estimator.yaw, &s->yawAnchor, &s->estimator.yawRate,
+      &s->pid.error,     &s->pid.p,     &s->pid.i,
+      &s->pid.d,         &s->pid.output, &s->servo,
+      &s->motor,         &raw.ax,       &raw.ay,
+      &raw.az,           &raw.gx,       &raw.gy,
+      &raw.gz,           &raw.mx,       &raw.my,
+      &raw.mz,
+  };
+  memcpy(fields, order, sizeof(order));
+}
+
+static uint8_t *putVarint(uint8_t *p, uint32_t value) {
+  while (value >= 0x80) {
+    *p++ = value | 0x80;
+    value >>= 7;
+  }
+  *p++ = value;
+  return p;
+}
+
+static const uint8_t *getVarint(const uint8_t *p, const uint8_t *end,
+                                uint32_t *value) {
+  uint32_t result = 0;
+
+  for (int shift = 0; shift < 35 && p < end; shift += 7) {
+    uint8_t byte = *p++;
+    result |= (uint32_t)(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) {
+      *value = result;
+      return p;
+    }
+  }
+  return NULL;
+}
+
+void blackboxBeginBlock(BlackboxCodec *codec) {
+  memset(codec, 0, sizeof(BlackboxCodec));
+}
+
+size_t blackboxEncode(BlackboxCodec *codec, const TelemetrySample *sample,
+                      uint8_t flags, uint8_t *out) {
+  float *fields[BB_FIELDS];
+  fieldsOf(const_cast<TelemetrySample *>(sample), fields);
+
+  uint8_t *p = out;
+  *p++ = flags;
+  p = putVarint(p, sample->estimator.timestamp - codec->timestamp);
+  codec->timestamp = sample->estimator.timestamp;
+
+  for (int i = 0; i < BB_FIELDS; i++) {
+    int32_t q = lroundf(*fields[i] * scales[i]);
+    int32_t delta = q - codec->fields[i];
+    p = putVarint(p, ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31));
+    codec->fields[i] = q;
+  }
+
+  return p - out;
+}
+
+size_t blackboxDecode(BlackboxCodec *codec, const uint8_t *in, size_t len,
+                      TelemetrySample *sample, uint8_t *flags) {
+  const uint8_t *p = in, *end = in + len;
+  uint32_t value;
+
+  if (p == end)
+    return 0;
+  *flags = *p++;
+
+  BlackboxCodec next = *codec;
+  if (!(p = getVarint(p, end, &value)))
+    return 0;
+  next.timestamp += value;
+
+  float *fields[BB_FIELDS];
+  fieldsOf(sample, fields);
+
+  for (int i = 0; i < BB_FIELDS; i++) {
+    if (!(p = getVarint(p, end, &value)))
+      return 0;
+    next.fields[i] += (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+    *fields[i] = next.fields[i] / scales[i];
+  }
+
+  *codec = next;
+  sample->estimator.timestamp = codec->timestamp;
+  sample->estimator.stale = *flags & BB_STALE;
+  return p - in;
+}
@@ -0,0 +1,28 @@
+#include "boot.h"
+#include <Arduino.h>
+#include <stdio.h>
+
+uint32_t bootTimeline[BOOT_PHASE_COUNT];
+
+#define BOOT_NAME(name) #name,
+const char *const bootPhaseNames[BOOT_PHASE_COUNT] = {
+    BOOT_PHASE_LIST(BOOT_NAME)};
+#undef BOOT_NAME
+
+void bootMark(BootPhase phase) {
+  // 0 is taken for not reached
+  if (bootTimeline[phase] == 0)
+    bootTimeline[phase] = millis() ? millis() : 1;
+}
+
+size_t formatBootTimeline(char *buf, size_t size) {
+  size_t len = snprintf(buf, size, "boot:");
+
+  for (int i = 0; i < BOOT_PHASE_COUNT && len < size; i++)
+    if (bootTimeline[i])
+      len += snprintf(buf + len, size - len, "%s %s %u ms",
+                      len > 5 ? "," : "", bootPhaseNames[i],
+                      (unsigned)bootTimeline[i]);
+
+  return len < size ? len : size - 1;
+}
@@ -0,0 +1,71 @@
+#include "capture.h"
+#include "hal.h"
+#include "ws_queue.h"
+#include <atomic>
+
+static std::atomic<bool> enabled{false};
+static bool running = false;
+static uint32_t sequence;
+static uint8_t batch[CAPTURE_HEADER_LEN + CAPTURE_BATCH * CAPTURE_SAMPLE_LEN];
+static uint8_t count = 0;
+
+static const float countsPerUnit[9] = {RAW_LSB_PER_UNIT};
+
+void rawToCounts(const RawICUData *raw, int16_t *counts) {
+  const float *values = &raw->ax;
+  for (int i = 0; i < 9; i++)
+    counts[i] = lroundf(values[i] * countsPerUnit[i]);
+}
+
+void countsToRaw(const int16_t *counts, RawICUData *raw) {
+  float *values = &raw->ax;
+  for (int i = 0; i < 9; i++)
+    values[i] = counts[i] / countsPerUnit[i];
+}
+
+static void sendBatch() {
+  if (count == 0)
+    return;
+
+  size_t len = CAPTURE_HEADER_LEN + count * CAPTURE_SAMPLE_LEN;
+  batch[CAPTURE_HEADER_LEN - 1] = count;
+
+  // the sequence numbers show the page what a slow link dropped
+  auto frame = wsFrame(len);
+  if (frame.data != NULL) {
+    memcpy(frame.data, batch, len);
+    wsSend(frame, WS_DROP_OLDEST, wsSubscribers(WS_STREAM_CAPTURE));
+  }
+  count = 0;
+}
+
+void setCapture(bool enable) { enabled = enable; }
+
+bool captureEnabled() { return enabled; }
+
+void captureSample(uint32_t timestamp, const RawICUData *raw, bool magFresh) {
+  if (enabled != running) {
+    running = enabled;
+    sendBatch();
+    sequence = 0;
+  }
+
+  if (!running)
+    return;
+
+  if (count == 0) {
+    batch[0] = 0x31;
+    memcpy(batch + 1, &sequence, 4);
+    memcpy(batch + 5, &timestamp, 4);
+  }
+
+  uint8_t *p = batch + CAPTURE_HEADER_LEN + count * CAPTURE_SAMPLE_LEN;
+  int16_t counts[9];
+  rawToCounts(raw, counts);
+  memcpy(p, counts, sizeof(counts));
+  p[sizeof(counts)] = magFresh ? CAPTURE_MAG_FRESH : 0;
+
+  sequence++;
+  if (++count == CAPTURE_BATCH)
+    sendBatch();
+}
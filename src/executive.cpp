@@ -0,0 +1,123 @@
+#include "executive.h"
+#include "acquisition.h"
+#include "hal.h"
+#include <Arduino.h>
+
+static_assert(ACQ_BURST == CONTROL_DECIMATION,
+              "a wake has to be one control period");
+
+#define GROUP_NAME(name, rate, priority) #name,
+const char *const rateGroupNames[RATE_GROUP_COUNT] = {
+    RATE_GROUP_LIST(GROUP_NAME)};
+#undef GROUP_NAME
+
+#define GROUP_RATE(name, rate, priority) rate,
+const uint16_t rateGroupRates[RATE_GROUP_COUNT] = {RATE_GROUP_LIST(GROUP_RATE)};
+#undef GROUP_RATE
+
+#define GROUP_PRIORITY(name, rate, priority) priority,
+static const uint8_t priorities[RATE_GROUP_COUNT] = {
+    RATE_GROUP_LIST(GROUP_PRIORITY)};
+#undef GROUP_PRIORITY
+
+RateGroupStats rateGroupStats[RATE_GROUP_COUNT];
+
+// Each group is only ever run from one task, the one that owns this.
+struct RateGroup {
+  Job *jobs;
+  uint32_t lastRelease;
+  uint32_t windowStart, windowBusy; // for utilization
+};
+
+static RateGroup groups[RATE_GROUP_COUNT];
+static uint8_t controlSamples = 0;
+static float controlDt = 0;
+
+void executiveAdd(Job *job) {
+  Job **tail = &groups[job->group].jobs;
+  while (*tail != NULL)
+    tail = &(*tail)->next;
+  *tail = job;
+}
+
+void rateGroupRun(RateGroupId id, const RateContext &ctx) {
+  RateGroup &g = groups[id];
+  RateGroupStats &s = rateGroupStats[id];
+  uint32_t period = 1000000 / rateGroupRates[id];
+  uint32_t start = micros();
+
+  for (Job *job = g.jobs; job != NULL; job = job->next)
+    if (job->enabled && !job->run(ctx))
+      job->enabled = false;
+
+  uint32_t end = micros(), busy = end - start;
+  bool late = s.releases && ctx.release - g.lastRelease > period * 3 / 2;
+  if (late || busy > period)
+    s.overruns++;
+
+  g.lastRelease = ctx.release;
+  s.lastUs = busy;
+  if (busy > s.maxUs)
+    s.maxUs = busy;
+  s.busyUs += busy;
+
+  // windows of a second or more, the first one opens as the first release
+  // ends
+  if (s.releases++ == 0) {
+    g.windowStart = end;
+    return;
+  }
+  g.windowBusy += busy;
+  if (end - g.windowStart >= 1000000) {
+    s.utilization = g.windowBusy * 100.0f / (end - g.windowStart);
+    g.windowStart = end;
+    g.windowBusy = 0;
+  }
+}
+
+void executiveSample(const EstimatorState &state, bool newest) {
+  RateContext ctx = {state.timestamp, state.stale ? 0 : state.dt, state.stale,
+                     1 << GROUP_sensor};
+
+  // control first, so its output goes out with the least delay and the
+  // recorder logs it with the sample it was computed from
+  if (!state.stale) {
+    controlDt += state.dt;
+    controlSamples++;
+
+    // a late wake with two periods of samples still gets one release, its
+    // dt spans them
+    if (newest && controlSamples >= CONTROL_DECIMATION) {
+      ctx.released |= 1 << GROUP_control;
+      RateContext control = ctx;
+      control.dt = controlDt;
+      controlSamples = 0;
+      controlDt = 0;
+      rateGroupRun(GROUP_control, control);
+    }
+  }
+
+  rateGroupRun(GROUP_sensor, ctx);
+}
+
+static void runClockGroup(void *arg) {
+  auto id = (RateGroupId)(uintptr_t)arg;
+  uint32_t now = micros();
+  float dt = rateGroupStats[id].releases
+                 ? (now - groups[id].lastRelease) * 1e-6f
+                 : 0;
+
+  rateGroupRun(id, {now, dt, false, (uint8_t)(1 << id)});
+}
+
+// the groups after control are released by the clock
+bool executiveStart() {
+  bool started = true;
+
+  for (int i = GROUP_control + 1; i < RATE_GROUP_COUNT; i++)
+    started &= halTaskStart(rateGroupNames[i], priorities[i],
+                            1000 / rateGroupRates[i], runClockGroup,
+                            (void *)(uintptr_t)i);
+
+  return started;
+}
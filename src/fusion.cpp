@@ -0,0 +1,47 @@
+#include "fusion.h"
+#include "fastmath.h"
+
+const char fusionNameNXP[] = "nxp";
+const char fusionNameMadgwick[] = "madgwick";
+const char fusionNameMahony[] = "mahony";
+
+void ComplementaryFusion::update(const CalibratedICUData &c, float dt) {
+  float norm = sqrtf(c.ax * c.ax + c.ay * c.ay + c.az * c.az);
+  if (norm > 0) {
+    float gain = started ? dt / COMPLEMENTARY_TILT_S : 1;
+    up[0] += (c.ax / norm - up[0]) * gain;
+    up[1] += (c.ay / norm - up[1]) * gain;
+    up[2] += (c.az / norm - up[2]) * gain;
+
+    float len = sqrtf(up[0] * up[0] + up[1] * up[1] + up[2] * up[2]);
+    up[0] /= len, up[1] /= len, up[2] /= len;
+  }
+
+  float heading = tiltHeading(c, up);
+  if (!started) {
+    yaw = heading;
+    started = true;
+  }
+
+  float rate = c.gx * up[0] + c.gy * up[1] + c.gz * up[2];
+  yaw += rate * dt;
+  yaw += mathWrap180(heading - yaw) * (dt / COMPLEMENTARY_MAG_S);
+  yaw = mathWrap360(yaw);
+}
+
+// roll and pitch from up, then yaw about the vertical, as w, x, y, z
+void ComplementaryFusion::getQuaternion(float *w, float *x, float *y,
+                                        float *z) {
+  float roll = mathAtan2(up[1], up[2]);
+  float pitch = mathAtan2(-up[0], sqrtf(up[1] * up[1] + up[2] * up[2]));
+  float half = yaw * DEG_TO_RAD / 2;
+
+  float cr = mathCos(roll / 2), sr = mathSin(roll / 2);
+  float cp = mathCos(pitch / 2), sp = mathSin(pitch / 2);
+  float cy = mathCos(half), sy = mathSin(half);
+
+  *w = cr * cp * cy + sr * sp * sy;
+  *x = sr * cp * cy - cr * sp * sy;
+  *y = cr * sp * cy + sr * cp * sy;
+  *z = cr * cp * sy - sr * sp * cy;
+}
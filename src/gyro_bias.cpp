@@ -0,0 +1,185 @@
+#include "gyro_bias.h"
+#include "fastmath.h"
+#include "filters.h"
+#include "fusion.h"
+
+GyroTempModel gyroTempModel;
+
+void GyroBiasEstimator::reset() { *this = GyroBiasEstimator(); }
+
+void GyroBiasEstimator::modelBias(const CalibrationStore *cal,
+                                  const GyroTempModel *model, float temp,
+                                  float *out) const {
+  const float *base = &cal->gyroX;
+  for (int i = 0; i < 3; i++)
+    out[i] = base[i] + model->slope[i] * (temp - model->reference);
+}
+
+void GyroBiasEstimator::correct(const RawICUData *raw,
+                                const CalibrationStore *cal,
+                                const GyroTempModel *model,
+                                CalibratedICUData *c) {
+  modelBias(cal, model, raw->temp, bias);
+  for (int i = 0; i < 3; i++)
+    bias[i] += offset[i];
+
+  c->gx = raw->gx - bias[0];
+  c->gy = raw->gy - bias[1];
+  c->gz = raw->gz - bias[2];
+}
+
+void GyroBiasEstimator::endStillWindow(const CalibrationStore *cal,
+                                       const GyroTempModel *model) {
+  float temp = tempSum / GYRO_STILL_SAMPLES, expected[3];
+  modelBias(cal, model, temp, expected);
+
+  if (fitN >= GYRO_FIT_MAX_WINDOWS) {
+    fitN /= 2, fitT /= 2, fitTT /= 2;
+    for (int i = 0; i < 3; i++)
+      fitB[i] /= 2, fitTB[i] /= 2;
+  }
+
+  fitN++;
+  fitT += temp;
+  fitTT += (double)temp * temp;
+  for (int i = 0; i < 3; i++) {
+    float measured = gyroSum[i] / GYRO_STILL_SAMPLES;
+    offset[i] += GYRO_STILL_GAIN * (measured - expected[i] - offset[i]);
+    fitB[i] += measured;
+    fitTB[i] += (double)temp * measured;
+  }
+
+  stillWindows++;
+}
+
+void GyroBiasEstimator::onMag(const EstimatorState *state) {
+  float heading = tiltHeading(state->cal, upLast);
+
+  if (headingStarted) {
+    magTurn += wrap180(heading - lastHeading);
+
+    if (headingSamples >= GYRO_HEADING_SAMPLES) {
+      float error = (gyroTurn - magTurn) / headingTime;
+      float norm = sqrt(upSum[0] * upSum[0] + upSum[1] * upSum[1] +
+                        upSum[2] * upSum[2]);
+
+      if (fabsf(error) < GYRO_HEADING_MAX_ERROR &&
+          maxAccelError < GYRO_HEADING_MAX_ACCEL && norm > 0) {
+        // the gyro reads error dps too much about up
+        for (int i = 0; i < 3; i++)
+          offset[i] += GYRO_HEADING_GAIN * error * upSum[i] / norm;
+        headingWindows++;
+      }
+      headingStarted = false;
+    }
+  }
+
+  if (!headingStarted) {
+    headingStarted = true;
+    headingSamples = 0;
+    gyroTurn = magTurn = headingTime = 0;
+    upSum[0] = upSum[1] = upSum[2] = 0;
+    maxAccelError = 0;
+  }
+
+  lastHeading = heading;
+}
+
+bool GyroBiasEstimator::update(const EstimatorState *state,
+                               CalibrationStore *cal, GyroTempModel *model) {
+  const RawICUData &raw = state->raw;
+  const CalibratedICUData &c = state->cal;
+  const float gyro[3] = {raw.gx, raw.gy, raw.gz};
+  const float rate[3] = {c.gx, c.gy, c.gz};
+  float accel = sqrtf(c.ax * c.ax + c.ay * c.ay + c.az * c.az);
+  temp = raw.temp;
+
+  if (stillSamples == 0) {
+    for (int i = 0; i < 3; i++) {
+      gyroMin[i] = gyroMax[i] = gyro[i];
+      gyroSum[i] = 0;
+    }
+    accelMin = accelMax = accel;
+    tempSum = 0;
+  }
+
+  bool moving = false;
+  for (int i = 0; i < 3; i++) {
+    gyroMin[i] = fminf(gyroMin[i], gyro[i]);
+    gyroMax[i] = fmaxf(gyroMax[i], gyro[i]);
+    gyroSum[i] += gyro[i];
+    moving |= gyroMax[i] - gyroMin[i] > GYRO_STILL_RANGE ||
+              fabsf(rate[i]) > GYRO_STILL_RATE;
+  }
+  accelMin = fminf(accelMin, accel);
+  accelMax = fmaxf(accelMax, accel);
+  tempSum += raw.temp;
+  moving |= accelMax - accelMin > GYRO_STILL_ACCEL;
+
+  if (moving)
+    stillSamples = 0;
+  else if (++stillSamples == GYRO_STILL_SAMPLES) {
+    endStillWindow(cal, model);
+    stillSamples = 0;
+  }
+
+  if (accel > 0) {
+    for (int i = 0; i < 3; i++)
+      upLast[i] = (&c.ax)[i] / accel;
+
+    if (headingStarted) {
+      gyroTurn += (rate[0] * upLast[0] + rate[1] * upLast[1] +
+                   rate[2] * upLast[2]) *
+                  state->dt;
+      headingTime += state->dt;
+      for (int i = 0; i < 3; i++)
+        upSum[i] += upLast[i];
+      maxAccelError = fmaxf(maxAccelError, fabsf(accel - 1));
+      headingSamples++;
+    }
+
+    if (state->magFresh)
+      onMag(state);
+  }
+
+  if (++samplesSinceFit < GYRO_FIT_PERIOD || fitN < GYRO_FIT_MIN_WINDOWS)
+    return false;
+  samplesSinceFit = 0;
+  return fit(cal, model);
+}
+
+bool GyroBiasEstimator::fit(CalibrationStore *cal, GyroTempModel *model) {
+  double meanT = fitT / fitN;
+  double varT = fmax(fitTT / fitN - meanT * meanT, 0);
+
+  GyroTempModel next = *model;
+  float base[3], before[3], after[3];
+  next.reference = meanT;
+
+  for (int i = 0; i < 3; i++) {
+    double meanB = fitB[i] / fitN;
+    if (varT >= GYRO_FIT_MIN_SPREAD * GYRO_FIT_MIN_SPREAD)
+      next.slope[i] = (fitTB[i] / fitN - meanT * meanB) / varT;
+    // least squares passes through the means whatever the slope
+    base[i] = meanB;
+  }
+
+  CalibrationStore nextCal = *cal;
+  memcpy(&nextCal.gyroX, base, sizeof(base));
+  modelBias(cal, model, temp, before);
+  modelBias(&nextCal, &next, temp, after);
+
+  float change = 0;
+  for (int i = 0; i < 3; i++)
+    change = fmaxf(change, fabsf(after[i] - before[i]));
+  if (change < GYRO_FIT_MIN_CHANGE)
+    return false;
+
+  // the bias in use does not jump, the still windows move offset to 0
+  for (int i = 0; i < 3; i++)
+    offset[i] += before[i] - after[i];
+  memcpy(&cal->gyroX, base, sizeof(base));
+  *model = next;
+  fits++;
+  return true;
+}
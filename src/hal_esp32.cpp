@@ -0,0 +1,189 @@
+#include "hal.h"
+#include "executive.h"
+#include "i2c_engine.h"
+#include "ws.h"
+#include <Arduino.h>
+#include <Wire.h>
+#include <driver/i2c.h>
+#include <driver/ledc.h>
+#include <esp_timer.h>
+
+#define I2C_CLOCK_HZ 1000000
+// widest LEDC timer on the C3; at 50 Hz a step is 1.2 us
+#define PWM_BITS 14
+
+static uint32_t pwmPeriodUs[LEDC_CHANNEL_MAX];
+
+static TaskHandle_t i2cWorker = NULL;
+static SemaphoreHandle_t i2cDone = NULL;
+
+static I2CResult toI2CResult(esp_err_t err) {
+  if (err == ESP_OK)
+    return I2C_OK;
+  if (err == ESP_FAIL)
+    return I2C_NACK;
+  if (err == ESP_ERR_TIMEOUT)
+    return I2C_TIMEOUT;
+  return I2C_BUS_ERROR;
+}
+
+static void i2cWorkerTask(void *pvParameters) {
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    i2cEngineRun();
+    xSemaphoreGive(i2cDone);
+  }
+}
+
+bool halI2CBegin() {
+  if (!Wire.begin() || !Wire.setClock(I2C_CLOCK_HZ))
+    return false;
+
+  if (i2cWorker != NULL)
+    return true;
+
+  i2cDone = xSemaphoreCreateBinary();
+  if (i2cDone == NULL)
+    return false;
+
+  // above the IMU task so a submitted batch starts right away
+  return xTaskCreatePinnedToCore(i2cWorkerTask, "I2C Task", 4096, NULL,
+                                 EXEC_IMU_PRIORITY + 1, &i2cWorker,
+                                 0) == pdPASS;
+}
+
+I2CResult halI2CRead(uint8_t addr, uint8_t reg, uint8_t *buf, size_t len,
+                     uint32_t timeoutMs) {
+  return toI2CResult(i2c_master_write_read_device(
+      I2C_NUM_0, addr, &reg, 1, buf, len, pdMS_TO_TICKS(timeoutMs)));
+}
+
+I2CResult halI2CWrite(uint8_t addr, uint8_t reg, uint8_t value,
+                      uint32_t timeoutMs) {
+  uint8_t buf[2] = {reg, value};
+  return toI2CResult(i2c_master_write_to_device(I2C_NUM_0, addr, buf, 2,
+                                                pdMS_TO_TICKS(timeoutMs)));
+}
+
+void halI2CRecover() {
+  Wire.end();
+
+  // up to 9 clocks let a slave finish the byte it is stuck in
+  pinMode(SDA, INPUT_PULLUP);
+  pinMode(SCL, OUTPUT_OPEN_DRAIN);
+  for (int i = 0; i < 9 && !digitalRead(SDA); i++) {
+    digitalWrite(SCL, LOW);
+    delayMicroseconds(5);
+    digitalWrite(SCL, HIGH);
+    delayMicroseconds(5);
+  }
+
+  // STOP: SDA rises while SCL is high
+  pinMode(SDA, OUTPUT_OPEN_DRAIN);
+  digitalWrite(SDA, LOW);
+  delayMicroseconds(5);
+  digitalWrite(SCL, HIGH);
+  delayMicroseconds(5);
+  digitalWrite(SDA, HIGH);
+  delayMicroseconds(5);
+
+  Wire.begin();
+  Wire.setClock(I2C_CLOCK_HZ);
+}
+
+void halI2CEngineKick() { xTaskNotifyGive(i2cWorker); }
+
+void halI2CEngineWait(uint32_t timeoutMs) {
+  xSemaphoreTake(i2cDone, pdMS_TO_TICKS(timeoutMs));
+}
+
+bool halPWMBegin(uint8_t channel, uint8_t pin, uint32_t hz) {
+  ledc_timer_config_t timer = {};
+  timer.speed_mode = LEDC_LOW_SPEED_MODE;
+  timer.duty_resolution = (ledc_timer_bit_t)PWM_BITS;
+  timer.timer_num = (ledc_timer_t)channel;
+  timer.freq_hz = hz;
+  timer.clk_cfg = LEDC_AUTO_CLK;
+  if (ledc_timer_config(&timer) != ESP_OK)
+    return false;
+
+  ledc_channel_config_t config = {};
+  config.gpio_num = pin;
+  config.speed_mode = LEDC_LOW_SPEED_MODE;
+  config.channel = (ledc_channel_t)channel;
+  config.timer_sel = (ledc_timer_t)channel;
+  config.duty = 0;
+  pwmPeriodUs[channel] = 1000000 / hz;
+  return ledc_channel_config(&config) == ESP_OK;
+}
+
+void halPWMWrite(uint8_t channel, float us) {
+  uint32_t duty = lroundf(us * (1 << PWM_BITS) / pwmPeriodUs[channel]);
+
+  ledc_set_duty(LEDC_LOW_SPEED_MODE, (ledc_channel_t)channel, duty);
+  ledc_update_duty(LEDC_LOW_SPEED_MODE, (ledc_channel_t)channel);
+}
+
+bool halTimerStart(uint32_t periodUs, void (*callback)()) {
+  esp_timer_create_args_t args = {};
+  args.callback = [](void *arg) { ((void (*)())arg)(); };
+  args.arg = (void *)callback;
+  args.name = "periodic";
+
+  esp_timer_handle_t timer;
+  return esp_timer_create(&args, &timer) == ESP_OK &&
+         esp_timer_start_periodic(timer, periodUs) == ESP_OK;
+}
+
+struct PeriodicTask {
+  void (*run)(void *);
+  void *arg;
+  TickType_t period;
+};
+
+static void periodicTask(void *pvParameters) {
+  PeriodicTask *task = (PeriodicTask *)pvParameters;
+  TickType_t wake = xTaskGetTickCount();
+
+  for (;;) {
+    vTaskDelayUntil(&wake, task->period);
+    task->run(task->arg);
+
+    // behind by a period or more, drop the missed releases
+    if (xTaskGetTickCount() - wake >= task->period)
+      wake = xTaskGetTickCount();
+  }
+}
+
+bool halTaskStart(const char *name, uint8_t priority, uint32_t periodMs,
+                  void (*run)(void *), void *arg) {
+  PeriodicTask *task = new PeriodicTask{run, arg, pdMS_TO_TICKS(periodMs)};
+  if (task->period == 0)
+    task->period = 1;
+
+  return xTaskCreatePinnedToCore(periodicTask, name, 4096, task, priority,
+                                 NULL, 0) == pdPASS;
+}
+
+void *halTaskCurrent() { return xTaskGetCurrentTaskHandle(); }
+
+bool halWSWrite(uint32_t id, const uint8_t *data, size_t len) {
+  AsyncWebSocketClient *client = ws.client(id);
+
+  // already gone, the disconnect event clears its queue
+  if (client == NULL)
+    return true;
+  if (!client->canSend())
+    return false;
+
+  client->binary(data, len);
+  return true;
+}
+
+void halWSClose(uint32_t client) { ws.close(client); }
+
+uint32_t halCycles() { return ESP.getCycleCount(); }
+uint32_t halCyclesPerUs() { return ESP.getCpuFreqMHz(); }
+
+uint32_t halFreeHeap() { return ESP.getFreeHeap(); }
+uint32_t halMinFreeHeap() { return ESP.getMinFreeHeap(); }
@@ -0,0 +1,101 @@
+#include "i2c_engine.h"
+#include <Arduino.h>
+
+I2CStats i2cStats;
+
+static I2CTransaction *queue[I2C_QUEUE_LEN];
+static std::atomic<uint8_t> head{0}, tail{0};
+static uint8_t consecutiveFaults = 0;
+
+static bool submit(I2CTransaction *t, uint8_t addr, uint8_t reg, uint8_t *buf,
+                   uint16_t len, uint8_t value, uint32_t deadline) {
+  uint8_t h = head.load(std::memory_order_relaxed);
+  uint8_t next = (h + 1) % I2C_QUEUE_LEN;
+
+  if (next == tail.load(std::memory_order_acquire)) {
+    i2cStats.rejected++;
+    return false;
+  }
+
+  t->addr = addr;
+  t->reg = reg;
+  t->buf = buf;
+  t->len = len;
+  t->value = value;
+  t->deadline = deadline;
+  t->status = I2C_PENDING;
+
+  queue[h] = t;
+  head.store(next, std::memory_order_release);
+  halI2CEngineKick();
+  return true;
+}
+
+bool i2cSubmitRead(I2CTransaction *t, uint8_t addr, uint8_t reg, uint8_t *buf,
+                   uint16_t len, uint32_t deadline) {
+  return submit(t, addr, reg, buf, len, 0, deadline);
+}
+
+bool i2cSubmitWrite(I2CTransaction *t, uint8_t addr, uint8_t reg,
+                    uint8_t value, uint32_t deadline) {
+  return submit(t, addr, reg, NULL, 0, value, deadline);
+}
+
+static void execute(I2CTransaction *t) {
+  int32_t remaining = (int32_t)(t->deadline - micros());
+
+  if (remaining <= 0) {
+    i2cStats.expired++;
+    t->status = I2C_EXPIRED;
+    return;
+  }
+
+  uint32_t timeoutMs = (remaining + 999) / 1000;
+  I2CResult result =
+      t->buf == NULL
+          ? halI2CWrite(t->addr, t->reg, t->value, timeoutMs)
+          : halI2CRead(t->addr, t->reg, t->buf, t->len, timeoutMs);
+
+  i2cStats.transactions++;
+  if (result == I2C_NACK)
+    i2cStats.nacks++;
+  if (result == I2C_TIMEOUT)
+    i2cStats.timeouts++;
+  if (result == I2C_BUS_ERROR)
+    i2cStats.busErrors++;
+
+  consecutiveFaults = result == I2C_OK ? 0 : consecutiveFaults + 1;
+  if (consecutiveFaults >= I2C_RECOVERY_THRESHOLD) {
+    halI2CRecover();
+    i2cStats.recoveries++;
+    consecutiveFaults = 0;
+  }
+
+  t->status = result;
+}
+
+void i2cEngineRun() {
+  uint8_t t = tail.load(std::memory_order_relaxed);
+
+  while (t != head.load(std::memory_order_acquire)) {
+    execute(queue[t]);
+    t = (t + 1) % I2C_QUEUE_LEN;
+    tail.store(t, std::memory_order_release);
+  }
+}
+
+bool i2cAwait(I2CTransaction *const *ts, int n, uint32_t deadline) {
+  for (;;) {
+    bool done = true;
+    for (int i = 0; i < n; i++)
+      done = done && !ts[i]->pending();
+    if (done)
+      return true;
+
+    int32_t remaining = (int32_t)(deadline - micros());
+    if (remaining <= 0)
+      return false;
+
+    halI2CEngineWait((remaining + 999) / 1000);
+  }
+}
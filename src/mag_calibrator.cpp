@@ -0,0 +1,65 @@
+#include "mag_calibrator.h"
+#include "seqlock.h"
+
+// run ties a fit to the points it was solved from, so a solve still in
+// flight across a reset is not reported for the new run
+struct MagRunScatter {
+  uint32_t run;
+  MagScatter scatter;
+};
+
+struct MagRunFit {
+  uint32_t run;
+  MagFit fit;
+};
+
+static MagRunScatter current;
+static SeqLock<MagRunScatter> publishedScatter; // control -> solver
+static SeqLock<MagRunFit> publishedFit;         // solver -> any
+static TaskHandle_t solverTaskHandle = NULL;
+
+static std::atomic<uint32_t> currentRun{0};
+
+void magCalibratorReset() {
+  current.run = ++currentRun;
+  magScatterReset(&current.scatter);
+  publishedScatter.write(current);
+}
+
+void magCalibratorAdd(const RawICUData *raw) {
+  magScatterAdd(&current.scatter, raw->mx, raw->my, raw->mz);
+  publishedScatter.write(current);
+}
+
+bool magCalibratorResult(MagFit *fit, uint32_t *generation) {
+  *generation = publishedFit.version();
+  MagRunFit result = publishedFit.read();
+  *fit = result.fit;
+  return result.run == currentRun && fit->points != 0;
+}
+
+static void solverTask(void *pvParameters) {
+  uint32_t solved = 0;
+  MagRunFit result;
+
+  for (;;) {
+    vTaskDelay(pdMS_TO_TICKS(MAG_SOLVE_PERIOD_MS));
+
+    uint32_t version = publishedScatter.version();
+    if (version == solved)
+      continue;
+    solved = version;
+
+    MagRunScatter snapshot = publishedScatter.read();
+    result.run = snapshot.run;
+    if (magFitSolve(&snapshot.scatter, &result.fit))
+      publishedFit.write(result);
+  }
+}
+
+bool setupMagCalibrator() {
+  // priority of loop(); a solve takes tens of ms of soft-float
+  xTaskCreatePinnedToCore(solverTask, "MagCal Task", 4096, NULL, 1,
+                          &solverTaskHandle, 0);
+  return solverTaskHandle != NULL;
+}
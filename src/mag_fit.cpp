@@ -0,0 +1,163 @@
+#include "mag_fit.h"
+
+// readings are scaled by 1 / MAG_FIT_B to keep the sums near 1
+#define MAG_FIT_B 50.0
+
+void magScatterReset(MagScatter *scatter) {
+  memset(scatter, 0, sizeof(MagScatter));
+}
+
+void magScatterAdd(MagScatter *scatter, float mx, float my, float mz) {
+  if (scatter->points == 0) {
+    scatter->origin[0] = mx;
+    scatter->origin[1] = my;
+    scatter->origin[2] = mz;
+  }
+
+  double x = (mx - scatter->origin[0]) / MAG_FIT_B;
+  double y = (my - scatter->origin[1]) / MAG_FIT_B;
+  double z = (mz - scatter->origin[2]) / MAG_FIT_B;
+  double v[MAG_FIT_TERMS] = {x * x, 2 * x * y, 2 * x * z, y * y, 2 * y * z,
+                             z * z, x,         y,         z,     1};
+
+  double *sum = scatter->sums;
+  for (int i = 0; i < MAG_FIT_TERMS; i++)
+    for (int j = i; j < MAG_FIT_TERMS; j++)
+      *sum++ += v[i] * v[j];
+
+  scatter->points++;
+}
+
+// Cyclic Jacobi on a symmetric n x n matrix (row-major, destroyed): the
+// eigenvalues end up on its diagonal, the eigenvectors in the columns of v.
+static void jacobiEigen(double *a, int n, double *v) {
+  for (int i = 0; i < n * n; i++)
+    v[i] = i % (n + 1) == 0;
+
+  for (int sweep = 0; sweep < 50; sweep++) {
+    double off = 0, diag = 0;
+    for (int p = 0; p < n; p++) {
+      diag += a[p * n + p] * a[p * n + p];
+      for (int q = p + 1; q < n; q++)
+        off += a[p * n + q] * a[p * n + q];
+    }
+    if (off <= 1e-30 * diag)
+      return;
+
+    for (int p = 0; p < n; p++) {
+      for (int q = p + 1; q < n; q++) {
+        double apq = a[p * n + q];
+        if (fabs(apq) < 1e-300)
+          continue;
+
+        double theta = (a[q * n + q] - a[p * n + p]) / (2 * apq);
+        double t = (theta >= 0 ? 1 : -1) /
+                   (fabs(theta) + sqrt(theta * theta + 1));
+        double c = 1 / sqrt(t * t + 1), s = t * c;
+
+        for (int k = 0; k < n; k++) {
+          double akp = a[k * n + p], akq = a[k * n + q];
+          a[k * n + p] = c * akp - s * akq;
+          a[k * n + q] = s * akp + c * akq;
+        }
+        for (int k = 0; k < n; k++) {
+          double apk = a[p * n + k], aqk = a[q * n + k];
+          a[p * n + k] = c * apk - s * aqk;
+          a[q * n + k] = s * apk + c * aqk;
+        }
+        for (int k = 0; k < n; k++) {
+          double vkp = v[k * n + p], vkq = v[k * n + q];
+          v[k * n + p] = c * vkp - s * vkq;
+          v[k * n + q] = s * vkp + c * vkq;
+        }
+      }
+    }
+  }
+}
+
+static double det3(const double m[3][3]) {
+  return m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1]) -
+         m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0]) +
+         m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+}
+
+bool magFitSolve(const MagScatter *scatter, MagFit *fit) {
+  const int n = MAG_FIT_TERMS;
+  if (scatter->points < MAG_FIT_MIN_POINTS)
+    return false;
+
+  double a[n * n], vectors[n * n];
+  const double *sum = scatter->sums;
+  for (int i = 0; i < n; i++)
+    for (int j = i; j < n; j++)
+      a[i * n + j] = a[j * n + i] = *sum++;
+
+  jacobiEigen(a, n, vectors);
+
+  int min = 0;
+  for (int i = 1; i < n; i++)
+    if (a[i * n + i] < a[min * n + min])
+      min = i;
+
+  // A x^2 + 2D xy + 2E xz + B y^2 + 2F yz + C z^2 + G x + H y + I z + J = 0
+  double s[n];
+  for (int i = 0; i < n; i++)
+    s[i] = vectors[i * n + min];
+
+  double e[3][3] = {{s[0], s[1], s[2]}, {s[1], s[3], s[4]}, {s[2], s[4], s[5]}};
+  double det = det3(e);
+  if (det < 0) {
+    for (int i = 0; i < n; i++)
+      s[i] = -s[i];
+    for (auto &row : e)
+      for (double &x : row)
+        x = -x;
+    det = -det;
+  }
+  if (det < 1e-12)
+    return false;
+
+  // centre V = -e^-1 [G H I] / 2 via the adjugate, e is symmetric
+  double inv[3][3];
+  for (int i = 0; i < 3; i++)
+    for (int j = 0; j < 3; j++) {
+      int r0 = (j + 1) % 3, r1 = (j + 2) % 3, c0 = (i + 1) % 3,
+          c1 = (i + 2) % 3;
+      inv[i][j] = (e[r0][c0] * e[r1][c1] - e[r0][c1] * e[r1][c0]) / det;
+    }
+
+  double centre[3], term = 0;
+  for (int i = 0; i < 3; i++)
+    centre[i] = -0.5 * (inv[i][0] * s[6] + inv[i][1] * s[7] + inv[i][2] * s[8]);
+  for (int i = 0; i < 3; i++)
+    for (int j = 0; j < 3; j++)
+      term += centre[i] * e[i][j] * centre[j];
+
+  double b = sqrt(fabs(term - s[9]));
+  if (b == 0)
+    return false;
+
+  // soft iron: the square root of e normalised to unit determinant
+  double norm[9], nv[9];
+  double normFactor = pow(det, -1.0 / 3);
+  for (int i = 0; i < 3; i++)
+    for (int j = 0; j < 3; j++)
+      norm[i * 3 + j] = e[i][j] * normFactor;
+  jacobiEigen(norm, 3, nv);
+
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) {
+      double m = 0;
+      for (int k = 0; k < 3; k++)
+        m += nv[i * 3 + k] * sqrt(fabs(norm[k * 3 + k])) * nv[j * 3 + k];
+      fit->scale[i][j] = m;
+    }
+    fit->offset[i] = centre[i] * MAG_FIT_B + scatter->origin[i];
+  }
+
+  fit->fitError =
+      50 * sqrt(fabs(a[min * n + min]) / scatter->points) / (b * b);
+  fit->fieldStrength = b * MAG_FIT_B * pow(det, -1.0 / 6);
+  fit->points = scatter->points;
+  return true;
+}
@@ -1,18 +1,32 @@
 #include "main.h"
+#include "acquisition.h"
+#include "actuator.h"
+#include "autotune.h"
+#include "boot.h"
 #include "calibration.h"
+#include "capture.h"
+#include "executive.h"
+#include "hal.h"
 #include "hexdump.h"
+#include "mag_calibrator.h"
+#include "metrics.h"
+#include "mission.h"
 #include "packets.h"
+#include "params.h"
 #include "pid.h"
+#include "recorder.h"
 #include "sensor.h"
 #include "strprintf.h"
+#include "telemetry.h"
 #include "ws.h"
+#include "ws_queue.h"
 #include <Arduino.h>
 #include <AsyncTCP.h>
 #include <AsyncWebSocket.h>
 #include <ESPAsyncWebServer.h>
 #include <LittleFS.h>
-#include <Servo.h>
 #include <WiFi.h>
+#include <atomic>
 #include <esp_wifi.h>
 
 // #define EB_NO_FOR
@@ -28,290 +42,917 @@
 #define BUTTON_PIN 10
 
 #define GYRO_SAMPLES (20 * SAMPLE_RATE)
+// a fit this good ends the calibration by itself, Stop keeps one up to
+// MAG_FIT_MAX_ERROR (percent)
+#define MAG_FIT_DONE_ERROR 2.0f
+#define MAG_FIT_DONE_POINTS 750
+#define MAG_FIT_MAX_ERROR 5.0f
+// startup, see tickBoot
+#define BOOT_PROMPT_MS 300
+#define BOOT_BUTTON_MS 1200
+#define BOOT_BUTTON_HOLD_MS 50
+#define WIGGLE_MS 100
+// control cycles between two progress packets
+#define PROGRESS_TICKS (CONTROL_RATE / 4)
+#define ACCEL_SAMPLES 500
+
+// Standard 50 Hz frames on both. The servo slews about as fast as it can
+// turn (0.1 s per 60 degrees) and takes commands as they come, interpolating
+// would delay the heading loop by a command period. The ESC ramps over half
+// a second end to end and arms on two seconds of neutral.
+static const ActuatorConfig servoConfig = {
+    SERVO_PIN, 50, ACTUATOR_SERVO_MIN_US, ACTUATOR_SERVO_MAX_US, 6000, false};
+static const ActuatorConfig motorConfig = {
+    MOTOR_PIN, 50, 1000, 2000, 1000, true, 1,
+    {{ACTUATOR_MOTOR_NEUTRAL_US, 2000}}};
 
-Servo servo = Servo();
 // Button button(BUTTON_PIN);
 float yawAnchor;
-bool anchoring = false, magCalibrating = false, gyroCalibrating = false;
-uint8_t accelCalibrating = 255;
-float mx, my, mz;
-double accelSum[3] = {0, 0, 0};
-double gyroSum[3] = {0, 0, 0};
-uint16_t sampleIndex = 0;
+bool anchoring = false;
+float servoOutput = 0, motorOutput = 0;
+double gyroSum[3], gyroTempSum;
+uint16_t gyroSamples;
+double accelSum[3];
+uint16_t accelSamples;
+uint8_t accelAxis;
 uint32_t lastPingTime;
-uint32_t lastUpdateSentTime;
+uint32_t reportedPacketDrops = 0;
 bool imuInitialized;
+RelayAutotuner autotuner;
+MissionExecutor mission;
+float missionSpeed = 0;
+// set by the autopilot button on the loop, cleared by the IMU task once the
+// mission runs
+std::atomic<bool> missionRequested{false};
 
 enum AutoPilotState {
   AP_DISABLED,
   AP_READY,
   AP_GOING,
+  AP_DONE,
 };
 
 enum AutoPilotState apState = AP_DISABLED;
-uint32_t apStartTime = -1;
+
+enum BootState {
+  BOOT_CENTERING,
+  BOOT_BUTTON_WINDOW,
+  BOOT_DONE,
+};
+
+enum BootState bootState = BOOT_CENTERING;
+uint32_t bootStateTime, buttonSince;
+// degrees, asked for by tickBoot() and played by the wiggle job
+std::atomic<int8_t> wiggleRequest{0};
 
 void handleAnchoring();
+void finishMagCalibration(float maxError);
+
+bool tickSteering(const RateContext &ctx);
+bool tickWiggle(const RateContext &ctx);
+bool tickRecorder(const RateContext &ctx);
+bool tickMagCalibration(const RateContext &ctx);
+bool tickGyroCalibration(const RateContext &ctx);
+bool tickAccelCalibration(const RateContext &ctx);
+bool tickTelemetry(const RateContext &ctx);
+bool tickStats(const RateContext &ctx);
+
+Job steeringJob("steering", GROUP_control, tickSteering);
+Job wiggleJob("wiggle", GROUP_control, tickWiggle);
+Job recorderJob("recorder", GROUP_sensor, tickRecorder);
+Job magCalibrationJob("magcal", GROUP_sensor, tickMagCalibration);
+Job gyroCalibrationJob("gyrocal", GROUP_sensor, tickGyroCalibration);
+Job accelCalibrationJob("accelcal", GROUP_sensor, tickAccelCalibration);
+Job telemetryJob("telemetry", GROUP_telemetry, tickTelemetry);
+Job statsJob("stats", GROUP_housekeeping, tickStats);
+
+bool steering() {
+  return anchoring || autotuner.running() || mission.running();
+}
 
 void writeServo(float output) {
-  servo.write(SERVO_PIN,
-              calibration.servoMiddle -
-                  fmaxf(-SERVO_MAX_DIFF, fminf(SERVO_MAX_DIFF, output)));
+  servoOutput = fmaxf(-SERVO_MAX_DIFF, fminf(SERVO_MAX_DIFF, output));
+  actuatorCommand(ACT_SERVO,
+                  servoDegreesToUs(calibration.servoMiddle - servoOutput),
+                  micros());
 }
 
-void handlePacket(uint8_t id, const uint8_t *data, size_t len) {
-  if (id == 0x0c && len == 8) {
-    float angle, speed;
-    memcpy(&angle, data, sizeof(float));
-    memcpy(&speed, data + sizeof(float), sizeof(float));
+// us, the ESC ignores it until it is armed
+void writeMotor(float output) {
+  motorOutput = output;
+  actuatorCommand(ACT_MOTOR, output, micros());
+}
 
-    if (!anchoring)
-      writeServo(angle);
-    servo.write(MOTOR_PIN, speed);
-  }
+static_assert(sizeof(LoopTimingPacket::jitter) == sizeof(TimingStats::jitter),
+              "LoopTiming must carry every jitter bin");
 
-  if (id == 0x0a && len == 1) {
-    memcpy(&anchoring, data, sizeof(bool));
-    handleAnchoring();
+void sendLoopTiming() {
+  LoopTimingPacket packet = {timingStats.periodUs, timingStats.wakes,
+                             timingStats.overruns, timingStats.resyncs,
+                             timingStats.maxCycleUs};
+  memcpy(packet.jitter, timingStats.jitter, sizeof(packet.jitter));
+  sendPacket(packet, WS_LATEST, WS_STREAM_STATS);
+}
+
+static_assert(sizeof(StatsPacket::meanUs) == PROBE_COUNT * sizeof(float),
+              "Stats must carry every probe");
+static_assert(sizeof(StatsPacket::wsDepth) == WS_MAX_CLIENTS * sizeof(uint32_t),
+              "Stats must carry every websocket client");
+static_assert(sizeof(StatsPacket::groupLoad) ==
+                  RATE_GROUP_COUNT * sizeof(float),
+              "Stats must carry every rate group");
+
+void sendStats() {
+  StatsPacket packet = {};
+  float usPerCycle = 1.0f / halCyclesPerUs();
+
+  for (int i = 0; i < PROBE_COUNT; i++) {
+    const ProbeStats *s = &probeStats[i];
+    packet.meanUs[i] = s->count ? s->sum * usPerCycle / s->count : 0;
+    packet.p99Us[i] = probePercentile(s, 0.99f) * usPerCycle;
+    packet.maxUs[i] = s->max * usPerCycle;
   }
+  packet.wsFrames = wsStats.frames;
+  packet.wsDropped = wsStats.dropped;
+  packet.wsClosed = wsStats.closed;
+  for (int i = 0; i < WS_MAX_CLIENTS; i++) {
+    packet.wsDepth[i] = wsClientStats[i].depth;
+    packet.wsClientDropped[i] = wsClientStats[i].dropped;
+  }
+  packet.packetsDropped = packetQueueStats.dropped;
+  packet.freeHeap = halFreeHeap();
+  packet.minFreeHeap = halMinFreeHeap();
+  for (int i = 0; i < RATE_GROUP_COUNT; i++) {
+    packet.groupLoad[i] = rateGroupStats[i].utilization;
+    packet.groupOverruns[i] = rateGroupStats[i].overruns;
+  }
+  sendPacket(packet, WS_LATEST, WS_STREAM_STATS);
+}
 
-  if (id == 0x0a && len == 4) {
-    memcpy(&yawAnchor, data, sizeof(float));
+void sendParams() {
+  static_assert(sizeof(ParamsPacket::values) ==
+                    PARAMS_PER_PACKET * sizeof(float),
+                "params packet out of sync with PARAMS_PER_PACKET");
+  ParamValues values;
+  getParams(&values);
+
+  for (uint8_t first = 0; first < PARAM_COUNT; first += PARAMS_PER_PACKET) {
+    ParamsPacket packet = {first, (uint8_t)min(PARAM_COUNT - first,
+                                               PARAMS_PER_PACKET)};
+    memcpy(packet.values, (float *)&values + first,
+           packet.count * sizeof(float));
+    sendPacket(packet);
   }
+}
 
-  if ((id == 'p' || id == 'i' || id == 'd') && len == 4) {
-    float val;
-    memcpy(&val, data, sizeof(float));
+static_assert(sizeof(MissionPacket::heading) ==
+                  MISSION_LEGS_PER_PACKET * sizeof(float),
+              "mission packet out of sync with MISSION_LEGS_PER_PACKET");
+
+// An empty plan still gets one packet, so the page knows it is empty.
+void sendMission() {
+  uint8_t first = 0;
+
+  do {
+    MissionPacket packet = {first,
+                            (uint8_t)min(missionPlan.count - first,
+                                         MISSION_LEGS_PER_PACKET),
+                            missionPlan.count};
+    for (int i = 0; i < packet.count; i++) {
+      const MissionLeg &leg = missionPlan.legs[first + i];
+      packet.headingMode[i] = leg.headingMode;
+      packet.speedProfile[i] = leg.speedProfile;
+      packet.heading[i] = leg.heading;
+      packet.speed[i] = leg.speed;
+      packet.duration[i] = leg.duration;
+      packet.turnRate[i] = leg.turnRate;
+    }
+    sendPacket(packet);
+    first += MISSION_LEGS_PER_PACKET;
+  } while (first < missionPlan.count);
+}
 
-    if (id == 'p')
-      pid.setKp(val);
-    if (id == 'i')
-      pid.setKi(val);
-    if (id == 'd')
-      pid.setKd(val);
+void sendMissionProgress(WSDelivery delivery) {
+  sendPacket(MissionProgressPacket{mission.getState(), mission.getLeg(),
+                                   mission.getLegCount(), mission.getElapsed(),
+                                   mission.getDuration(), yawAnchor,
+                                   missionSpeed},
+             delivery, WS_STREAM_MISSION);
+}
 
-    saveCoefficients();
+// The stored plan, or the old fixed run when none is. The segment table is
+// built here, from the heading the boat has now, so absolute legs know which
+// way to turn.
+bool startMission(const EstimatorState &state) {
+  MissionPlan plan = missionPlan;
+  if (plan.count == 0)
+    missionDefault(&plan, calibration.maxAPSpeed);
+
+  if (!mission.load(plan, state.yaw, calibration.maxAPSpeed)) {
+    sendMessagePacket("Mission rejected, not starting");
+    return false;
   }
 
-  if (id == 0x01 && len == 0) {
-    sendInitPacket(pid.getKp(), pid.getKi(), pid.getKd());
-    sendAnchoringPacket(&anchoring);
-    sendYawAnchorPacket(yawAnchor);
+  mission.start(state.timestamp);
+  missionSpeed = 0;
+  yawAnchor = state.yaw;
+  recorderStart();
+  sendMissionProgress(WS_RELIABLE);
+  return true;
+}
+
+void endMission() {
+  missionSpeed = 0;
+  writeServo(0);
+  writeMotor(ACTUATOR_MOTOR_NEUTRAL_US);
+  recorderStop();
+  sendPacket(YawAnchorPacket{yawAnchor});
+  sendMissionProgress(WS_RELIABLE);
+}
+
+// Handlers run on the IMU task between acquisition and fusion (see
+// applyQueuedPackets), so they own the control state while they run.
+void setupPacketHandlers() {
+  onPacket<ControlPacket>(
+      [](const ControlPacket &packet) {
+        // the mission owns both outputs until it ends or is stopped
+        if (mission.running())
+          return;
+        if (!anchoring && !autotuner.running())
+          writeServo(packet.angle);
+        writeMotor(packet.speed);
+      },
+      true);
+
+  onPacket<CapturePacket>(
+      [](const CapturePacket &packet) { setCapture(packet.enabled); });
+
+  onPacket<SetAnchoringPacket>([](const SetAnchoringPacket &packet) {
+    anchoring = packet.anchoring;
+    handleAnchoring();
+  });
+
+  onPacket<SetYawAnchorPacket>(
+      [](const SetYawAnchorPacket &packet) { yawAnchor = packet.yaw; }, true);
+
+  // a slider drag arrives as a burst, coalesced here and saved once it ends
+  onPacket<SetKpPacket>(
+      [](const SetKpPacket &packet) {
+        pid.setKp(packet.value);
+        paramsChanged();
+      },
+      true);
+  onPacket<SetKiPacket>(
+      [](const SetKiPacket &packet) {
+        pid.setKi(packet.value);
+        paramsChanged();
+      },
+      true);
+  onPacket<SetKdPacket>(
+      [](const SetKdPacket &packet) {
+        pid.setKd(packet.value);
+        paramsChanged();
+      },
+      true);
+
+  onPacket<StartAutotunePacket>([](const StartAutotunePacket &packet) {
+    auto state = getEstimatorState();
+
+    if (anchoring || autotuner.running() || state.sample == 0) {
+      sendMessagePacket(anchoring ? "Stop anchoring before autotuning"
+                                  : "No heading yet, not autotuning");
+      return;
+    }
+    if (mission.running()) {
+      sendMessagePacket("Stop the mission before autotuning");
+      return;
+    }
+    // written so that NaN fails them too
+    if (!(packet.amplitude > 0 && packet.amplitude <= SERVO_MAX_DIFF) ||
+        !(packet.hysteresis >= 0) || packet.cycles == 0 ||
+        packet.cycles > AUTOTUNE_MAX_CYCLES ||
+        packet.rule > TUNE_TYREUS_LUYBEN) {
+      sendMessagePacket("Invalid autotune settings");
+      return;
+    }
+
+    // oscillate around the current heading
+    yawAnchor = state.yaw;
+    sendPacket(YawAnchorPacket{yawAnchor});
+    autotuner.start({packet.amplitude, packet.hysteresis, packet.cycles,
+                     (AutotuneRule)packet.rule},
+                    state.timestamp);
+    recorderStart();
+  });
+
+  onPacket<StopAutotunePacket>([](const StopAutotunePacket &) {
+    if (!autotuner.running())
+      return;
+
+    autotuner.stop();
+    writeServo(0);
+    recorderStop();
+    sendPacket(AutotuneProgressPacket{autotuner.getPhase(), 0}, WS_RELIABLE,
+               WS_STREAM_AUTOTUNE);
+  });
+
+  onPacket<ApplyAutotunePacket>([](const ApplyAutotunePacket &) {
+    if (autotuner.getPhase() != AT_DONE) {
+      sendMessagePacket("No autotune result to apply");
+      return;
+    }
+
+    const AutotuneResult &result = autotuner.getResult();
+    pid.setKp(result.kp);
+    pid.setKi(result.ki);
+    pid.setKd(result.kd);
+    paramsChanged();
+    sendPacket(InitPacket{pid.getKp(), pid.getKi(), pid.getKd()});
+  });
+
+  // legs arrive in order, MISSION_LEGS_PER_PACKET at a time; the plan is
+  // checked and stored once the last one is in
+  onPacket<SetMissionPacket>([](const SetMissionPacket &packet) {
+    static MissionPlan upload;
+    static uint8_t received = 0;
+
+    if (mission.running()) {
+      sendMessagePacket("Mission running, upload ignored");
+      return;
+    }
+    if (packet.total == 0 || packet.total > MISSION_MAX_LEGS ||
+        packet.count > MISSION_LEGS_PER_PACKET ||
+        packet.count > packet.total - packet.first ||
+        (packet.first != 0 && packet.first != received)) {
+      received = 0;
+      sendMessagePacket("SetMission out of range");
+      return;
+    }
+
+    if (packet.first == 0)
+      upload = MissionPlan();
+    for (int i = 0; i < packet.count; i++)
+      upload.legs[packet.first + i] = {
+          packet.headingMode[i], packet.speedProfile[i], packet.heading[i],
+          packet.speed[i],       packet.duration[i],     packet.turnRate[i]};
+    received = packet.first + packet.count;
+    if (received < packet.total)
+      return;
+
+    received = 0;
+    upload.count = packet.total;
+    const char *error = missionValidate(&upload);
+    if (error) {
+      sendMessagePacket(strf("Mission rejected: %s", error));
+      return;
+    }
+
+    missionPlan = upload;
+    missionChanged();
+    sendMission();
+    sendMessagePacket(strf("Mission stored: %u legs", missionPlan.count));
+  });
+
+  onPacket<MissionRequestPacket>([](const MissionRequestPacket &) {
+    sendMission();
+    sendMissionProgress(WS_RELIABLE);
+  });
+
+  onPacket<StartMissionPacket>([](const StartMissionPacket &) {
+    auto state = getEstimatorState();
+
+    if (anchoring || autotuner.running() || mission.running() ||
+        state.sample == 0) {
+      sendMessagePacket(state.sample == 0 ? "No heading yet, no mission"
+                                          : "Controller busy, no mission");
+      return;
+    }
+    startMission(state);
+  });
+
+  onPacket<StopMissionPacket>([](const StopMissionPacket &) {
+    if (!mission.running())
+      return;
+
+    mission.stop();
+    endMission();
+  });
+
+  onPacket<InitRequestPacket>([](const InitRequestPacket &) {
+    sendPacket(InitPacket{pid.getKp(), pid.getKi(), pid.getKd()});
+    sendPacket(AnchoringPacket{anchoring});
+    sendPacket(YawAnchorPacket{yawAnchor});
     sendMessagePacket(
         strf("IMU is %sinitialized", imuInitialized ? "" : "not "));
-  }
 
-  if (id == 0xff && len == 0) {
-    lastPingTime = millis();
-  }
+    char timeline[192];
+    formatBootTimeline(timeline, sizeof(timeline));
+    sendMessagePacket(timeline);
+  });
 
-  if (id == 0xc2 && len == 0) {
-    gyroCalibrating = true;
-  }
+  onPacket<PingPacket>([](const PingPacket &) { lastPingTime = millis(); });
 
-  if (id == 0xc3 && len == 0) {
-    magCalibrating = true;
-  }
+  onPacket<StartGyroCalibrationPacket>([](const StartGyroCalibrationPacket &) {
+    memset(gyroSum, 0, sizeof(gyroSum));
+    gyroTempSum = 0;
+    gyroSamples = 0;
+    gyroCalibrationJob.start();
+  });
+  onPacket<StartMagCalibrationPacket>(
+      [](const StartMagCalibrationPacket &) {
+        magCalibratorReset();
+        magCalibrationJob.start();
+      });
+  onPacket<StartAccelCalibrationPacket>(
+      [](const StartAccelCalibrationPacket &packet) {
+        memset(accelSum, 0, sizeof(accelSum));
+        accelSamples = 0;
+        accelAxis = packet.axis;
+        accelCalibrationJob.start();
+      });
+
+  onPacket<MagCalibrationPacket>([](const MagCalibrationPacket &packet) {
+    CalibrationStore newCal = calibration;
 
-  if (id == 0xc4 && len == 1) {
-    memcpy(&accelCalibrating, data, 1);
-  }
+    newCal.magX = packet.offset[0];
+    newCal.magY = packet.offset[1];
+    newCal.magZ = packet.offset[2];
+    memcpy(newCal.magScale, packet.scale, sizeof(newCal.magScale));
 
-  if (id == 0xc1 && len == 12 * 4) {
+    calibration = newCal;
+    paramsChanged();
+    magCalibrationJob.stop();
+  });
+  onPacket<StopMagCalibrationPacket>(
+      [](const StopMagCalibrationPacket &packet) {
+        if (magCalibrationJob.active() && packet.apply)
+          finishMagCalibration(MAG_FIT_MAX_ERROR);
+        magCalibrationJob.stop();
+      });
+
+  onPacket<AccelCalibrationPacket>([](const AccelCalibrationPacket &packet) {
     CalibrationStore newCal = calibration;
 
-    memcpy(&newCal.magX, data, 4);
-    memcpy(&newCal.magY, data + 4, 4);
-    memcpy(&newCal.magZ, data + 8, 4);
-    memcpy(&newCal.magScale, data + 12, 4 * 9);
+    newCal.accelX = packet.bias[0];
+    newCal.accelY = packet.bias[1];
+    newCal.accelZ = packet.bias[2];
 
     calibration = newCal;
-    saveBiasStore(&calibration);
-  }
+    paramsChanged();
+  });
 
-  if (id == 0xc1) {
-    magCalibrating = false;
-  }
+  onPacket<SetNorthPacket>([](const SetNorthPacket &) {
+    auto state = getEstimatorState();
 
-  if (id == 0xc5 && len == 3 * 4) {
-    CalibrationStore newCal = calibration;
+    if (state.sample == 0) {
+      sendMessagePacket("No heading yet, north not set");
+      return;
+    }
 
-    memcpy(&newCal.accelX, data, 4);
-    memcpy(&newCal.accelY, data + 4, 4);
-    memcpy(&newCal.accelZ, data + 8, 4);
+    // the current heading becomes 0
+    calibration.north = fmodf(calibration.north + state.yaw, 360.0f);
+    paramsChanged();
+    sendCalibrationPacket(&calibration);
+  });
 
-    calibration = newCal;
-    saveBiasStore(&calibration);
-  }
+  onPacket<CalibrationRequestPacket>([](const CalibrationRequestPacket &) {
+    sendCalibrationPacket(&calibration);
+  });
 
-  if (id == 0xa0 && len == 0) {
-    sendCalibrationDataPacket(&calibration);
-  }
+  onPacket<ParamsRequestPacket>(
+      [](const ParamsRequestPacket &) { sendParams(); });
 
-  if (id == 0xa1 && len == sizeof(CalibrationStore)) {
-    memcpy(&calibration, data, sizeof(CalibrationStore));
-    saveBiasStore(&calibration);
+  onPacket<SetParamsPacket>([](const SetParamsPacket &packet) {
+    if (packet.first >= PARAM_COUNT || packet.count > PARAMS_PER_PACKET ||
+        packet.count > PARAM_COUNT - packet.first) {
+      sendMessagePacket("SetParams out of range");
+      return;
+    }
+
+    ParamValues values;
+    getParams(&values);
+    memcpy((float *)&values + packet.first, packet.values,
+           packet.count * sizeof(float));
+    setParams(&values);
+    paramsChanged();
+    sendParams();
+  });
+
+  onPacket<SetCalibrationPacket>([](const SetCalibrationPacket &packet) {
+    storeCalibrationPacket(packet, &calibration);
+    paramsChanged();
     writeServo(0);
-  }
+  });
 }
 
 void handleAnchoring() {
   if (anchoring) {
-    yawAnchor = getYaw();
-    sendYawAnchorPacket(yawAnchor);
+    auto state = getEstimatorState();
+
+    if (state.sample == 0) {
+      anchoring = false;
+      sendPacket(AnchoringPacket{anchoring});
+      sendMessagePacket("No heading yet, not anchoring");
+      return;
+    }
+
+    if (autotuner.running()) {
+      autotuner.stop();
+      sendPacket(AutotuneProgressPacket{autotuner.getPhase(), 0},
+                 WS_RELIABLE, WS_STREAM_AUTOTUNE);
+    }
+    if (mission.running()) {
+      mission.stop();
+      endMission();
+    }
+
+    yawAnchor = state.yaw;
+    sendPacket(YawAnchorPacket{yawAnchor});
+    recorderStart();
   } else {
     yawAnchor = 0.0f;
     writeServo(0);
+    recorderStop();
   }
 }
 
-void setup() {
-  pinMode(SERVO_PIN, OUTPUT);
-  pinMode(BUTTON_PIN, INPUT);
-  // Serial.begin(460800);
-  setupBiasesStorage();
-  writeServo(0);
-  servo.write(MOTOR_PIN, 1500);
+void tickAutotune(float yaw, uint32_t timestamp) {
+  static uint16_t ticks = 0;
+  writeServo(autotuner.update(headingError(yawAnchor, yaw), timestamp));
 
-  setupPID();
-  imuInitialized = setupIMU([](float yaw, RawICUData raw) {
-    if (anchoring) {
-      writeServo(tickPID(yawAnchor, yaw));
-      return;
-    }
+  if (autotuner.running()) {
+    if (++ticks % PROGRESS_TICKS == 0)
+      sendPacket(AutotuneProgressPacket{AT_RUNNING, autotuner.getProgress()},
+                 WS_LATEST, WS_STREAM_AUTOTUNE);
+    return;
+  }
 
-    if (magCalibrating) {
-      mx = raw.mx;
-      my = raw.my;
-      mz = raw.mz;
-      return;
-    }
+  recorderStop();
+  sendPacket(AutotuneProgressPacket{autotuner.getPhase(),
+                                    autotuner.getProgress()},
+             WS_RELIABLE, WS_STREAM_AUTOTUNE);
 
-    if (gyroCalibrating) {
-      sampleIndex++;
+  if (autotuner.getPhase() == AT_FAILED) {
+    sendMessagePacket(strf("Autotune failed: %s", autotuner.getFailure()));
+    return;
+  }
 
-      if (sampleIndex % 50 == 0) {
-        sendGyroCalibrationProgressPacket((float)sampleIndex /
-                                          (float)GYRO_SAMPLES * 100.0);
-      }
+  const AutotuneResult &r = autotuner.getResult();
+  sendPacket(AutotuneResultPacket{r.ku, r.tu, r.kp, r.ki, r.kd});
+}
 
-      if (sampleIndex == GYRO_SAMPLES) {
-        calibration.gyroX = gyroSum[0] / (float)GYRO_SAMPLES;
-        calibration.gyroY = gyroSum[1] / (float)GYRO_SAMPLES;
-        calibration.gyroZ = gyroSum[2] / (float)GYRO_SAMPLES;
+// The PID steers to yawAnchor, moved along the precomputed profile here.
+void tickMission(uint32_t timestamp) {
+  static uint16_t ticks = 0;
+  MissionSetpoint setpoint = mission.update(timestamp);
 
-        saveBiasStore(&calibration);
+  yawAnchor = setpoint.heading;
+  missionSpeed = setpoint.speed;
+  writeMotor(missionMotorUs(setpoint.speed));
 
-        gyroSum[0] = 0;
-        gyroSum[1] = 0;
-        gyroSum[2] = 0;
-        sampleIndex = 0;
-        gyroCalibrating = false;
-      }
+  if (mission.running()) {
+    if (++ticks % PROGRESS_TICKS == 0)
+      sendMissionProgress(WS_LATEST);
+    return;
+  }
 
-      gyroSum[0] += raw.gx;
-      gyroSum[1] += raw.gy;
-      gyroSum[2] += raw.gz;
-      return;
-    }
+  endMission();
+}
 
-    if (accelCalibrating != 255) {
-      sampleIndex++;
-
-      if (sampleIndex % 25 == 0) {
-        sendAccelCalibrationProgressPacket(accelCalibrating,
-                                           (float)sampleIndex / 500.0 * 100.0);
-      }
-
-      if (sampleIndex == 500) {
-        sendAccelCalibrationDataPacket(accelCalibrating, accelSum[0] / 500.0f,
-                                       accelSum[1] / 500.0f,
-                                       accelSum[2] / 500.0f);
-
-        accelSum[0] = 0;
-        accelSum[1] = 0;
-        accelSum[2] = 0;
-        sampleIndex = 0;
-        accelCalibrating = 255;
-      }
-
-      accelSum[0] += raw.ax;
-      accelSum[1] += raw.ay;
-      accelSum[2] += raw.az;
-      return;
-    }
-  });
+void finishMagCalibration(float maxError) {
+  MagFit fit;
+  uint32_t generation;
+  magCalibrationJob.stop();
 
-  loadCoefficients();
+  if (!magCalibratorResult(&fit, &generation)) {
+    sendMessagePacket("Not enough mag points, calibration discarded");
+    return;
+  }
+  if (fit.fitError > maxError) {
+    sendMessagePacket(
+        strf("Mag fit error %.1f%%, calibration discarded", fit.fitError));
+    return;
+  }
 
-  delay(1500);
+  calibration.magX = fit.offset[0];
+  calibration.magY = fit.offset[1];
+  calibration.magZ = fit.offset[2];
+  memcpy(calibration.magScale, fit.scale, sizeof(calibration.magScale));
+  paramsChanged();
+  sendCalibrationPacket(&calibration);
+  sendMessagePacket(strf("Mag calibrated: %u points, fit error %.1f%%, "
+                         "field %.1f uT",
+                         (unsigned)fit.points, fit.fitError,
+                         fit.fieldStrength));
+}
 
-  writeServo(10);
-  delay(100);
-  writeServo(0);
+// Control group: whichever of the mission, the anchor and the autotuner has
+// the rudder. Only fresh samples release it, ctx.dt spans all of them.
+bool tickSteering(const RateContext &ctx) {
+  auto state = getEstimatorState();
 
-  delay(1500);
+  // the flag is cleared after the start, so loop() never sees neither
+  if (missionRequested && state.sample) {
+    if (!steering())
+      startMission(state);
+    missionRequested = false;
+  }
+  if (mission.running())
+    tickMission(state.timestamp);
+
+  if (anchoring || mission.running())
+    writeServo(tickPID(yawAnchor, state.yaw, ctx.dt));
+  else if (autotuner.running())
+    tickAutotune(state.yaw, state.timestamp);
+  return true;
+}
 
-  if (digitalRead(BUTTON_PIN)) {
-    writeServo(-10);
-    delay(100);
-    writeServo(0);
+// Sensor group from here on, every sample. The calibrations pause while the
+// boat steers or the bus is stale.
+bool tickRecorder(const RateContext &ctx) {
+  TelemetrySample sample = {getEstimatorState(), yawAnchor, pid.getTerms(),
+                            servoOutput, motorOutput};
+  uint8_t flags = anchoring ? BB_ANCHORING : 0;
+  if (mission.running())
+    flags = BB_ANCHORING | BB_MISSION;
+  if (ctx.released & 1 << GROUP_control)
+    flags |= BB_CONTROL;
+  recordSample(&sample, flags);
+  return true;
+}
 
-    apState = AP_READY;
-    return;
+// the page also plots the points from TLM_RAW telemetry
+bool tickMagCalibration(const RateContext &ctx) {
+  static uint32_t reported = 0;
+  MagFit fit;
+  uint32_t generation;
+
+  if (ctx.stale || steering())
+    return true;
+
+  auto state = getEstimatorState();
+  if (state.magFresh)
+    magCalibratorAdd(&state.raw);
+
+  if (!magCalibratorResult(&fit, &generation) || generation == reported)
+    return true;
+  reported = generation;
+
+  MagCalibrationStatusPacket status = {fit.points, fit.fitError,
+                                       fit.fieldStrength};
+  memcpy(status.offset, fit.offset, sizeof(status.offset));
+  memcpy(status.scale, fit.scale, sizeof(status.scale));
+  sendPacket(status, WS_LATEST, WS_STREAM_CALIBRATION);
+
+  if (fit.fitError < MAG_FIT_DONE_ERROR && fit.points >= MAG_FIT_DONE_POINTS)
+    finishMagCalibration(MAG_FIT_DONE_ERROR);
+  return true;
+}
+
+bool tickGyroCalibration(const RateContext &ctx) {
+  if (ctx.stale || steering())
+    return true;
+
+  const RawICUData raw = getEstimatorState().raw;
+  gyroSum[0] += raw.gx;
+  gyroSum[1] += raw.gy;
+  gyroSum[2] += raw.gz;
+  gyroTempSum += raw.temp;
+  gyroSamples++;
+
+  if (gyroSamples % 50 == 0) {
+    // the page only shows the calibration done once 100% arrives
+    sendPacket(GyroCalibrationProgressPacket{(float)gyroSamples /
+                                             (float)GYRO_SAMPLES * 100.0f},
+               gyroSamples == GYRO_SAMPLES ? WS_RELIABLE : WS_LATEST,
+               WS_STREAM_CALIBRATION);
   }
+  if (gyroSamples < GYRO_SAMPLES)
+    return true;
+
+  calibration.gyroX = gyroSum[0] / (float)GYRO_SAMPLES;
+  calibration.gyroY = gyroSum[1] / (float)GYRO_SAMPLES;
+  calibration.gyroZ = gyroSum[2] / (float)GYRO_SAMPLES;
+  // the fitted slopes still apply around the new reference
+  gyroTempModel.reference = gyroTempSum / GYRO_SAMPLES;
+  gyroBias.reset();
+
+  paramsChanged();
+  return false;
+}
 
-  writeServo(10);
-  delay(100);
-  writeServo(0);
+bool tickAccelCalibration(const RateContext &ctx) {
+  if (ctx.stale || steering())
+    return true;
+
+  const RawICUData raw = getEstimatorState().raw;
+  accelSum[0] += raw.ax;
+  accelSum[1] += raw.ay;
+  accelSum[2] += raw.az;
+  accelSamples++;
+
+  if (accelSamples % 25 == 0) {
+    sendPacket(AccelCalibrationProgressPacket{
+                   (float)accelSamples / ACCEL_SAMPLES * 100.0f, accelAxis},
+               WS_LATEST, WS_STREAM_CALIBRATION);
+  }
+  if (accelSamples < ACCEL_SAMPLES)
+    return true;
+
+  sendPacket(AccelCalibrationDataPacket{
+      accelAxis, (float)(accelSum[0] / ACCEL_SAMPLES),
+      (float)(accelSum[1] / ACCEL_SAMPLES),
+      (float)(accelSum[2] / ACCEL_SAMPLES)});
+  return false;
+}
+
+// Telemetry group, started with the web server. The subscriptions pick
+// their decimation of TLM_RATE per client.
+bool tickTelemetry(const RateContext &ctx) {
+  uint16_t masks[WS_MAX_CLIENTS];
+
+  if (nextTelemetryMasks(masks)) {
+    TelemetrySample sample = {getEstimatorState(), yawAnchor, getPIDTerms(),
+                              servoOutput, motorOutput};
+    sendTelemetry(masks, &sample);
+  }
+  return true;
+}
+
+// Housekeeping group, once a second, started with the web server.
+bool tickStats(const RateContext &ctx) {
+  if (packetQueueStats.dropped != reportedPacketDrops) {
+    reportedPacketDrops = packetQueueStats.dropped;
+    sendMessagePacket(strf("Packet queue full, %u packets dropped",
+                           packetQueueStats.dropped));
+  }
 
+  sendLoopTiming();
+  sendStats();
+  return true;
+}
+
+void setup() {
+  pinMode(BUTTON_PIN, INPUT);
+  // Serial.begin(460800);
+  setupPID();
+  setupParams();
+  setupRecorder();
+  setupMagCalibrator();
+
+  actuatorBegin(ACT_SERVO, servoConfig);
+  actuatorBegin(ACT_MOTOR, motorConfig);
+  actuatorArm(ACT_SERVO);
+  actuatorArm(ACT_MOTOR);
+  writeServo(0);
+  writeMotor(ACTUATOR_MOTOR_NEUTRAL_US);
+  halTimerStart(1000000 / ACTUATOR_RATE, [] { actuatorTick(micros()); });
+
+  bootMark(BOOT_setup);
+
+  for (Job *job : {&steeringJob, &wiggleJob, &recorderJob,
+                   &magCalibrationJob, &gyroCalibrationJob,
+                   &accelCalibrationJob, &telemetryJob, &statsJob})
+    executiveAdd(job);
+  steeringJob.start();
+  wiggleJob.start();
+  recorderJob.start();
+  executiveStart();
+
+  setupPacketHandlers();
+  imuInitialized = setupIMU(
+      [](float yaw, float dt, RawICUData raw, bool stale, bool newest) {
+        executiveSample(getEstimatorState(), newest);
+      },
+      applyQueuedPackets);
+  if (imuInitialized)
+    bootMark(BOOT_imu);
+
+  static_assert(sizeof(SubscribePacket::decimation) == TLM_CHANNEL_COUNT,
+                "subscribe packet out of sync with the telemetry channels");
   setupWS([](AsyncWebSocket *server, AsyncWebSocketClient *client,
              const uint8_t *data, size_t len) {
-    auto id = data[0];
-    handlePacket(id, data + 1, len - 1);
+    // a subscription belongs to the client, not the control state, so it is
+    // applied right here instead of on the IMU task
+    if (len == 1 + PacketTraits<SubscribePacket>::size &&
+        data[0] == SubscribePacket::id) {
+      SubscribePacket packet;
+      decodePacket(data + 1, &packet);
+      wsSubscribe(client->id(), packet.streams, packet.decimation,
+                  TLM_CHANNEL_COUNT);
+      return;
+    }
+
+    if (!queuePacket(data, len))
+      sendMessagePacket(strf("Dropped packet 0x%02x (%u bytes)",
+                             len ? data[0] : 0, (unsigned)len));
   });
+  // joins while the button window runs, autopilot turns it off again
+  startWiFi();
 
+  bootStateTime = millis();
   lastPingTime = millis();
-  lastUpdateSentTime = millis();
+}
+
+void wiggleServo(int8_t angle) { wiggleRequest = angle; }
+
+// Control group, after steering: the servo keeps one writer, and a wiggle
+// never moves or recentres a rudder that something steers.
+bool tickWiggle(const RateContext &ctx) {
+  static uint32_t wiggleEnd = 0;
+  int8_t angle = wiggleRequest.exchange(0);
+  uint32_t now = millis();
+
+  if (steering()) {
+    wiggleEnd = 0;
+  } else if (angle) {
+    writeServo(angle);
+    wiggleEnd = now + WIGGLE_MS;
+  } else if (wiggleEnd && (int32_t)(now - wiggleEnd) >= 0) {
+    wiggleEnd = 0;
+    writeServo(0);
+  }
+  return true;
+}
+
+// The servo wiggles once the prompt is due. Holding the button from then
+// until the window closes selects the autopilot, confirmed by a wiggle the
+// other way; otherwise the web server starts, after a second wiggle.
+void tickBoot() {
+  uint32_t now = millis();
+
+  switch (bootState) {
+  case BOOT_CENTERING:
+    if (now - bootStateTime >= BOOT_PROMPT_MS) {
+      wiggleServo(10);
+      bootState = BOOT_BUTTON_WINDOW;
+      bootStateTime = now;
+      buttonSince = 0;
+    }
+    break;
+
+  case BOOT_BUTTON_WINDOW:
+    if (!digitalRead(BUTTON_PIN))
+      buttonSince = 0;
+    else if (buttonSince == 0)
+      buttonSince = now;
+
+    if (buttonSince && now - buttonSince >= BOOT_BUTTON_HOLD_MS) {
+      wiggleServo(-10);
+      stopWiFi();
+      apState = AP_READY;
+    } else if (now - bootStateTime >= BOOT_BUTTON_MS) {
+      wiggleServo(10);
+      startWS();
+      telemetryJob.start();
+      statsJob.start();
+    } else {
+      break;
+    }
+
+    bootState = BOOT_DONE;
+    bootMark(BOOT_mode);
+    break;
+
+  default:
+    break;
+  }
 }
 
 void loop() {
+  PROBE_SCOPE(loop);
   tickWS();
+  // without the IMU task the control group never runs
+  if (!imuRunning())
+    tickWiggle({});
 
-  if (apState == AP_DISABLED) {
-    if (millis() - lastUpdateSentTime > 180) {
-      lastUpdateSentTime = millis();
-
-      if (magCalibrating)
-        sendMagPointPacket(mx, my, mz);
-      else
-        sendRotationPacket(getYaw());
-    }
+  if (bootTimeline[BOOT_heading] == 0 && getEstimatorState().sample)
+    bootMark(BOOT_heading);
 
+  if (bootState != BOOT_DONE) {
+    tickBoot();
     return;
   }
 
+  // without the IMU task there is no control cycle to apply packets in
+  if (!imuRunning())
+    applyQueuedPackets();
+
+  // telemetry and stats run in their rate groups
+  if (apState == AP_DISABLED)
+    return;
+
+  // the stored mission (or the default run) starts when the button that
+  // selected the autopilot is let go, and again on the next press and release
+  // once it is over
   if (apState == AP_READY && !digitalRead(BUTTON_PIN)) {
     apState = AP_GOING;
-    apStartTime = millis();
-    anchoring = true;
-    yawAnchor = getYaw();
+    missionRequested = true;
   }
 
-  if (apState == AP_GOING) {
-    auto duration = millis() - apStartTime;
-
-    float apSpeed =
-        1500.0f + min(calibration.maxAPSpeed * 5.0f - 35.0f, 0.05f * duration);
-    servo.write(MOTOR_PIN, apSpeed + 35.0f);
+  if (apState == AP_GOING && !missionRequested && !mission.running())
+    apState = AP_DONE;
 
-    if (duration > 30000) {
-      servo.write(MOTOR_PIN, 0);
-      anchoring = false;
-      writeServo(0);
-
-      for (;;)
-        yield();
-    }
-  }
+  if (apState == AP_DONE && digitalRead(BUTTON_PIN))
+    apState = AP_READY;
 }
\ No newline at end of file
@@ -0,0 +1,190 @@
+#include "metrics.h"
+#include "acquisition.h"
+#include "actuator.h"
+#include "boot.h"
+#include "executive.h"
+#include "packets.h"
+#include "ws_queue.h"
+#include <stdarg.h>
+#include <stdio.h>
+
+ProbeStats probeStats[PROBE_COUNT];
+
+#define PROBE_NAME(name) #name,
+const char *const probeNames[PROBE_COUNT] = {PROBE_LIST(PROBE_NAME)};
+#undef PROBE_NAME
+
+static int probeBin(uint32_t cycles) {
+  if (cycles < (1u << PROBE_MIN_LOG2))
+    return 0;
+
+  int log2 = 31 - __builtin_clz(cycles);
+  int bin = (log2 - PROBE_MIN_LOG2) * 4 + ((cycles >> (log2 - 2)) & 3);
+  return bin < PROBE_BINS ? bin : PROBE_BINS - 1;
+}
+
+static uint32_t probeBinEdge(int bin) {
+  return (uint32_t)(5 + bin % 4) << (bin / 4 + PROBE_MIN_LOG2 - 2);
+}
+
+void probeRecord(ProbeId id, uint32_t cycles) {
+  ProbeStats &s = probeStats[id];
+
+  if (s.count == 0 || cycles < s.min)
+    s.min = cycles;
+  if (cycles > s.max)
+    s.max = cycles;
+  s.sum += cycles;
+  s.bins[probeBin(cycles)]++;
+  s.count++;
+}
+
+uint32_t probePercentile(const ProbeStats *stats, float fraction) {
+  uint32_t seen = 0;
+
+  for (int i = 0; i < PROBE_BINS; i++) {
+    seen += stats->bins[i];
+    if (seen > 0 && seen >= fraction * stats->count)
+      return probeBinEdge(i) < stats->max ? probeBinEdge(i) : stats->max;
+  }
+
+  return stats->max;
+}
+
+static void appendf(char *buf, size_t size, size_t *len, const char *fmt,
+                    ...) {
+  if (*len + 1 >= size)
+    return;
+
+  va_list args;
+  va_start(args, fmt);
+  int n = vsnprintf(buf + *len, size - *len, fmt, args);
+  va_end(args);
+
+  if (n > 0)
+    *len = *len + n < size ? *len + n : size - 1;
+}
+
+size_t formatMetrics(char *buf, size_t size) {
+  static const float quantiles[] = {0.5f, 0.9f, 0.99f};
+  float usPerCycle = 1.0f / halCyclesPerUs();
+  size_t len = 0;
+  buf[0] = 0;
+
+  appendf(buf, size, &len,
+          "# HELP quanta_stage_seconds Time per call of a hot path stage.\n"
+          "# TYPE quanta_stage_seconds summary\n");
+  for (int i = 0; i < PROBE_COUNT; i++) {
+    const ProbeStats *s = &probeStats[i];
+
+    for (float q : quantiles)
+      appendf(buf, size, &len,
+              "quanta_stage_seconds{stage=\"%s\",quantile=\"%g\"} %.9f\n",
+              probeNames[i], q,
+              probePercentile(s, q) * usPerCycle * 1e-6f);
+    appendf(buf, size, &len,
+            "quanta_stage_seconds_sum{stage=\"%s\"} %.9f\n"
+            "quanta_stage_seconds_count{stage=\"%s\"} %u\n",
+            probeNames[i], s->sum * usPerCycle * 1e-6, probeNames[i],
+            s->count);
+  }
+
+  appendf(buf, size, &len, "# TYPE quanta_stage_max_seconds gauge\n");
+  for (int i = 0; i < PROBE_COUNT; i++)
+    appendf(buf, size, &len, "quanta_stage_max_seconds{stage=\"%s\"} %.9f\n",
+            probeNames[i], probeStats[i].max * usPerCycle * 1e-6f);
+
+  appendf(buf, size, &len, "# TYPE quanta_stage_min_seconds gauge\n");
+  for (int i = 0; i < PROBE_COUNT; i++)
+    appendf(buf, size, &len, "quanta_stage_min_seconds{stage=\"%s\"} %.9f\n",
+            probeNames[i], probeStats[i].min * usPerCycle * 1e-6f);
+
+  const struct {
+    const char *name, *type;
+    double value;
+  } counters[] = {
+      {"quanta_imu_frames_total", "counter", (double)acqStats.frames},
+      {"quanta_imu_fifo_overflows_total", "counter",
+       (double)acqStats.overflows},
+      {"quanta_imu_stale_cycles_total", "counter",
+       (double)acqStats.staleCycles},
+      {"quanta_imu_overruns_total", "counter", (double)timingStats.overruns},
+      {"quanta_imu_sample_period_seconds", "gauge",
+       timingStats.periodUs * 1e-6},
+      {"quanta_imu_max_cycle_seconds", "gauge",
+       timingStats.maxCycleUs * 1e-6},
+      {"quanta_packets_applied_total", "counter",
+       (double)packetQueueStats.applied},
+      {"quanta_packets_dropped_total", "counter",
+       (double)packetQueueStats.dropped},
+      {"quanta_ws_frames_total", "counter", (double)wsStats.frames},
+      {"quanta_ws_dropped_total", "counter", (double)wsStats.dropped},
+      {"quanta_ws_closed_total", "counter", (double)wsStats.closed},
+      {"quanta_heap_free_bytes", "gauge", (double)halFreeHeap()},
+      {"quanta_heap_min_free_bytes", "gauge", (double)halMinFreeHeap()},
+  };
+
+  for (auto &c : counters)
+    appendf(buf, size, &len, "# TYPE %s %s\n%s %.9g\n", c.name, c.type,
+            c.name, c.value);
+
+  const struct {
+    const char *name, *type;
+    uint32_t WSClientStats::*value;
+  } clientCounters[] = {
+      {"quanta_ws_queue_depth", "gauge", &WSClientStats::depth},
+      {"quanta_ws_queue_max_depth", "gauge", &WSClientStats::maxDepth},
+      {"quanta_ws_queue_bytes", "gauge", &WSClientStats::bytes},
+      {"quanta_ws_client_sent_total", "counter", &WSClientStats::sent},
+      {"quanta_ws_client_dropped_total", "counter", &WSClientStats::dropped},
+      {"quanta_ws_client_replaced_total", "counter", &WSClientStats::replaced},
+  };
+
+  appendf(buf, size, &len, "# TYPE quanta_boot_phase_seconds gauge\n");
+  for (int i = 0; i < BOOT_PHASE_COUNT; i++)
+    if (bootTimeline[i])
+      appendf(buf, size, &len, "quanta_boot_phase_seconds{phase=\"%s\"} %.3f\n",
+              bootPhaseNames[i], bootTimeline[i] * 1e-3);
+
+  appendf(buf, size, &len, "# TYPE quanta_actuator_output_us gauge\n");
+  for (int i = 0; i < ACT_COUNT; i++)
+    appendf(buf, size, &len,
+            "quanta_actuator_output_us{channel=\"%s\"} %.1f\n",
+            actuatorNames[i], actuatorStats[i].output);
+  appendf(buf, size, &len, "# TYPE quanta_actuator_clamped_total counter\n");
+  for (int i = 0; i < ACT_COUNT; i++)
+    appendf(buf, size, &len,
+            "quanta_actuator_clamped_total{channel=\"%s\"} %u\n",
+            actuatorNames[i], actuatorStats[i].clamped);
+  appendf(buf, size, &len,
+          "# TYPE quanta_actuator_slew_limited_total counter\n");
+  for (int i = 0; i < ACT_COUNT; i++)
+    appendf(buf, size, &len,
+            "quanta_actuator_slew_limited_total{channel=\"%s\"} %u\n",
+            actuatorNames[i], actuatorStats[i].slewLimited);
+
+  appendf(buf, size, &len,
+          "# TYPE quanta_group_utilization_percent gauge\n");
+  for (int i = 0; i < RATE_GROUP_COUNT; i++)
+    appendf(buf, size, &len,
+            "quanta_group_utilization_percent{group=\"%s\"} %.2f\n",
+            rateGroupNames[i], rateGroupStats[i].utilization);
+  appendf(buf, size, &len, "# TYPE quanta_group_overruns_total counter\n");
+  for (int i = 0; i < RATE_GROUP_COUNT; i++)
+    appendf(buf, size, &len, "quanta_group_overruns_total{group=\"%s\"} %u\n",
+            rateGroupNames[i], rateGroupStats[i].overruns);
+  appendf(buf, size, &len, "# TYPE quanta_group_max_seconds gauge\n");
+  for (int i = 0; i < RATE_GROUP_COUNT; i++)
+    appendf(buf, size, &len, "quanta_group_max_seconds{group=\"%s\"} %.6f\n",
+            rateGroupNames[i], rateGroupStats[i].maxUs * 1e-6);
+
+  for (auto &c : clientCounters) {
+    appendf(buf, size, &len, "# TYPE %s %s\n", c.name, c.type);
+    for (int i = 0; i < WS_MAX_CLIENTS; i++)
+      if (wsClientStats[i].id)
+        appendf(buf, size, &len, "%s{client=\"%u\"} %u\n", c.name,
+                wsClientStats[i].id, wsClientStats[i].*c.value);
+  }
+
+  return len;
+}
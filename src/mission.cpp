@@ -0,0 +1,141 @@
+#include "mission.h"
+#include "filters.h"
+#include <math.h>
+
+#define MISSION_DEFAULT_S 30
+#define MISSION_DEFAULT_RAMP_US_PER_S 50
+
+void missionDefault(MissionPlan *plan, float maxSpeed) {
+  float ramp = (5 * maxSpeed - MISSION_MOTOR_MIN_US) /
+               MISSION_DEFAULT_RAMP_US_PER_S;
+  ramp = fminf(fmaxf(ramp, 0.1f), MISSION_DEFAULT_S - 1);
+
+  *plan = MissionPlan();
+  plan->count = 2;
+  plan->legs[0] = {LEG_HEADING_HOLD, LEG_SPEED_RAMP, 0, maxSpeed, ramp, 0};
+  plan->legs[1] = {LEG_HEADING_HOLD, LEG_SPEED_HOLD, 0, maxSpeed,
+                   MISSION_DEFAULT_S - ramp, 0};
+}
+
+const char *missionValidate(const MissionPlan *plan) {
+  if (plan->count == 0 || plan->count > MISSION_MAX_LEGS)
+    return "no legs or too many";
+
+  for (int i = 0; i < plan->count; i++) {
+    const MissionLeg &leg = plan->legs[i];
+
+    if (leg.headingMode > LEG_HEADING_RELATIVE ||
+        leg.speedProfile > LEG_SPEED_COAST)
+      return "unknown heading mode or speed profile";
+    if (!(leg.duration > 0 && leg.duration <= MISSION_MAX_LEG_S))
+      return "leg duration out of range";
+    if (!(leg.speed >= 0 && leg.speed <= 100))
+      return "leg speed out of range";
+    if (!(fabsf(leg.heading) <= 3600 && leg.turnRate >= 0 &&
+          leg.turnRate <= 360))
+      return "leg heading or turn rate out of range";
+  }
+
+  return NULL;
+}
+
+bool MissionExecutor::load(const MissionPlan &plan, float heading,
+                           float maxSpeed) {
+  state = MISSION_IDLE;
+  count = current = legs = 0;
+  duration = elapsed = 0;
+  if (missionValidate(&plan))
+    return false;
+
+  float speed = 0;
+
+  for (int i = 0; i < plan.count; i++) {
+    const MissionLeg &leg = plan.legs[i];
+    uint32_t length = lroundf(leg.duration * 1000);
+    float target = fminf(leg.speed, maxSpeed);
+
+    float turn = 0;
+    if (leg.headingMode == LEG_HEADING_ABSOLUTE)
+      turn = wrap180(leg.heading - wrap360(heading)); // the short way round
+    else if (leg.headingMode == LEG_HEADING_RELATIVE)
+      turn = leg.heading;
+
+    // a turn the rate limit cannot finish within the leg ends where the leg
+    // does, the next one carries on from there
+    uint32_t turning = 0;
+    if (turn != 0 && leg.turnRate > 0) {
+      float ms = fabsf(turn) / leg.turnRate * 1000;
+      turning = ms < length ? lroundf(ms) : length;
+    }
+
+    float speedRate = 0;
+    if (leg.speedProfile == LEG_SPEED_RAMP)
+      speedRate = (target - speed) / length;
+    else
+      speed = leg.speedProfile == LEG_SPEED_HOLD ? target : 0;
+
+    if (turning) {
+      float rate = copysignf(leg.turnRate * 1e-3f, turn);
+      segments[count++] = {duration, duration + turning, heading, rate,
+                           speed, speedRate, (uint8_t)i};
+      heading += rate * turning;
+      speed += speedRate * turning;
+    } else {
+      heading += turn;
+    }
+
+    if (turning < length) {
+      segments[count++] = {duration + turning, duration + length, heading, 0,
+                           speed, speedRate, (uint8_t)i};
+      speed += speedRate * (length - turning);
+    }
+
+    duration += length;
+  }
+
+  legs = plan.count;
+  return true;
+}
+
+void MissionExecutor::start(uint32_t timestamp) {
+  if (count == 0)
+    return;
+
+  startTime = timestamp;
+  current = 0;
+  elapsed = 0;
+  state = MISSION_RUNNING;
+}
+
+void MissionExecutor::stop() {
+  if (state == MISSION_RUNNING)
+    state = MISSION_STOPPED;
+}
+
+MissionSetpoint MissionExecutor::update(uint32_t timestamp) {
+  if (count == 0)
+    return {0, 0};
+
+  if (state == MISSION_RUNNING) {
+    elapsed = (timestamp - startTime + 500) / 1000;
+
+    while (current + 1 < count && elapsed >= segments[current].end)
+      current++;
+    if (elapsed >= duration) {
+      elapsed = duration;
+      state = MISSION_DONE;
+    }
+  }
+
+  const MissionSegment &s = segments[current];
+  uint32_t t = (elapsed < s.end ? elapsed : s.end) - s.start;
+
+  if (state != MISSION_RUNNING)
+    return {wrap360(s.heading + s.headingRate * t), 0};
+  return {wrap360(s.heading + s.headingRate * t), s.speed + s.speedRate * t};
+}
+
+const MissionSegment *MissionExecutor::getSegments(size_t *n) const {
+  *n = count;
+  return segments;
+}
@@ -0,0 +1,113 @@
+#include "acquisition.h"
+#include "calibration.h"
+#include "filters.h"
+#include "fusion.h"
+#include "i2c_engine.h"
+#include "native.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+// Runs the FIFO/DRDY acquisition path against the simulated sensors the way
+// imuTask does: wake every ACQ_BURST frames (with jitter and an occasional
+// long stall), drain the FIFO, read the magnetometer when it has new data.
+// Every 10 s the bus also gets stuck until the I2C engine recovers it. The
+// MPU's oscillator can be off by a few percent, which the sample clock has
+// to measure.
+int acqMain(int argc, char **argv) {
+  int seconds = argc > 0 ? atoi(argv[0]) : 60;
+  int stallMs = argc > 1 ? atoi(argv[1]) : 500;
+  float clockError = argc > 2 ? atof(argv[2]) : 1.5f;
+  if (seconds <= 0 || stallMs < 0) {
+    fprintf(stderr,
+            "usage: acq [seconds] [stall ms every 10 s] [MPU clock error %%]\n");
+    return 1;
+  }
+
+  srand(1);
+  simSensorsAttach();
+  simSetMPUClock(1 + clockError / 100);
+  if (!setupMPUFifo(SAMPLE_RATE) || !setupHMCContinuous(HMC_RATE_75HZ)) {
+    fprintf(stderr, "sensor setup failed\n");
+    return 1;
+  }
+
+  FusionFilter fusion;
+  fusion.begin(SAMPLE_RATE);
+
+  static uint8_t frames[ACQ_MAX_FRAMES * MPU_BURST_LEN];
+  static uint8_t magBuf[MAG_BURST_LEN];
+  static uint32_t stamps[ACQ_MAX_FRAMES];
+  RawICUData raw = {};
+  EstimatorState state = {};
+  uint32_t lastStamp = 0;
+  bool monotonic = true;
+  uint32_t magSeen = 0, received = 0;
+  uint64_t nextStallUs = 10000000, nextFaultUs = 5000000;
+  double errSum = 0;
+  uint32_t errCount = 0;
+
+  const uint32_t burstUs = ACQ_BURST * 1000000 / SAMPLE_RATE;
+
+  while (simTime() < (uint64_t)seconds * 1000000) {
+    uint32_t wait = burstUs + rand() % (burstUs / 4);
+    if (simTime() >= nextStallUs) {
+      wait += stallMs * 1000;
+      nextStallUs += 10000000;
+    }
+    simSensorsAdvance(wait);
+
+    if (simTime() >= nextFaultUs) {
+      nativeStickI2CBus();
+      nextFaultUs += 10000000;
+    }
+
+    AcquisitionResult acq =
+        acquire(frames, ACQ_MAX_FRAMES, magBuf, simMagSamples() != magSeen,
+                micros() + ACQ_BUDGET_US);
+    int n = acq.frames;
+    stampFrames(simTime(), n, stamps);
+
+    if (acq.magFresh) {
+      magSeen = simMagSamples();
+      decodeHMC5883(magBuf, &raw);
+    }
+
+    for (int i = 0; i < n; i++) {
+      decodeMPU6050(frames + i * MPU_BURST_LEN, &raw);
+      fuseSample(&fusion, &raw, &calibration, stamps[i], &state);
+      monotonic &= state.sample == 1 || (int32_t)(stamps[i] - lastStamp) > 0;
+      lastStamp = stamps[i];
+    }
+    received += n > 0 ? n : 0;
+
+    if (n > 0 && simTime() > 5000000) {
+      float truth = simHeading(simTime() / 1e6f);
+      errSum += fabsf(wrap180(state.yaw - truth));
+      errCount++;
+    }
+  }
+
+  printf("%.1f s simulated at %d Hz, burst %d\n", simTime() / 1e6, SAMPLE_RATE,
+         ACQ_BURST);
+  printf("frames: %u produced, %u received, %u lost\n", simFramesProduced(),
+         received, simFramesProduced() - received);
+  printf("drains: %u, overflows: %u, stale cycles: %u\n", acqStats.drains,
+         acqStats.overflows, acqStats.staleCycles);
+  printf("i2c: %u transfers, %u nacks, %u timeouts, %u expired, %u "
+         "recoveries\n",
+         i2cStats.transactions, i2cStats.nacks, i2cStats.timeouts,
+         i2cStats.expired, i2cStats.recoveries);
+  printf("mag: %u samples, %u reads\n", simMagSamples(), acqStats.magReads);
+  printf("clock: period %.1f us (true %.1f), %u resyncs, stamps %s\n",
+         timingStats.periodUs, 1000000.0f / SAMPLE_RATE / (1 + clockError / 100),
+         timingStats.resyncs, monotonic ? "monotonic" : "NOT monotonic");
+  printf("wakes: %u, overruns: %u, jitter (%d us bins):", timingStats.wakes,
+         timingStats.overruns, TIMING_BIN_US);
+  for (int i = 0; i < TIMING_BINS; i++)
+    printf(" %u", timingStats.jitter[i]);
+  printf("\n");
+  printf("mean |yaw - truth| after settling: %.2f deg\n",
+         errCount ? errSum / errCount : 0.0);
+
+  return acqStats.frames == received ? 0 : 1;
+}
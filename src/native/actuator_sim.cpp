@@ -0,0 +1,114 @@
+#include "actuator.h"
+#include "native.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Drives the actuator module the way the firmware does, with a control task
+// commanding at its own rate and the output timer at ACTUATOR_RATE, and
+// checks the limits: the ESC holds its arming pulse before taking commands,
+// no output step is larger than the slew limit allows, outputs stay in range,
+// and interpolation splits a slow command stream into smaller steps.
+
+#define SIM_SECONDS 6
+#define SIM_ARM_MS 2000
+
+struct SimResult {
+  float maxStep[ACT_COUNT]; // us between ticks
+  float maxError;           // servo output against the command, us
+  float armedAt, motorAt;   // s, motor left neutral / reached its command
+  bool armingHeld, inRange;
+};
+
+static SimResult run(uint32_t controlHz, bool interpolate) {
+  const ActuatorConfig servo = {
+      21, 50, ACTUATOR_SERVO_MIN_US, ACTUATOR_SERVO_MAX_US, 6000, interpolate};
+  const ActuatorConfig motor = {
+      20, 50, 1000, 2000, 1000, interpolate, 1, {{1500, SIM_ARM_MS}}};
+  SimResult r = {};
+  r.armingHeld = r.inRange = true;
+  r.armedAt = r.motorAt = -1;
+
+  actuatorBegin(ACT_SERVO, servo);
+  actuatorBegin(ACT_MOTOR, motor);
+  actuatorArm(ACT_SERVO);
+  actuatorArm(ACT_MOTOR);
+
+  uint32_t tickUs = 1000000 / ACTUATOR_RATE, controlUs = 1000000 / controlHz;
+  uint32_t nextTick = 0, nextControl = 0;
+  float last[ACT_COUNT] = {}, command = 0;
+
+  for (uint32_t now = 0; now < SIM_SECONDS * 1000000u; now++) {
+    if (now == nextControl) {
+      float t = now * 1e-6f;
+      command = 1500 + 300 * sinf(2 * PI * t / 2);
+      // one command far out of range, clamped
+      actuatorCommand(ACT_SERVO, now == 3 * controlUs ? 3000 : command, now);
+      actuatorCommand(ACT_MOTOR, 1800, now);
+      nextControl += controlUs;
+    }
+    if (now != nextTick)
+      continue;
+    nextTick += tickUs;
+
+    actuatorTick(now);
+    float t = now * 1e-6f;
+
+    float servoOut = nativePWMValue(ACT_SERVO);
+    float motorOut = nativePWMValue(ACT_MOTOR);
+
+    // the servo after the clamped command has been slewed out
+    if (t > 1)
+      r.maxStep[ACT_SERVO] =
+          fmaxf(r.maxStep[ACT_SERVO], fabsf(servoOut - last[ACT_SERVO]));
+    if (last[ACT_MOTOR] > 0)
+      r.maxStep[ACT_MOTOR] =
+          fmaxf(r.maxStep[ACT_MOTOR], fabsf(motorOut - last[ACT_MOTOR]));
+    last[ACT_SERVO] = servoOut;
+    last[ACT_MOTOR] = motorOut;
+
+    r.inRange &= servoOut >= servo.minUs && servoOut <= servo.maxUs &&
+                 motorOut >= motor.minUs && motorOut <= motor.maxUs;
+    if (t < SIM_ARM_MS * 1e-3f)
+      r.armingHeld &= motorOut == 1500;
+    else if (r.armedAt < 0 && motorOut != 1500)
+      r.armedAt = t;
+    if (r.motorAt < 0 && motorOut == 1800)
+      r.motorAt = t;
+    if (t > 1)
+      r.maxError = fmaxf(r.maxError, fabsf(servoOut - command));
+  }
+
+  return r;
+}
+
+int actuatorMain(int argc, char **argv) {
+  int controlHz = argc > 0 ? atoi(argv[0]) : 50;
+  if (controlHz <= 0 || controlHz > 1000) {
+    fprintf(stderr, "usage: actuator [control hz]\n");
+    return 1;
+  }
+
+  printf("control at %d Hz, outputs at %d Hz\n", controlHz, ACTUATOR_RATE);
+  printf("%-12s %10s %10s %10s %8s %8s %6s\n", "", "servo step",
+         "motor step", "servo err", "armed", "motor at", "range");
+
+  bool ok = true;
+  float servoSlew = 6000.0f / ACTUATOR_RATE;
+  float motorSlew = 1000.0f / ACTUATOR_RATE;
+
+  for (bool interpolate : {false, true}) {
+    SimResult r = run(controlHz, interpolate);
+    printf("%-12s %10.1f %10.1f %10.1f %8.2f %8.2f %6s\n",
+           interpolate ? "interpolate" : "step", r.maxStep[ACT_SERVO],
+           r.maxStep[ACT_MOTOR], r.maxError, r.armedAt, r.motorAt,
+           r.inRange ? "ok" : "out");
+
+    ok &= r.armingHeld && r.inRange && r.armedAt >= SIM_ARM_MS * 1e-3f &&
+          r.motorAt > 0 && r.maxStep[ACT_SERVO] <= servoSlew + 0.01f &&
+          r.maxStep[ACT_MOTOR] <= motorSlew + 0.01f;
+  }
+
+  printf("%u servo commands clamped\n", actuatorStats[ACT_SERVO].clamped);
+  return ok && actuatorStats[ACT_SERVO].clamped == 2 ? 0 : 1;
+}
@@ -0,0 +1,103 @@
+#include "autotune.h"
+#include "executive.h"
+#include "filters.h"
+#include "hull.h"
+#include "main.h"
+#include "native.h"
+#include "pid.h"
+#include "pipeline.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Runs the relay autotuner against a simulated hull (hull.h) and checks the
+// result. The ultimate gain and period of that loop are known in closed form,
+// so the relay estimate can be compared, and the tuned gains are tried on a
+// 20 degree heading step. The hysteresis band shifts the relay's operating
+// point off the ultimate point, so a relay amplitude that makes the
+// oscillation small against it underestimates Ku. The hull moves every
+// sample, the tuner and the PID only run on the control group's.
+
+static void stepResponse(const AutotuneResult &gains, Hull hull) {
+  setupPID();
+  pid.setKp(gains.kp);
+  pid.setKi(gains.ki);
+  pid.setKd(gains.kd);
+
+  float anchor = 20, yaw = 0, peak = 0, settled = -1, output = 0;
+  double absSum = 0;
+  hull.heading = hull.rate = 0;
+  hull.servo.clear();
+
+  for (int i = 0; i < 60 * SAMPLE_RATE; i++) {
+    yaw = hull.step(output);
+    if (i % CONTROL_DECIMATION == 0)
+      output = tickPID(anchor, yaw, 1.0f / CONTROL_RATE);
+
+    float error = headingError(anchor, hull.heading);
+    float t = (float)i / SAMPLE_RATE;
+    peak = fmaxf(peak, error);
+    if (fabsf(error) > 1)
+      settled = -1;
+    else if (settled < 0)
+      settled = t;
+    if (t >= 50)
+      absSum += fabsf(error);
+  }
+
+  printf("step 20 deg: overshoot %.1f deg, settled (1 deg) after %.1f s, "
+         "residual %.2f deg\n",
+         peak, settled, absSum / (10 * SAMPLE_RATE));
+}
+
+int autotuneMain(int argc, char **argv) {
+  AutotuneRule rule = TUNE_ZIEGLER_NICHOLS;
+  if (argc > 0 && strcmp(argv[0], "tl") == 0)
+    rule = TUNE_TYREUS_LUYBEN;
+  else if (argc > 0 && strcmp(argv[0], "zn") != 0) {
+    fprintf(stderr, "usage: autotune [zn|tl] [amplitude] [dead time ms]\n");
+    return 1;
+  }
+
+  float amplitude = argc > 1 ? atof(argv[1]) : 15;
+  float deadTime = argc > 2 ? atof(argv[2]) / 1000 : 0.15f;
+
+  srand(1);
+  Hull hull = {0.6f, 1.5f, deadTime, 0.05f};
+  float trueKu, trueTu;
+  hull.ultimate(&trueKu, &trueTu);
+
+  RelayAutotuner tuner;
+  tuner.start({amplitude, 0.2f, 4, rule}, 0);
+
+  float output = 0;
+  uint32_t i = 0;
+  for (; tuner.running(); i++) {
+    uint32_t timestamp = i * (1000000 / SAMPLE_RATE);
+    float yaw = hull.step(output);
+    if (i % CONTROL_DECIMATION == 0)
+      output = tuner.update(headingError(0, yaw), timestamp);
+  }
+
+  printf("relay %.1f deg, %.1f s of oscillation\n", amplitude,
+         (float)i / SAMPLE_RATE);
+  if (tuner.getPhase() != AT_DONE) {
+    printf("failed: %s\n", tuner.getFailure());
+    return 1;
+  }
+
+  const AutotuneResult &r = tuner.getResult();
+  printf("Ku %.3f (plant %.3f), Tu %.2f s (plant %.2f s)\n", r.ku, trueKu,
+         r.tu, trueTu);
+  printf("%s: kp %.3f ki %.3f kd %.3f\n",
+         rule == TUNE_TYREUS_LUYBEN ? "Tyreus-Luyben" : "Ziegler-Nichols",
+         r.kp, r.ki, r.kd);
+
+  stepResponse(r, hull);
+
+  AutotuneResult exact;
+  autotuneGains(rule, trueKu, trueTu, &exact);
+  printf("with the exact Ku/Tu: ");
+  stepResponse(exact, hull);
+  return 0;
+}
@@ -0,0 +1,204 @@
+#include "blackbox.h"
+#include "calibration.h"
+#include "filters.h"
+#include "fusion.h"
+#include "metrics.h"
+#include "native.h"
+#include "pid.h"
+#include "pipeline.h"
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+struct BenchSample {
+  uint8_t mpu[MPU_BURST_LEN];
+  uint8_t mag[MAG_BURST_LEN];
+};
+
+static volatile float benchSink;
+
+static std::vector<BenchSample> makeSamples(size_t count) {
+  std::vector<BenchSample> samples(count);
+
+  for (size_t i = 0; i < count; i++) {
+    float t = (float)i / SAMPLE_RATE;
+    simEncodeMPU(t, samples[i].mpu);
+    simEncodeMag(t, samples[i].mag);
+  }
+
+  return samples;
+}
+
+// The windowed filter as it was before filters.h: sin/cos of the whole window
+// on every sample. Kept only as the reference for the filter stages below.
+#define LEGACY_YAW_WINDOW 37
+static float legacyYawBuffer[LEGACY_YAW_WINDOW];
+static int legacyYawIndex = 0;
+static bool legacyBufferFilled = false;
+
+static float legacyFilterYaw(float newYawDeg) {
+  legacyYawBuffer[legacyYawIndex] = newYawDeg * PI / 180.0f;
+  legacyYawIndex = (legacyYawIndex + 1) % LEGACY_YAW_WINDOW;
+  if (legacyYawIndex == 0)
+    legacyBufferFilled = true;
+
+  int count = legacyBufferFilled ? LEGACY_YAW_WINDOW : legacyYawIndex;
+
+  float sumSin = 0.0f, sumCos = 0.0f;
+  for (int i = 0; i < count; i++) {
+    sumSin += sin(legacyYawBuffer[i]);
+    sumCos += cos(legacyYawBuffer[i]);
+  }
+
+  float avg = atan2(sumSin / count, sumCos / count);
+  if (avg < 0)
+    avg += 2 * PI;
+
+  return avg * 180.0f / PI;
+}
+
+template <typename F>
+static void benchStage(const char *name, size_t count, int repeats, F &&fn) {
+  double best = 1e30, total = 0;
+
+  for (int r = 0; r < repeats; r++) {
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < count; i++)
+      fn(i);
+    auto end = std::chrono::steady_clock::now();
+
+    double ns = std::chrono::duration<double, std::nano>(end - start).count() /
+                count;
+    best = fmin(best, ns);
+    total += ns;
+  }
+
+  printf("%-14s %10.1f %10.1f\n", name, best, total / repeats);
+}
+
+int benchMain(int argc, char **argv) {
+  size_t count = argc > 0 ? strtoul(argv[0], NULL, 10) : 20000;
+  int repeats = argc > 1 ? atoi(argv[1]) : 20;
+  if (count == 0 || repeats <= 0) {
+    fprintf(stderr, "usage: bench [samples] [repeats]\n");
+    return 1;
+  }
+
+  srand(1);
+  auto samples = makeSamples(count);
+  std::vector<RawICUData> raws(count);
+  std::vector<CalibratedICUData> cals(count);
+  std::vector<float> yaws(count);
+
+  calibration.magX = 3.1f;
+  calibration.magY = -7.4f;
+  calibration.magZ = 12.0f;
+  float magScale[3][3] = {
+      {1.02f, 0.01f, -0.02f}, {0.01f, 0.97f, 0.03f}, {-0.02f, 0.03f, 1.05f}};
+  memcpy(calibration.magScale, magScale, sizeof(magScale));
+
+  FusionFilter fusion;
+  fusion.begin(SAMPLE_RATE);
+  setupPID();
+  pid.setKp(1.0f);
+  pid.setKi(0.1f);
+  pid.setKd(0.2f);
+
+  printf("%zu samples x %d repeats, ns per sample\n", count, repeats);
+  printf("%-14s %10s %10s\n", "stage", "best", "mean");
+
+  benchStage("decode", count, repeats, [&](size_t i) {
+    decodeMPU6050(samples[i].mpu, &raws[i]);
+    decodeHMC5883(samples[i].mag, &raws[i]);
+  });
+
+  benchStage("calibrate", count, repeats, [&](size_t i) {
+    applyCalibration(&raws[i], &calibration, &cals[i]);
+  });
+
+  benchStage("fusion.update", count, repeats, [&](size_t i) {
+    fusion.update(cals[i], 1.0f / SAMPLE_RATE);
+    yaws[i] = wrapYaw(fusion.getYaw(), calibration.north);
+  });
+
+  benchStage("filter legacy", count, repeats,
+             [&](size_t i) { benchSink = legacyFilterYaw(yaws[i]); });
+
+  benchStage("filterYaw", count, repeats,
+             [&](size_t i) { benchSink = filterYaw(yaws[i]); });
+
+  CircularEMA ema(0.2f);
+  benchStage("circular EMA", count, repeats,
+             [&](size_t i) { benchSink = ema.update(yaws[i]); });
+
+  CircularMedian<9> median;
+  benchStage("median<9>", count, repeats,
+             [&](size_t i) { benchSink = median.update(yaws[i]); });
+
+  float maxDiff = 0.0f;
+  CircularMean<LEGACY_YAW_WINDOW> mean;
+  legacyYawIndex = 0;
+  legacyBufferFilled = false;
+  for (size_t i = 0; i < count; i++)
+    maxDiff = fmaxf(maxDiff, fabsf(wrap180(mean.update(yaws[i]) -
+                                           legacyFilterYaw(yaws[i]))));
+  printf("%-14s %10.5f deg max difference to legacy\n", "filterYaw", maxDiff);
+
+  benchStage("tickPID", count, repeats, [&](size_t i) {
+    benchSink = tickPID(0.0f, yaws[i], 1.0f / SAMPLE_RATE);
+  });
+
+  EstimatorState state = {};
+  benchStage("imuTask", count, repeats, [&](size_t i) {
+    RawICUData raw;
+
+    decodeMPU6050(samples[i].mpu, &raw);
+    decodeHMC5883(samples[i].mag, &raw);
+    fuseSample(&fusion, &raw, &calibration, i * (1000000 / SAMPLE_RATE),
+               &state);
+    benchSink = tickPID(0.0f, state.yaw, state.dt);
+  });
+
+  // what the probes inside fuseSample and tickPID saw over all the stages
+  // above, their own two clock reads included
+  printf("%-14s %10s %10s %10s %10s\n", "probe", "mean", "p50", "p99", "max");
+  for (int i = 0; i < PROBE_COUNT; i++) {
+    const ProbeStats *s = &probeStats[i];
+    if (s->count)
+      printf("%-14s %10.1f %10u %10u %10u\n", probeNames[i],
+             (double)s->sum / s->count, probePercentile(s, 0.5f),
+             probePercentile(s, 0.99f), s->max);
+  }
+
+  std::vector<TelemetrySample> records(count);
+  for (size_t i = 0; i < count; i++) {
+    records[i] = {};
+    records[i].estimator.timestamp = i * (1000000 / SAMPLE_RATE);
+    records[i].estimator.yaw = yaws[i];
+    records[i].estimator.raw = raws[i];
+    records[i].pid = {yaws[i], yaws[i], 0.1f, -0.2f, yaws[i]};
+    records[i].motor = 1500.0f;
+  }
+
+  // one block per 2048 bytes, like the recorder
+  std::vector<uint8_t> log(count * BB_MAX_RECORD);
+  size_t logLen = 0, blockLen = 0;
+  BlackboxCodec codec;
+  benchStage("blackbox", count, repeats, [&](size_t i) {
+    if (i == 0)
+      logLen = blockLen = 0;
+    if (blockLen + BB_MAX_RECORD > 2048 || i == 0) {
+      blackboxBeginBlock(&codec);
+      blockLen = 0;
+    }
+    size_t n = blackboxEncode(&codec, &records[i], 0, log.data() + logLen);
+    logLen += n;
+    blockLen += n;
+  });
+
+  printf("%-14s %10.1f bytes per sample\n", "blackbox",
+         (double)logLen / count);
+
+  return 0;
+}
@@ -0,0 +1,48 @@
+#include "blackbox.h"
+#include "native.h"
+#include <stdio.h>
+#include <vector>
+
+// Decodes a blackbox log (LittleFS /bb/NNNNN.bbx) to CSV on stdout.
+
+int blackboxMain(int argc, char **argv) {
+  if (argc < 1) {
+    fprintf(stderr, "usage: blackbox <file.bbx>\n");
+    return 1;
+  }
+
+  std::vector<uint8_t> data;
+  if (!nativeReadFile(argv[0], &data))
+    return 1;
+
+  if (data.size() < 4 || memcmp(data.data(), BB_MAGIC, 4) != 0) {
+    fprintf(stderr, "%s: not a blackbox log\n", argv[0]);
+    return 1;
+  }
+
+  printf("timestamp,stale,anchoring,yaw,anchor,yaw_rate,error,p,i,d,output,"
+         "servo,motor,ax,ay,az,gx,gy,gz,mx,my,mz\n");
+
+  BlackboxLog log;
+  nativeDecodeBlackbox(data, &log, [](const TelemetrySample &s,
+                                                   uint8_t flags) {
+    const RawICUData &r = s.estimator.raw;
+    printf("%u,%d,%d,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.1f,"
+           "%.4f,%.4f,%.4f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f\n",
+           s.estimator.timestamp, flags & BB_STALE ? 1 : 0,
+           flags & BB_ANCHORING ? 1 : 0, s.estimator.yaw, s.yawAnchor,
+           s.estimator.yawRate, s.pid.error, s.pid.p, s.pid.i, s.pid.d,
+           s.pid.output, s.servo, s.motor, r.ax, r.ay, r.az, r.gx, r.gy, r.gz,
+           r.mx, r.my, r.mz);
+  });
+
+  if (log.hasHeader)
+    fprintf(stderr, "kp %g ki %g kd %g, north %.2f\n", log.header.pid.getKp(),
+            log.header.pid.getKi(), log.header.pid.getKd(),
+            log.header.calibration.north);
+  fprintf(stderr, "%zu records in %zu blocks, %.1f bytes per record%s\n",
+          log.records, log.blocks,
+          log.records ? (double)data.size() / log.records : 0.0,
+          log.truncated ? ", last block cut off" : "");
+  return 0;
+}
@@ -0,0 +1,133 @@
+#include "capture.h"
+#include "native.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+// Splits a raw capture (0x31 frames as saved by the calibration page) into
+// acc_data.csv, gyro_data.csv and mag_data.csv next to it, "x, y, z" per
+// line, and prints gaps and per-axis statistics.
+
+struct AxisStats {
+  double sum = 0, sumSq = 0;
+  float min = INFINITY, max = -INFINITY;
+  size_t n = 0;
+
+  void add(float v) {
+    sum += v;
+    sumSq += (double)v * v;
+    min = fminf(min, v);
+    max = fmaxf(max, v);
+    n++;
+  }
+
+  double mean() const { return n ? sum / n : 0; }
+  double stddev() const {
+    return n > 1 ? sqrt(fmax(0, (sumSq - sum * sum / n) / (n - 1))) : 0;
+  }
+};
+
+struct Dataset {
+  const char *name;
+  const char *unit;
+  FILE *file;
+  AxisStats axes[3];
+  AxisStats norm;
+
+  void add(float x, float y, float z) {
+    fprintf(file, "%.6f, %.6f, %.6f\n", x, y, z);
+    axes[0].add(x);
+    axes[1].add(y);
+    axes[2].add(z);
+    norm.add(sqrtf(x * x + y * y + z * z));
+  }
+
+  void print() const {
+    printf("%s (%zu samples, %s)\n", name, norm.n, unit);
+    printf("  %-4s %12s %12s %12s %12s\n", "", "mean", "std", "min", "max");
+    const char *labels[4] = {"x", "y", "z", "|v|"};
+    for (int i = 0; i < 4; i++) {
+      const AxisStats &s = i < 3 ? axes[i] : norm;
+      printf("  %-4s %12.5f %12.5f %12.5f %12.5f\n", labels[i], s.mean(),
+             s.stddev(), s.min, s.max);
+    }
+  }
+};
+
+static std::string siblingPath(const char *input, const char *name) {
+  std::string path = input;
+  size_t slash = path.find_last_of('/');
+  return (slash == std::string::npos ? "" : path.substr(0, slash + 1)) + name;
+}
+
+int captureMain(int argc, char **argv) {
+  if (argc < 1) {
+    fprintf(stderr, "usage: capture <file>\n");
+    return 1;
+  }
+
+  std::vector<uint8_t> data;
+  if (!nativeReadFile(argv[0], &data))
+    return 1;
+
+  Dataset acc = {"accel", "g", NULL, {}, {}};
+  Dataset gyro = {"gyro", "dps", NULL, {}, {}};
+  Dataset mag = {"mag", "uT", NULL, {}, {}};
+  Dataset *sets[3] = {&acc, &gyro, &mag};
+  const char *names[3] = {"acc_data.csv", "gyro_data.csv", "mag_data.csv"};
+
+  for (int i = 0; i < 3; i++) {
+    std::string path = siblingPath(argv[0], names[i]);
+    sets[i]->file = fopen(path.c_str(), "w");
+    if (sets[i]->file == NULL) {
+      perror(path.c_str());
+      return 1;
+    }
+  }
+
+  size_t lost = 0, timeGaps = 0;
+  uint32_t expectedSeq = 0, firstTime = 0, lastTime = 0;
+  bool first = true;
+  const uint32_t periodUs = 1000000 / SAMPLE_RATE;
+
+  CaptureLog log;
+  nativeDecodeCapture(data, &log, [&](uint32_t seq, uint32_t time,
+                                      const RawICUData &raw, bool magFresh) {
+    if (first) {
+      firstTime = lastTime = time - periodUs;
+      expectedSeq = seq;
+      first = false;
+    }
+
+    // a capture restarted on the device starts again from 0
+    uint32_t missing = seq > expectedSeq ? seq - expectedSeq : 0;
+    lost += missing;
+    if (time - lastTime > periodUs * 3 / 2 + missing * periodUs)
+      timeGaps++;
+    expectedSeq = seq + 1;
+    lastTime = time;
+
+    acc.add(raw.ax, raw.ay, raw.az);
+    gyro.add(raw.gx, raw.gy, raw.gz);
+    if (magFresh)
+      mag.add(raw.mx, raw.my, raw.mz);
+  });
+
+  for (auto set : sets)
+    fclose(set->file);
+
+  printf("%zu frames, %zu samples over %.1f s\n", log.frames, acc.norm.n,
+         (lastTime - firstTime) / 1e6);
+  printf("%zu samples lost in transit, %zu timestamp gaps on the sensor\n",
+         lost, timeGaps);
+  if (log.corrupt)
+    printf("stopped at byte %zu: not a capture frame\n", log.end);
+  printf("\n");
+
+  for (auto set : sets)
+    set->print();
+
+  return log.corrupt ? 1 : 0;
+}
@@ -0,0 +1,203 @@
+#include "acquisition.h"
+#include "executive.h"
+#include "native.h"
+#include <Arduino.h>
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Releases the rate groups on a virtual clock the way the firmware does: the
+// IMU task hands ACQ_BURST samples to executiveSample() per wake, the
+// telemetry and housekeeping tasks wake on their periods and skip what they
+// missed. Jobs advance the clock by what they cost. One telemetry release
+// runs long, one burst is lost to a stale cycle, one is split into an early
+// wake of 3 samples and a late one of 5, and one stall hands over two bursts
+// at once. Each group has to report exactly the overruns that caused,
+// control has to run once per wake, on its newest sample, with dt spanning
+// the samples since the last release, and the utilization has to match the
+// job costs.
+
+#define SIM_SLOW_AT 1005000 // us, the long telemetry release
+#define SIM_SLOW_US 12000
+#define SIM_LOST_WAKE 100 // the burst lost to a stale cycle
+#define SIM_SPLIT_WAKE 120
+#define SIM_STALL_WAKE 140
+#define SIM_GAPS 3 // control releases two periods after the previous one
+
+static const uint32_t costUs[RATE_GROUP_COUNT] = {200, 1000, 500, 5000};
+
+static uint32_t calibrationRuns = 0, freshSamples = 0;
+static uint32_t controlDts = 0, controlGaps = 0;
+// control on a sample other than the newest of its wake, or twice per wake
+static uint32_t newestStamp, misplaced = 0;
+static bool controlThisWake;
+static bool slowDone = false;
+
+static void spend(uint32_t us) { nativeSetClock(micros() + us); }
+
+static bool runSensor(const RateContext &ctx) {
+  if (!ctx.stale)
+    spend(costUs[GROUP_sensor]);
+  return true;
+}
+
+// deactivates itself, like the calibrations
+static bool runCalibration(const RateContext &ctx) {
+  return ++calibrationRuns < 100;
+}
+
+static bool runControl(const RateContext &ctx) {
+  float period = 1.0f / CONTROL_RATE;
+
+  if (fabsf(ctx.dt - period) < 1e-4f)
+    controlDts++;
+  else if (fabsf(ctx.dt - 2 * period) < 1e-4f)
+    controlGaps++;
+  if (ctx.release != newestStamp || controlThisWake)
+    misplaced++;
+  controlThisWake = true;
+  spend(costUs[GROUP_control]);
+  return true;
+}
+
+static bool runTelemetry(const RateContext &ctx) {
+  bool slow = !slowDone && ctx.release >= SIM_SLOW_AT;
+
+  slowDone |= slow;
+  spend(slow ? SIM_SLOW_US : costUs[GROUP_telemetry]);
+  return true;
+}
+
+static bool runHousekeeping(const RateContext &ctx) {
+  spend(costUs[GROUP_housekeeping]);
+  return true;
+}
+
+static Job sensorJob("sensor", GROUP_sensor, runSensor);
+static Job calibrationJob("calibration", GROUP_sensor, runCalibration);
+static Job controlJob("control", GROUP_control, runControl);
+static Job telemetryJob("telemetry", GROUP_telemetry, runTelemetry);
+static Job housekeepingJob("housekeeping", GROUP_housekeeping,
+                           runHousekeeping);
+
+// Samples produced up to the n-th wake, which comes as the last of them is;
+// the stall wake is the one after a missed wake.
+static int wakeFrames(uint32_t n) {
+  if (n == SIM_SPLIT_WAKE)
+    return 3;
+  if (n == SIM_SPLIT_WAKE + 1)
+    return 2 * ACQ_BURST - 3;
+  if (n == SIM_STALL_WAKE)
+    return 2 * ACQ_BURST;
+  return ACQ_BURST;
+}
+
+static void burst(uint32_t n, uint32_t wake, EstimatorState *state) {
+  const uint32_t sampleUs = 1000000 / SAMPLE_RATE;
+  int frames = wakeFrames(n);
+
+  newestStamp = wake;
+  controlThisWake = false;
+  if (n == SIM_LOST_WAKE) {
+    state->stale = true;
+    executiveSample(*state, true);
+    return;
+  }
+
+  for (int i = 0; i < frames; i++) {
+    uint32_t stamp = wake - (frames - 1 - i) * sampleUs;
+    state->dt = (state->sample ? stamp - state->timestamp : sampleUs) * 1e-6f;
+    state->timestamp = stamp;
+    state->stale = false;
+    state->sample++;
+    freshSamples++;
+    executiveSample(*state, i == frames - 1);
+  }
+}
+
+// like halTaskStart's task: behind by a period or more, it resyncs
+static void clockRelease(RateGroupId id, uint32_t *due) {
+  static uint32_t last[RATE_GROUP_COUNT];
+  uint32_t period = 1000000 / rateGroupRates[id], now = micros();
+  float dt = rateGroupStats[id].releases ? (now - last[id]) * 1e-6f : 0;
+
+  last[id] = now;
+  rateGroupRun(id, {now, dt, false, (uint8_t)(1 << id)});
+  *due += period;
+  if ((int32_t)(micros() - *due) >= (int32_t)period)
+    *due = micros();
+}
+
+int execMain(int argc, char **argv) {
+  int seconds = argc > 0 ? atoi(argv[0]) : 4;
+  if (seconds < 3 || seconds > 3600) {
+    fprintf(stderr, "usage: exec [seconds >= 3]\n");
+    return 1;
+  }
+
+  for (Job *job : {&sensorJob, &calibrationJob, &controlJob, &telemetryJob,
+                   &housekeepingJob}) {
+    executiveAdd(job);
+    job->start();
+  }
+
+  // telemetry and housekeeping off the burst phase, as the tasks would be
+  const uint32_t sampleUs = 1000000 / SAMPLE_RATE;
+  uint32_t wakes = 0, burstDue = wakeFrames(0) * sampleUs;
+  uint32_t telemetryDue = 5000, housekeepingDue = 22000;
+  uint32_t end = seconds * 1000000u;
+  EstimatorState state = {};
+  nativeSetClock(0);
+
+  for (;;) {
+    uint32_t next = std::min({burstDue, telemetryDue, housekeepingDue});
+    if (next >= end)
+      break;
+    if ((int32_t)(next - micros()) > 0)
+      nativeSetClock(next);
+
+    // ties go to the higher priority
+    if (next == burstDue) {
+      burst(wakes, burstDue, &state);
+      burstDue += wakeFrames(++wakes) * sampleUs;
+    } else if (next == telemetryDue) {
+      clockRelease(GROUP_telemetry, &telemetryDue);
+    } else {
+      clockRelease(GROUP_housekeeping, &housekeepingDue);
+    }
+  }
+
+  printf("%d s, %u samples, one slow telemetry release, one lost, one split "
+         "and one stalled burst\n",
+         seconds, freshSamples);
+  printf("%-13s %6s %9s %8s %8s %8s\n", "group", "hz", "releases",
+         "overruns", "max us", "load %");
+
+  float expected[RATE_GROUP_COUNT];
+  bool ok = true;
+  for (int i = 0; i < RATE_GROUP_COUNT; i++) {
+    const RateGroupStats &s = rateGroupStats[i];
+    expected[i] = costUs[i] * rateGroupRates[i] * 1e-4f;
+    printf("%-13s %6u %9u %8u %8u %8.2f (%.2f)\n", rateGroupNames[i],
+           rateGroupRates[i], s.releases, s.overruns, s.maxUs, s.utilization,
+           expected[i]);
+    uint32_t overruns = i == GROUP_housekeeping ? 0
+                        : i == GROUP_control    ? SIM_GAPS
+                                                : 1;
+    ok &= s.overruns == overruns &&
+          fabsf(s.utilization - expected[i]) < 0.3f;
+  }
+
+  printf("control dt %u at %.3f s, %u at twice that, %u not on the newest "
+         "sample of a wake; calibration ran %u times\n",
+         controlDts, 1.0f / CONTROL_RATE, controlGaps, misplaced,
+         calibrationRuns);
+
+  // the split and the stalled burst take one release for two periods each
+  const RateGroupStats &control = rateGroupStats[GROUP_control];
+  ok &= control.releases == freshSamples / CONTROL_DECIMATION - 2 &&
+        controlGaps == SIM_GAPS && controlDts == control.releases - SIM_GAPS &&
+        misplaced == 0 && calibrationRuns == 100;
+  return ok ? 0 : 1;
+}
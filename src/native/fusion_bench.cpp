@@ -0,0 +1,220 @@
+#include "calibration.h"
+#include "filters.h"
+#include "fusion.h"
+#include "native.h"
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define FUSION_CYCLES 1
+#endif
+
+// Compares the fusion.h backends on the same samples: time per update and
+// heading error. Without logs the samples come from the simulated sensors
+// and the truth is simHeading(). Blackbox logs are compared against the yaw
+// the boat recorded, raw captures against the NXP backend. The error skips
+// the first FUSION_SETTLE_S and a constant offset (north is calibrated
+// separately), and is reported as rms, 95th percentile and max in degrees.
+//
+// Timing is fusion.update() alone, on this host: the ESP32-C3 has no FPU,
+// so the ratios between backends matter more than the figures.
+
+#define FUSION_SETTLE_S 5
+
+struct FusionInput {
+  uint32_t timestamp;
+  RawICUData raw;
+  float reference;
+};
+
+struct FusionResult {
+  double ns, cycles;
+  float rms, p95, max;
+};
+
+static volatile float fusionSink;
+
+static void simInputs(float seconds, std::vector<FusionInput> *inputs) {
+  uint8_t mpu[MPU_BURST_LEN], mag[MAG_BURST_LEN];
+  FusionInput input = {};
+
+  for (uint32_t i = 0; i < seconds * SAMPLE_RATE; i++) {
+    float t = (float)i / SAMPLE_RATE;
+    simEncodeMPU(t, mpu);
+    decodeMPU6050(mpu, &input.raw);
+    // HMC5883 at 75 Hz, held in between like imuTask does
+    if (i == 0 || (i * 75 / SAMPLE_RATE) != ((i - 1) * 75 / SAMPLE_RATE)) {
+      simEncodeMag(t, mag);
+      decodeHMC5883(mag, &input.raw);
+    }
+    input.timestamp = i * (1000000 / SAMPLE_RATE);
+    input.reference = simHeading(t);
+    inputs->push_back(input);
+  }
+}
+
+// False when the reference has to come from the NXP backend.
+static bool logInputs(const char *path, std::vector<FusionInput> *inputs,
+                      CalibrationStore *cal) {
+  std::vector<uint8_t> data;
+  if (!nativeReadFile(path, &data))
+    return false;
+
+  BlackboxLog log;
+  bool blackbox = nativeDecodeBlackbox(
+      data, &log, [&](const TelemetrySample &s, uint8_t flags) {
+        if (!(flags & BB_STALE))
+          inputs->push_back(
+              {s.estimator.timestamp, s.estimator.raw, s.estimator.yaw});
+      });
+  if (blackbox) {
+    if (log.hasHeader)
+      *cal = log.header.calibration;
+    return true;
+  }
+
+  CaptureLog capture;
+  nativeDecodeCapture(data, &capture,
+                      [&](uint32_t, uint32_t timestamp, const RawICUData &raw,
+                          bool) { inputs->push_back({timestamp, raw, 0}); });
+  if (capture.corrupt && inputs->empty())
+    fprintf(stderr, "%s: neither a blackbox log nor a capture\n", path);
+  return false;
+}
+
+static void headingError(const std::vector<FusionInput> &inputs,
+                         const std::vector<float> &yaws, FusionResult *r) {
+  uint32_t start = inputs[0].timestamp + FUSION_SETTLE_S * 1000000;
+  double sumSin = 0, sumCos = 0;
+  std::vector<float> errors;
+
+  for (size_t i = 0; i < inputs.size(); i++) {
+    if ((int32_t)(inputs[i].timestamp - start) < 0)
+      continue;
+    float e = wrap180(yaws[i] - inputs[i].reference) * DEG_TO_RAD;
+    sumSin += sin(e);
+    sumCos += cos(e);
+    errors.push_back(e * RAD_TO_DEG);
+  }
+
+  r->rms = r->p95 = r->max = NAN;
+  if (errors.empty())
+    return;
+
+  float offset = atan2(sumSin, sumCos) * RAD_TO_DEG;
+  double sumSq = 0;
+  for (auto &e : errors) {
+    e = fabsf(wrap180(e - offset));
+    sumSq += e * e;
+  }
+  std::sort(errors.begin(), errors.end());
+  r->rms = sqrt(sumSq / errors.size());
+  r->p95 = errors[errors.size() * 95 / 100];
+  r->max = errors.back();
+}
+
+template <typename Filter>
+static FusionResult runBackend(const std::vector<FusionInput> &inputs,
+                               const CalibrationStore &cal, int repeats,
+                               std::vector<float> *yaws) {
+  FusionResult r = {1e30, 1e30};
+  std::vector<CalibratedICUData> cals(inputs.size());
+  for (size_t i = 0; i < inputs.size(); i++)
+    applyCalibration(&inputs[i].raw, &cal, &cals[i]);
+
+  for (int rep = 0; rep < repeats; rep++) {
+    Filter fusion;
+    fusion.begin(SAMPLE_RATE);
+    float sink = 0;
+
+    auto start = std::chrono::steady_clock::now();
+#ifdef FUSION_CYCLES
+    uint64_t cycles = __rdtsc();
+#endif
+    for (auto &c : cals) {
+      fusion.update(c, 1.0f / SAMPLE_RATE);
+      sink += fusion.getYaw();
+    }
+#ifdef FUSION_CYCLES
+    cycles = __rdtsc() - cycles;
+    r.cycles = fmin(r.cycles, (double)cycles / cals.size());
+#endif
+    auto end = std::chrono::steady_clock::now();
+
+    fusionSink = sink;
+    r.ns = fmin(r.ns, std::chrono::duration<double, std::nano>(end - start)
+                              .count() /
+                          cals.size());
+  }
+
+  // same path as imuTask for the heading; not settled on the first sample
+  // like replay, a held gyro rate winds the complementary filter up
+  Filter fusion;
+  fusion.begin(SAMPLE_RATE);
+  EstimatorState state = {};
+  yaws->resize(inputs.size());
+  for (size_t i = 0; i < inputs.size(); i++) {
+    fuseSample(&fusion, &inputs[i].raw, &cal, inputs[i].timestamp, &state);
+    (*yaws)[i] = state.yaw;
+  }
+  return r;
+}
+
+template <typename Filter>
+static void report(const std::vector<FusionInput> &inputs,
+                   const CalibrationStore &cal, int repeats) {
+  std::vector<float> yaws;
+  FusionResult r = runBackend<Filter>(inputs, cal, repeats, &yaws);
+  headingError(inputs, yaws, &r);
+
+  printf("%-14s %9.1f ", Filter::name(), r.ns);
+#ifdef FUSION_CYCLES
+  printf("%9.0f ", r.cycles);
+#else
+  printf("%9s ", "-");
+#endif
+  printf("%8.3f %8.3f %8.3f\n", r.rms, r.p95, r.max);
+}
+
+int fusionMain(int argc, char **argv) {
+  std::vector<FusionInput> inputs;
+  CalibrationStore cal = CalibrationStore();
+  int repeats = 10;
+
+  if (argc > 1) {
+    fprintf(stderr, "usage: fusion [log]\n");
+    return 1;
+  }
+
+  if (argc == 0) {
+    srand(1);
+    simInputs(120, &inputs);
+    printf("simulated, 120 s, reference simHeading\n");
+  } else {
+    bool recorded = logInputs(argv[0], &inputs, &cal);
+    if (inputs.empty()) {
+      fprintf(stderr, "%s: no samples\n", argv[0]);
+      return 1;
+    }
+
+    if (!recorded) {
+      std::vector<float> yaws;
+      runBackend<NXPFusion>(inputs, cal, 1, &yaws);
+      for (size_t i = 0; i < yaws.size(); i++)
+        inputs[i].reference = yaws[i];
+    }
+    printf("%s: %zu samples, reference %s\n", argv[0], inputs.size(),
+           recorded ? "recorded yaw" : NXPFusion::name());
+  }
+
+  printf("%-14s %9s %9s %8s %8s %8s\n", "backend", "ns/upd", "cyc/upd",
+         "rms", "p95", "max");
+  report<NXPFusion>(inputs, cal, repeats);
+  report<MadgwickFusion>(inputs, cal, repeats);
+  report<MahonyFusion>(inputs, cal, repeats);
+  report<ComplementaryFusion>(inputs, cal, repeats);
+  return 0;
+}
@@ -0,0 +1,100 @@
+#include "fusion.h"
+#include "gyro_bias.h"
+#include "native.h"
+#include "pipeline.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+// A day on the water for GyroBiasEstimator: the MPU warms up from 20 to
+// 38 degC while the boat alternates between the dock (still) and runs with
+// turns and wave roll. The true bias follows a linear temperature model; the
+// stored calibration is the one measured at 20 degC. Every five minutes it
+// prints the error of the vertical bias the fusion gets, with the estimator
+// and with the stored calibration alone, as the heading drift that error
+// causes over a 30 s autopilot run.
+
+static const float trueBase[3] = {1.2f, -0.8f, 0.6f}; // dps at 25 degC
+static const float trueSlope[3] = {0.02f, -0.015f, 0.03f};
+
+static float uniform(float amplitude) {
+  return amplitude * (2.0f * rand() / RAND_MAX - 1);
+}
+
+static float trueBias(int axis, float temp) {
+  return trueBase[axis] + trueSlope[axis] * (temp - 25);
+}
+
+int gyrobiasMain(int argc, char **argv) {
+  int minutes = argc > 0 ? atoi(argv[0]) : 60;
+  float gyroNoise = argc > 1 ? atof(argv[1]) : 0.1f;
+  if (minutes <= 0) {
+    fprintf(stderr, "usage: gyrobias [minutes] [gyro noise dps]\n");
+    return 1;
+  }
+
+  srand(1);
+  CalibrationStore cal;
+  GyroTempModel model = {20, {0, 0, 0}};
+  for (int i = 0; i < 3; i++)
+    (&cal.gyroX)[i] = trueBias(i, 20);
+
+  FusionFilter fusion;
+  fusion.begin(SAMPLE_RATE);
+  GyroBiasEstimator estimator;
+  EstimatorState state = {};
+  RawICUData raw = {};
+
+  float heading = 0, turnRate = 0;
+  int fits = 0;
+  printf("%5s %6s %8s %8s %9s %9s\n", "min", "degC", "bias z", "error",
+         "drift 30s", "static");
+
+  for (uint32_t i = 0; i < (uint32_t)minutes * 60 * SAMPLE_RATE; i++) {
+    float t = (float)i / SAMPLE_RATE;
+    float temp = 38 - 18 * expf(-t / 900);
+    bool docked = fmodf(t, 420) < 120; // 2 min at the dock every 7
+
+    if (!docked && fmodf(t, 30) < 1 / (float)SAMPLE_RATE)
+      turnRate = uniform(15);
+    float roll = docked ? 0 : 8 * cosf(2 * PI * 0.4f * t) * 0.4f * 2 * PI;
+    float rate = docked ? 0 : turnRate;
+    heading += rate / SAMPLE_RATE;
+
+    raw.ax = uniform(0.01f);
+    raw.ay = uniform(0.01f);
+    raw.az = 1 + uniform(0.01f);
+    raw.gx = roll + trueBias(0, temp) + uniform(gyroNoise);
+    raw.gy = trueBias(1, temp) + uniform(gyroNoise);
+    raw.gz = rate + trueBias(2, temp) + uniform(gyroNoise);
+    raw.temp = roundf(temp * 340) / 340; // register resolution
+
+    state.magFresh = (i * 75 / SAMPLE_RATE) != ((i + 1) * 75 / SAMPLE_RATE);
+    if (state.magFresh) {
+      float h = heading * DEG_TO_RAD;
+      raw.mx = 20 * cosf(h) + uniform(0.3f);
+      raw.my = -20 * sinf(h) + uniform(0.3f);
+      raw.mz = -40 + uniform(0.3f);
+    }
+
+    fuseSample(&fusion, &raw, &cal, i * (1000000 / SAMPLE_RATE), &state,
+               &estimator, &model);
+    fits += estimator.update(&state, &cal, &model);
+
+    if ((i + 1) % (5 * 60 * SAMPLE_RATE) == 0) {
+      float error = estimator.getBias()[2] - trueBias(2, temp);
+      float stale = trueBias(2, 20) - trueBias(2, temp);
+      printf("%5.0f %6.1f %8.3f %8.3f %8.2f° %8.2f°\n", (t + 1) / 60, temp,
+             estimator.getBias()[2], error, fabsf(error) * 30,
+             fabsf(stale) * 30);
+    }
+  }
+
+  printf("%u still windows, %u heading windows, %d fits\n",
+         estimator.getStillWindows(), estimator.getHeadingWindows(), fits);
+  printf("model at %.1f degC:", model.reference);
+  for (int i = 0; i < 3; i++)
+    printf(" %c %.3f (%.3f) %.4f/degC (%.4f)", 'x' + i, (&cal.gyroX)[i],
+           trueBias(i, model.reference), model.slope[i], trueSlope[i]);
+  printf("\n");
+  return 0;
+}
@@ -0,0 +1,126 @@
+#include "hal.h"
+#include "i2c_engine.h"
+#include "native.h"
+#include "ws_queue.h"
+#include <Arduino.h>
+#include <chrono>
+#include <map>
+#include <thread>
+#include <vector>
+
+static const auto clockStart = std::chrono::steady_clock::now();
+
+static std::map<uint8_t, NativeI2CDevice> i2cDevices;
+static std::map<uint8_t, float> pwmValues;
+static NativeWSSink wsSink;
+static bool busStuck = false;
+static bool virtualClock = false;
+static uint32_t virtualMicros;
+
+uint32_t micros() {
+  if (virtualClock)
+    return virtualMicros;
+
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now() - clockStart)
+      .count();
+}
+
+uint32_t millis() { return micros() / 1000; }
+
+void delay(uint32_t ms) {
+  if (virtualClock) {
+    virtualMicros += ms * 1000;
+    return;
+  }
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void yield() { std::this_thread::yield(); }
+
+bool halI2CBegin() { return true; }
+
+I2CResult halI2CRead(uint8_t addr, uint8_t reg, uint8_t *buf, size_t len,
+                     uint32_t timeoutMs) {
+  if (busStuck)
+    return I2C_TIMEOUT;
+
+  auto device = i2cDevices.find(addr);
+  if (device == i2cDevices.end() || !device->second.read(reg, buf, len))
+    return I2C_NACK;
+
+  return I2C_OK;
+}
+
+I2CResult halI2CWrite(uint8_t addr, uint8_t reg, uint8_t value,
+                      uint32_t timeoutMs) {
+  if (busStuck)
+    return I2C_TIMEOUT;
+
+  auto device = i2cDevices.find(addr);
+  if (device == i2cDevices.end() || !device->second.write(reg, value))
+    return I2C_NACK;
+
+  return I2C_OK;
+}
+
+void halI2CRecover() { busStuck = false; }
+
+// No worker thread on the host: queued transfers run inside the submit call.
+void halI2CEngineKick() { i2cEngineRun(); }
+
+void halI2CEngineWait(uint32_t timeoutMs) {}
+
+bool halPWMBegin(uint8_t channel, uint8_t pin, uint32_t hz) {
+  pwmValues[channel] = 0;
+  return true;
+}
+
+void halPWMWrite(uint8_t channel, float us) { pwmValues[channel] = us; }
+
+bool halTimerStart(uint32_t periodUs, void (*callback)()) { return true; }
+
+bool halTaskStart(const char *name, uint8_t priority, uint32_t periodMs,
+                  void (*run)(void *), void *arg) {
+  return true;
+}
+
+void *halTaskCurrent() {
+  static thread_local char task;
+  return &task;
+}
+
+bool halWSWrite(uint32_t client, const uint8_t *data, size_t len) {
+  return wsSink ? wsSink(client, data, len) : true;
+}
+
+// no server to report the close, do it here
+void halWSClose(uint32_t client) { wsClose(client); }
+
+// the virtual clock only moves in whole microseconds, probes use real time
+uint32_t halCycles() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now() - clockStart)
+      .count();
+}
+
+uint32_t halCyclesPerUs() { return 1000; }
+
+uint32_t halFreeHeap() { return 0; }
+uint32_t halMinFreeHeap() { return 0; }
+
+void nativeAttachI2C(uint8_t addr, NativeI2CDevice device) {
+  i2cDevices[addr] = device;
+}
+
+void nativeStickI2CBus() { busStuck = true; }
+
+float nativePWMValue(uint8_t channel) { return pwmValues[channel]; }
+
+void nativeSetWSSink(NativeWSSink sink) { wsSink = sink; }
+
+void nativeSetClock(uint32_t us) {
+  virtualClock = true;
+  virtualMicros = us;
+}
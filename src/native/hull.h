@@ -0,0 +1,44 @@
+#include "filters.h"
+#include "pipeline.h"
+#include <Arduino.h>
+#include <deque>
+#include <math.h>
+#include <stdlib.h>
+
+#ifndef hull_h
+#define hull_h
+
+// First-order Nomoto steering T r' + r = K delta, heading psi' = r, with
+// servo dead time L and heading noise, stepped once per sample.
+struct Hull {
+  float K, T, L; // dps per servo degree, s, s
+  float noise;   // degrees, uniform
+  float rate = 0, heading = 0;
+  std::deque<float> servo;
+
+  // servo as passed to writeServo(): positive turns towards lower heading
+  float step(float output) {
+    servo.push_back(output);
+    float delayed = servo.front();
+    if (servo.size() > L * SAMPLE_RATE)
+      servo.pop_front();
+
+    float dt = 1.0f / SAMPLE_RATE;
+    rate += (-K * delayed - rate) / T * dt;
+    heading = wrap360(heading + rate * dt);
+    return wrap360(heading + noise * (2.0f * rand() / RAND_MAX - 1));
+  }
+
+  // phase crossover of K e^-Ls / (s (Ts + 1)): atan(wT) + wL = pi / 2
+  void ultimate(float *ku, float *tu) const {
+    float lo = 0, hi = L > 0 ? PI / (2 * L) : 1e3f;
+    for (int i = 0; i < 60; i++) {
+      float w = (lo + hi) / 2;
+      (atanf(w * T) + w * L < PI / 2 ? lo : hi) = w;
+    }
+    *ku = lo * sqrtf(1 + lo * lo * T * T) / K;
+    *tu = 2 * PI / lo;
+  }
+};
+
+#endif
@@ -0,0 +1,102 @@
+#include "native.h"
+#include <stdio.h>
+
+bool nativeReadFile(const char *path, std::vector<uint8_t> *data) {
+  FILE *f = fopen(path, "rb");
+  if (f == NULL) {
+    perror(path);
+    return false;
+  }
+
+  uint8_t chunk[4096];
+  size_t n;
+  while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0)
+    data->insert(data->end(), chunk, chunk + n);
+  fclose(f);
+  return true;
+}
+
+bool nativeDecodeBlackbox(const std::vector<uint8_t> &data, BlackboxLog *log,
+                          BlackboxVisitor visit) {
+  *log = BlackboxLog();
+  if (data.size() < 6 || memcmp(data.data(), BB_MAGIC, 4) != 0)
+    return false;
+
+  size_t headerLen = data[4] | data[5] << 8;
+  size_t pos = 6 + headerLen;
+  if (pos > data.size()) {
+    log->truncated = true;
+    return true;
+  }
+
+  if (headerLen == sizeof(BlackboxHeader)) {
+    memcpy(&log->header, &data[6], sizeof(BlackboxHeader));
+    log->hasHeader = true;
+  }
+
+  while (pos + 2 <= data.size()) {
+    uint16_t len = data[pos] | data[pos + 1] << 8;
+    pos += 2;
+    if (pos + len > data.size()) {
+      log->truncated = true;
+      break;
+    }
+
+    BlackboxCodec codec;
+    blackboxBeginBlock(&codec);
+
+    for (size_t off = 0; off < len;) {
+      TelemetrySample s = {};
+      uint8_t flags;
+      size_t used =
+          blackboxDecode(&codec, &data[pos + off], len - off, &s, &flags);
+      if (used == 0) {
+        log->truncated = true;
+        break;
+      }
+      off += used;
+      log->records++;
+      visit(s, flags);
+    }
+
+    pos += len;
+    log->blocks++;
+  }
+
+  return true;
+}
+
+void nativeDecodeCapture(const std::vector<uint8_t> &data, CaptureLog *log,
+                         CaptureVisitor visit) {
+  *log = {};
+  size_t pos = 0;
+
+  while (pos + CAPTURE_HEADER_LEN <= data.size()) {
+    const uint8_t *frame = &data[pos];
+    uint32_t seq, time;
+    memcpy(&seq, frame + 1, 4);
+    memcpy(&time, frame + 5, 4);
+    uint8_t count = frame[CAPTURE_HEADER_LEN - 1];
+    size_t len = CAPTURE_HEADER_LEN + count * CAPTURE_SAMPLE_LEN;
+
+    if (frame[0] != 0x31 || count > CAPTURE_BATCH ||
+        pos + len > data.size())
+      break;
+
+    for (uint8_t i = 0; i < count; i++) {
+      const uint8_t *s = frame + CAPTURE_HEADER_LEN + i * CAPTURE_SAMPLE_LEN;
+      int16_t counts[9];
+      RawICUData raw;
+      memcpy(counts, s, sizeof(counts));
+      countsToRaw(counts, &raw);
+      visit(seq + i, time + i * (1000000 / SAMPLE_RATE), raw,
+            s[sizeof(counts)] & CAPTURE_MAG_FRESH);
+    }
+
+    pos += len;
+    log->frames++;
+  }
+
+  log->corrupt = pos < data.size();
+  log->end = pos;
+}
@@ -0,0 +1,110 @@
+#include "mag_fit.h"
+#include "native.h"
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+// Feeds magFitSolve() readings of a simulated magnetometer with a known
+// hard-iron offset and soft-iron distortion, rotated through random
+// orientations with gaussian-ish noise, and checks what it recovers: the
+// offset, and that the fitted matrix turns the readings back into a sphere.
+// Also times magScatterAdd() (per reading, on the control task) against a
+// solve (the calibrator task).
+
+static float uniform(float lo, float hi) {
+  return lo + (hi - lo) * rand() / (float)RAND_MAX;
+}
+
+static float noisy(float sigma) {
+  float sum = 0;
+  for (int i = 0; i < 4; i++)
+    sum += uniform(-1, 1);
+  return sum * sigma * 0.866f; // four uniforms, unit variance
+}
+
+int magfitMain(int argc, char **argv) {
+  int count = argc > 0 ? atoi(argv[0]) : 1500;
+  float noise = argc > 1 ? atof(argv[1]) : 0.3f;
+  if (count < MAG_FIT_MIN_POINTS) {
+    fprintf(stderr, "usage: magfit [points >= %d] [noise uT]\n",
+            MAG_FIT_MIN_POINTS);
+    return 1;
+  }
+
+  const float field = 48;
+  const float offset[3] = {-21.5f, 14.2f, 37.8f};
+  const float distortion[3][3] = {
+      {1.08f, 0.04f, -0.03f}, {0.04f, 0.93f, 0.06f}, {-0.03f, 0.06f, 1.01f}};
+
+  srand(1);
+  std::vector<float> readings(count * 3);
+  for (int i = 0; i < count; i++) {
+    float v[3], norm;
+    do {
+      for (float &c : v)
+        c = uniform(-1, 1);
+      norm = sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+    } while (norm > 1 || norm < 1e-3f);
+
+    for (int r = 0; r < 3; r++) {
+      float m = offset[r] + noisy(noise);
+      for (int c = 0; c < 3; c++)
+        m += distortion[r][c] * v[c] / norm * field;
+      readings[i * 3 + r] = m;
+    }
+  }
+
+  MagScatter scatter;
+  magScatterReset(&scatter);
+  for (int i = 0; i < count; i++)
+    magScatterAdd(&scatter, readings[i * 3], readings[i * 3 + 1],
+                  readings[i * 3 + 2]);
+
+  MagFit fit;
+  if (!magFitSolve(&scatter, &fit)) {
+    printf("no fit\n");
+    return 1;
+  }
+
+  printf("%u points, %.2f uT noise\n", fit.points, noise);
+  printf("offset %7.2f %7.2f %7.2f (true %.2f %.2f %.2f)\n", fit.offset[0],
+         fit.offset[1], fit.offset[2], offset[0], offset[1], offset[2]);
+  for (auto &row : fit.scale)
+    printf("scale  %7.4f %7.4f %7.4f\n", row[0], row[1], row[2]);
+  printf("field %.2f uT, fit error %.2f%%\n", fit.fieldStrength, fit.fitError);
+
+  // corrected readings should all have the same magnitude
+  double sum = 0, sumSq = 0;
+  for (int i = 0; i < count; i++) {
+    float *m = &readings[i * 3], c[3];
+    for (int r = 0; r < 3; r++)
+      c[r] = fit.scale[r][0] * (m[0] - fit.offset[0]) +
+             fit.scale[r][1] * (m[1] - fit.offset[1]) +
+             fit.scale[r][2] * (m[2] - fit.offset[2]);
+    double magnitude = sqrt(c[0] * c[0] + c[1] * c[1] + c[2] * c[2]);
+    sum += magnitude;
+    sumSq += magnitude * magnitude;
+  }
+  double mean = sum / count;
+  printf("corrected magnitude %.2f uT, spread %.2f%%\n", mean,
+         100 * sqrt(fmax(sumSq / count - mean * mean, 0)) / mean);
+
+  auto start = std::chrono::steady_clock::now();
+  MagScatter timed;
+  magScatterReset(&timed);
+  for (int r = 0; r < 100; r++)
+    for (int i = 0; i < count; i++)
+      magScatterAdd(&timed, readings[i * 3], readings[i * 3 + 1],
+                    readings[i * 3 + 2]);
+  auto mid = std::chrono::steady_clock::now();
+  for (int r = 0; r < 100; r++)
+    magFitSolve(&scatter, &fit);
+  auto end = std::chrono::steady_clock::now();
+
+  printf("add %.1f ns per reading, solve %.1f us (host)\n",
+         std::chrono::duration<double, std::nano>(mid - start).count() /
+             (100.0 * count),
+         std::chrono::duration<double, std::micro>(end - mid).count() / 100);
+  return 0;
+}
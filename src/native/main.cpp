@@ -0,0 +1,57 @@
+#include "native.h"
+#include <stdio.h>
+#include <string.h>
+
+// Entry point of the native build: `program <command> [args...]`.
+
+struct NativeCommand {
+  const char *name;
+  int (*run)(int argc, char **argv);
+  const char *usage;
+};
+
+static const NativeCommand commands[] = {
+    {"acq", acqMain,
+     "[seconds] [stall ms]  FIFO acquisition against simulated sensors"},
+    {"actuator", actuatorMain,
+     "[control hz]  servo/ESC outputs: arming, slew, range, interpolation"},
+    {"autotune", autotuneMain,
+     "[zn|tl] [amplitude] [dead ms]  relay autotune of a simulated hull"},
+    {"bench", benchMain, "[samples] [repeats]  time each imuTask stage"},
+    {"blackbox", blackboxMain, "<file.bbx>  decode a blackbox log to CSV"},
+    {"capture", captureMain,
+     "<file.cap>  split a raw capture into accel/gyro/mag CSV + stats"},
+    {"exec", execMain,
+     "[seconds]  rate groups: control decimation, overruns, utilization"},
+    {"fusion", fusionMain,
+     "[log]  fusion backends: time per update and heading error"},
+    {"gyrobias", gyrobiasMain,
+     "[minutes] [noise dps]  in-motion gyro bias and temperature model"},
+    {"magfit", magfitMain,
+     "[points] [noise uT]  on-device ellipsoid fit of a simulated sensor"},
+    {"math", mathMain,
+     "[samples] [repeats]  fastmath kernels: error and time vs float"},
+    {"mission", missionMain,
+     "[max speed]  missions against a simulated hull, tracking error"},
+    {"replay", replayMain,
+     "<log>... [kp= ...] | diff <a> <b>  replay logs, compare traces"},
+    {"schema", schemaMain,
+     "> web/src/schema.ts  TypeScript side of the packet schema"},
+    {"stress", stressMain,
+     "[readers] [seconds]  torn estimator snapshots, command ring order"},
+    {"ws", wsMain,
+     "[seconds] [slow ms]  per-client websocket queues with a slow client"},
+};
+
+int main(int argc, char **argv) {
+  if (argc > 1) {
+    for (auto &command : commands)
+      if (strcmp(argv[1], command.name) == 0)
+        return command.run(argc - 2, argv + 2);
+  }
+
+  fprintf(stderr, "usage: %s <command>\n", argv[0]);
+  for (auto &command : commands)
+    fprintf(stderr, "  %-8s %s\n", command.name, command.usage);
+  return 1;
+}
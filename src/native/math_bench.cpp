@@ -0,0 +1,140 @@
+#include "fastmath.h"
+#include "native.h"
+#include "pipeline.h"
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+// Accuracy of the fastmath.h kernels against libm/float, and their time per
+// call next to the float versions they replace. The host has an FPU, so the
+// ratios understate what the ESP32-C3 gains, where every float op is a
+// libgcc call and fmodf/sinf/atan2f cost thousands of cycles.
+
+static volatile float mathSink;
+
+template <typename F> static double timeNs(size_t count, int repeats, F &&fn) {
+  double best = 1e30;
+
+  for (int r = 0; r < repeats; r++) {
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < count; i++)
+      fn(i);
+    auto end = std::chrono::steady_clock::now();
+    best = fmin(best, std::chrono::duration<double, std::nano>(end - start)
+                              .count() /
+                          count);
+  }
+
+  return best;
+}
+
+static float uniform(float lo, float hi) {
+  return lo + (hi - lo) * rand() / (float)RAND_MAX;
+}
+
+static void row(const char *name, double maxErr, const char *unit,
+                double refNs, double fastNs) {
+  printf("%-12s %12.3g %-4s %10.1f %10.1f %8.2fx\n", name, maxErr, unit, refNs,
+         fastNs, refNs / fastNs);
+}
+
+int mathMain(int argc, char **argv) {
+  size_t count = argc > 0 ? strtoul(argv[0], NULL, 10) : 100000;
+  int repeats = argc > 1 ? atoi(argv[1]) : 20;
+  if (count == 0 || repeats <= 0) {
+    fprintf(stderr, "usage: math [samples] [repeats]\n");
+    return 1;
+  }
+
+  srand(1);
+  std::vector<float> angles(count), degs(count), xs(count), ys(count);
+  for (size_t i = 0; i < count; i++) {
+    angles[i] = uniform(-100, 100);
+    degs[i] = uniform(-1000, 1000);
+    float r = uniform(1e-3f, 100);
+    xs[i] = r * cosf(angles[i]);
+    ys[i] = r * sinf(angles[i]);
+  }
+
+  printf("FAST_MATH=%d, %zu samples, ns per call (host)\n", FAST_MATH, count);
+  printf("%-12s %17s %10s %10s %9s\n", "kernel", "max error", "float", "fast",
+         "speedup");
+
+  double err = 0;
+  for (size_t i = 0; i < count; i++)
+    err = fmax(err, fmax(fabs(fastSin(angles[i]) - sin((double)angles[i])),
+                         fabs(fastCos(angles[i]) - cos((double)angles[i]))));
+  row("sin/cos", err, "",
+      timeNs(count, repeats, [&](size_t i) { mathSink = sinf(angles[i]); }),
+      timeNs(count, repeats,
+             [&](size_t i) { mathSink = fastSin(angles[i]); }));
+
+  err = 0;
+  for (size_t i = 0; i < count; i++)
+    err = fmax(err, fabs(remainder(fastAtan2(ys[i], xs[i]) -
+                                       atan2((double)ys[i], (double)xs[i]),
+                                   2 * M_PI)));
+  row("atan2", err, "rad", timeNs(count, repeats, [&](size_t i) {
+        mathSink = atan2f(ys[i], xs[i]);
+      }),
+      timeNs(count, repeats,
+             [&](size_t i) { mathSink = fastAtan2(ys[i], xs[i]); }));
+
+  err = 0;
+  for (size_t i = 0; i < count; i++) {
+    double ref = fmod(fmod((double)degs[i], 360) + 360, 360);
+    err = fmax(err, fabs(remainder(fastWrap360(degs[i]) - ref, 360)));
+    ref = fmod((double)degs[i] + 540 + 360 * 4, 360) - 180;
+    err = fmax(err, fabs(remainder(fastWrap180(degs[i]) - ref, 360)));
+  }
+  row("wrap", err, "deg", timeNs(count, repeats, [&](size_t i) {
+        mathSink = fmodf(degs[i] + 540.0f, 360.0f) - 180.0f;
+      }),
+      timeNs(count, repeats,
+             [&](size_t i) { mathSink = fastWrap180(degs[i]); }));
+
+  // a hard-iron offset and soft-iron matrix like the calibration page fits
+  float offset[3] = {3.1f, -7.4f, 12.0f};
+  float m[3][3] = {
+      {1.02f, 0.01f, -0.02f}, {0.01f, 0.97f, 0.03f}, {-0.02f, 0.03f, 1.05f}};
+  Q16Affine3 q16;
+  q16.set(offset, m);
+
+  std::vector<float> mag(count * 3), out(count * 3);
+  for (auto &v : mag)
+    v = uniform(-100, 100);
+
+  err = 0;
+  for (size_t i = 0; i < count; i++) {
+    float *v = &mag[i * 3], fast[3];
+    q16.apply(v, fast);
+    for (int r = 0; r < 3; r++) {
+      double ref = 0;
+      for (int c = 0; c < 3; c++)
+        ref += (double)m[r][c] * (v[c] - offset[c]);
+      err = fmax(err, fabs(fast[r] - ref));
+    }
+  }
+  row("mag Q16", err, "uT", timeNs(count, repeats, [&](size_t i) {
+        float *v = &mag[i * 3], *o = &out[i * 3];
+        float x = v[0] - offset[0], y = v[1] - offset[1], z = v[2] - offset[2];
+        for (int r = 0; r < 3; r++)
+          o[r] = m[r][0] * x + m[r][1] * y + m[r][2] * z;
+      }),
+      timeNs(count, repeats,
+             [&](size_t i) { q16.apply(&mag[i * 3], &out[i * 3]); }));
+
+  // every gyro reading must still round-trip through rawToCounts()
+  int mismatched = 0, lost = 0;
+  for (int c = -32768; c <= 32767; c++) {
+    float div = c / 32.8f, mul = c * (1.0f / 32.8f);
+    mismatched += div != mul;
+    lost += lroundf(mul * 32.8f) != c;
+  }
+  printf("%-12s %d of 65536 readings differ from the divide by an ulp, %d "
+         "lose their count\n",
+         "gyro scale", mismatched, lost);
+
+  return 0;
+}
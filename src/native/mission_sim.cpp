@@ -0,0 +1,132 @@
+#include "autotune.h"
+#include "executive.h"
+#include "filters.h"
+#include "hull.h"
+#include "mission.h"
+#include "native.h"
+#include "pid.h"
+#include "pipeline.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Runs missions the way the steering job does, against the simulated hull of
+// the autotune command: the executor moves the setpoint, tickPID steers to
+// it, both at CONTROL_RATE while the hull moves every sample.
+// Prints the segment table and how well each leg tracked the setpoint, and
+// fails if a mission does not end on time or the boat misses its last
+// heading.
+
+#define SIM_START_HEADING 300.0f
+
+static bool runMission(const char *name, const MissionPlan &plan,
+                       float maxSpeed, Hull hull) {
+  MissionExecutor mission;
+  setupPID();
+  AutotuneResult gains;
+  float ku, tu;
+  hull.ultimate(&ku, &tu);
+  autotuneGains(TUNE_TYREUS_LUYBEN, ku, tu, &gains);
+  pid.setKp(gains.kp);
+  pid.setKi(gains.ki);
+  pid.setKd(gains.kd);
+
+  hull.heading = SIM_START_HEADING;
+  hull.rate = 0;
+  hull.servo.clear();
+  float yaw = hull.heading, output = 0;
+
+  if (!mission.load(plan, yaw, maxSpeed)) {
+    printf("%s: rejected: %s\n", name, missionValidate(&plan));
+    return false;
+  }
+
+  size_t n;
+  const MissionSegment *segments = mission.getSegments(&n);
+  printf("%s: %u legs, %.1f s, start heading %.0f\n", name,
+         mission.getLegCount(), mission.getDuration(), SIM_START_HEADING);
+  printf("%4s %8s %8s %8s %8s %8s %8s\n", "leg", "start", "end", "heading",
+         "dps", "speed", "%/s");
+  for (size_t i = 0; i < n; i++) {
+    const MissionSegment &s = segments[i];
+    printf("%4u %8.2f %8.2f %8.1f %8.1f %8.1f %8.2f\n", s.leg, s.start * 1e-3f,
+           s.end * 1e-3f, s.heading, s.headingRate * 1e3f, s.speed,
+           s.speedRate * 1e3f);
+  }
+
+  double absSum[MISSION_MAX_LEGS] = {};
+  float maxError[MISSION_MAX_LEGS] = {}, maxUs = 0;
+  uint32_t samples[MISSION_MAX_LEGS] = {};
+  uint32_t timestamp = 0;
+  MissionSetpoint setpoint = {};
+
+  mission.start(timestamp);
+  for (uint32_t i = 1; mission.running(); i++) {
+    timestamp += 1000000 / SAMPLE_RATE;
+    yaw = hull.step(output);
+
+    if (i % CONTROL_DECIMATION == 0) {
+      setpoint = mission.update(timestamp);
+      if (mission.running())
+        maxUs = fmaxf(maxUs, missionMotorUs(setpoint.speed));
+      output = tickPID(setpoint.heading, yaw, 1.0f / CONTROL_RATE);
+    }
+    uint8_t leg = mission.getLeg();
+
+    float error = fabsf(headingError(setpoint.heading, hull.heading));
+    absSum[leg] += error;
+    maxError[leg] = fmaxf(maxError[leg], error);
+    samples[leg]++;
+  }
+
+  printf("%4s %10s %10s\n", "leg", "mean err", "max err");
+  for (int i = 0; i < mission.getLegCount(); i++)
+    printf("%4d %10.2f %10.2f\n", i, samples[i] ? absSum[i] / samples[i] : 0,
+           maxError[i]);
+
+  // a few more seconds holding the final setpoint, as the PID would
+  for (int i = 1; i <= 5 * SAMPLE_RATE; i++) {
+    yaw = hull.step(output);
+    if (i % CONTROL_DECIMATION == 0)
+      output = tickPID(setpoint.heading, yaw, 1.0f / CONTROL_RATE);
+  }
+  float finalError = headingError(setpoint.heading, hull.heading);
+  float ended = timestamp * 1e-6f;
+
+  printf("ended after %.3f s (%s), final heading %.1f (setpoint %.1f), "
+         "motor up to %.0f us\n",
+         ended, mission.getState() == MISSION_DONE ? "done" : "not done",
+         hull.heading, setpoint.heading, maxUs);
+
+  return mission.getState() == MISSION_DONE &&
+         fabsf(ended - mission.getDuration()) <= 1.0f / CONTROL_RATE &&
+         fabsf(finalError) < 2 &&
+         maxUs <= missionMotorUs(maxSpeed) + 0.5f;
+}
+
+int missionMain(int argc, char **argv) {
+  float maxSpeed = argc > 0 ? atof(argv[0]) : 25;
+  if (!(maxSpeed > 0 && maxSpeed <= 100)) {
+    fprintf(stderr, "usage: mission [max speed percent]\n");
+    return 1;
+  }
+
+  srand(1);
+  Hull hull = {0.6f, 1.5f, 0.15f, 0.05f};
+
+  MissionPlan plan;
+  missionDefault(&plan, maxSpeed);
+  bool ok = runMission("default", plan, maxSpeed, hull);
+
+  // through north to an absolute heading, back by a relative one, coast
+  plan = MissionPlan();
+  plan.count = 4;
+  plan.legs[0] = {LEG_HEADING_HOLD, LEG_SPEED_RAMP, 0, 60, 10, 0};
+  plan.legs[1] = {LEG_HEADING_ABSOLUTE, LEG_SPEED_HOLD, 90, 60, 20, 20};
+  plan.legs[2] = {LEG_HEADING_RELATIVE, LEG_SPEED_RAMP, -135, 30, 20, 15};
+  plan.legs[3] = {LEG_HEADING_RELATIVE, LEG_SPEED_COAST, 45, 0, 15, 0};
+  printf("\n");
+  ok &= runMission("legs", plan, maxSpeed, hull);
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,84 @@
+#include "blackbox.h"
+#include "capture.h"
+#include <functional>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#ifndef native_h
+#define native_h
+
+struct NativeI2CDevice {
+  std::function<bool(uint8_t reg, uint8_t *buf, size_t len)> read;
+  std::function<bool(uint8_t reg, uint8_t value)> write;
+};
+// Receives what ws_queue writes to a client; false leaves the frame queued,
+// like a socket with a full send buffer.
+typedef std::function<bool(uint32_t client, const uint8_t *data, size_t len)>
+    NativeWSSink;
+
+void nativeAttachI2C(uint8_t addr, NativeI2CDevice device);
+// Every transfer times out until halI2CRecover() runs, like a slave
+// holding SDA low.
+void nativeStickI2CBus();
+// Last pulse width halPWMWrite() set, us.
+float nativePWMValue(uint8_t channel);
+void nativeSetWSSink(NativeWSSink sink);
+// From the first call on, micros() returns the last value set here and
+// delay() advances it instead of sleeping.
+void nativeSetClock(uint32_t us);
+
+struct BlackboxLog {
+  bool hasHeader; // written by the same sources, header is valid
+  BlackboxHeader header;
+  size_t records, blocks;
+  bool truncated;
+};
+typedef std::function<void(const TelemetrySample &sample, uint8_t flags)>
+    BlackboxVisitor;
+
+struct CaptureLog {
+  size_t frames;
+  bool corrupt; // stopped at byte end, not a capture frame
+  size_t end;
+};
+typedef std::function<void(uint32_t sequence, uint32_t timestamp,
+                           const RawICUData &raw, bool magFresh)>
+    CaptureVisitor;
+
+bool nativeReadFile(const char *path, std::vector<uint8_t> *data);
+// False if data is not a blackbox log.
+bool nativeDecodeBlackbox(const std::vector<uint8_t> &data, BlackboxLog *log,
+                          BlackboxVisitor visit);
+void nativeDecodeCapture(const std::vector<uint8_t> &data, CaptureLog *log,
+                         CaptureVisitor visit);
+
+void simSensorsAttach();
+void simSensorsAdvance(uint32_t us);
+// MPU oscillator frequency relative to nominal, 1 by default.
+void simSetMPUClock(float ratio);
+uint64_t simTime();
+uint32_t simFramesProduced();
+uint32_t simMagSamples();
+float simHeading(float t);
+void simEncodeMPU(float t, uint8_t *buf);
+void simEncodeMag(float t, uint8_t *buf);
+
+int acqMain(int argc, char **argv);
+int actuatorMain(int argc, char **argv);
+int autotuneMain(int argc, char **argv);
+int benchMain(int argc, char **argv);
+int blackboxMain(int argc, char **argv);
+int captureMain(int argc, char **argv);
+int execMain(int argc, char **argv);
+int magfitMain(int argc, char **argv);
+int fusionMain(int argc, char **argv);
+int gyrobiasMain(int argc, char **argv);
+int mathMain(int argc, char **argv);
+int missionMain(int argc, char **argv);
+int replayMain(int argc, char **argv);
+int schemaMain(int argc, char **argv);
+int stressMain(int argc, char **argv);
+int wsMain(int argc, char **argv);
+
+#endif
@@ -0,0 +1,55 @@
+#include <Preferences.h>
+#include <map>
+#include <string.h>
+#include <vector>
+
+static std::map<std::string, std::vector<uint8_t>> store;
+
+bool Preferences::begin(const char *name, bool readOnly,
+                        const char *partition) {
+  this->ns = std::string(name) + "/";
+  this->readOnly = readOnly;
+  return true;
+}
+
+void Preferences::end() { ns.clear(); }
+
+bool Preferences::isKey(const char *key) { return store.count(ns + key) > 0; }
+
+bool Preferences::remove(const char *key) {
+  return !readOnly && store.erase(ns + key) > 0;
+}
+
+size_t Preferences::putFloat(const char *key, float value) {
+  return putBytes(key, &value, sizeof(value));
+}
+
+float Preferences::getFloat(const char *key, float defaultValue) {
+  float value;
+  if (getBytes(key, &value, sizeof(value)) != sizeof(value))
+    return defaultValue;
+  return value;
+}
+
+size_t Preferences::putBytes(const char *key, const void *value, size_t len) {
+  if (readOnly || ns.empty())
+    return 0;
+
+  auto bytes = (const uint8_t *)value;
+  store[ns + key] = std::vector<uint8_t>(bytes, bytes + len);
+  return len;
+}
+
+size_t Preferences::getBytesLength(const char *key) {
+  auto entry = store.find(ns + key);
+  return entry == store.end() ? 0 : entry->second.size();
+}
+
+size_t Preferences::getBytes(const char *key, void *buf, size_t maxLen) {
+  auto entry = store.find(ns + key);
+  if (entry == store.end() || entry->second.size() > maxLen)
+    return 0;
+
+  memcpy(buf, entry->second.data(), entry->second.size());
+  return entry->second.size();
+}
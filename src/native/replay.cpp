@@ -0,0 +1,303 @@
+#include "calibration.h"
+#include "executive.h"
+#include "filters.h"
+#include "fusion.h"
+#include "native.h"
+#include "pid.h"
+#include "pipeline.h"
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+// Runs recorded logs through the imuTask chain (fuseSample) and tickPID on a
+// virtual clock and writes the yaw and servo traces as <log>.<tag>.csv.
+// Blackbox logs start from the calibration and PID state in their header
+// and are compared against what the boat recorded; raw captures use the
+// defaults and only steer when given an anchor. `replay diff` compares the
+// traces of two builds on the same log.
+//
+// The PID runs on the samples the log marks BB_CONTROL, over the time since
+// the previous one, and the servo holds in between; captures get the marks
+// executiveSample() would give them on regular wakes. Logs from before the control group
+// have none and steer on every sample, as they did.
+//
+// Fusion state is not in the log. The estimator is settled first by feeding
+// it the first sample `warmup` times, so yaw matches the recording once the
+// filter has converged rather than from the first record.
+
+struct ReplayInput {
+  uint32_t timestamp;
+  uint8_t flags; // BB_STALE, BB_ANCHORING, BB_CONTROL
+  float anchor;
+  RawICUData raw;
+  bool recorded;
+  float yaw, servo;
+};
+
+struct TraceRow {
+  uint32_t timestamp;
+  bool anchoring;
+  float yaw, servo;
+};
+
+struct TraceDiff {
+  size_t rows;
+  float maxYaw, rmsYaw, maxServo;
+  bool diverged;
+  uint32_t firstDivergence;
+};
+
+struct ReplayOptions {
+  float kp = NAN, ki = NAN, kd = NAN;
+  float anchor = NAN;
+  int warmup = 2000;
+  std::string tag = "replay";
+  float tolerance = 0.01f;
+};
+
+static TraceDiff compareTraces(const std::vector<TraceRow> &a,
+                               const std::vector<TraceRow> &b,
+                               float tolerance) {
+  TraceDiff diff = {};
+  double sumSq = 0;
+
+  for (size_t i = 0; i < a.size() && i < b.size(); i++) {
+    float dy = fabsf(wrap180(a[i].yaw - b[i].yaw));
+    float ds = fabsf(a[i].servo - b[i].servo);
+
+    diff.maxYaw = fmaxf(diff.maxYaw, dy);
+    diff.maxServo = fmaxf(diff.maxServo, ds);
+    sumSq += dy * dy;
+    diff.rows++;
+
+    if (!diff.diverged && (dy > tolerance || ds > tolerance ||
+                           a[i].timestamp != b[i].timestamp)) {
+      diff.diverged = true;
+      diff.firstDivergence = a[i].timestamp;
+    }
+  }
+
+  diff.rmsYaw = diff.rows ? sqrt(sumSq / diff.rows) : 0;
+  diff.diverged |= a.size() != b.size();
+  return diff;
+}
+
+static void printDiff(const TraceDiff &diff) {
+  printf("  yaw max %.3f rms %.3f deg, servo max %.3f deg", diff.maxYaw,
+         diff.rmsYaw, diff.maxServo);
+  if (diff.diverged)
+    printf(", first divergence at %u us", diff.firstDivergence);
+  printf("\n");
+}
+
+static bool readInputs(const char *path, const ReplayOptions &opt,
+                       std::vector<ReplayInput> *inputs, BlackboxLog *log) {
+  std::vector<uint8_t> data;
+  if (!nativeReadFile(path, &data))
+    return false;
+
+  bool blackbox = nativeDecodeBlackbox(
+      data, log, [&](const TelemetrySample &s, uint8_t flags) {
+        inputs->push_back({s.estimator.timestamp, flags, s.yawAnchor,
+                           s.estimator.raw, true, s.estimator.yaw, s.servo});
+      });
+
+  if (!blackbox) {
+    CaptureLog capture;
+    nativeDecodeCapture(data, &capture, [&](uint32_t seq, uint32_t timestamp,
+                                            const RawICUData &raw, bool) {
+      inputs->push_back({timestamp, 0, 0, raw, false, 0, 0});
+    });
+
+    if (capture.corrupt && inputs->empty()) {
+      fprintf(stderr, "%s: neither a blackbox log nor a capture\n", path);
+      return false;
+    }
+
+    for (size_t i = CONTROL_DECIMATION - 1; i < inputs->size();
+         i += CONTROL_DECIMATION)
+      (*inputs)[i].flags |= BB_CONTROL;
+  }
+
+  if (!isnan(opt.anchor)) {
+    for (auto &input : *inputs) {
+      input.flags |= BB_ANCHORING;
+      input.anchor = opt.anchor;
+    }
+  }
+
+  return true;
+}
+
+static bool writeTrace(const std::string &path,
+                       const std::vector<TraceRow> &trace) {
+  FILE *f = fopen(path.c_str(), "w");
+  if (f == NULL) {
+    perror(path.c_str());
+    return false;
+  }
+
+  fprintf(f, "timestamp,anchoring,yaw,servo\n");
+  for (auto &row : trace)
+    fprintf(f, "%u,%d,%.4f,%.4f\n", row.timestamp, row.anchoring ? 1 : 0,
+            row.yaw, row.servo);
+  fclose(f);
+  return true;
+}
+
+static bool readTrace(const char *path, std::vector<TraceRow> *trace) {
+  FILE *f = fopen(path, "r");
+  if (f == NULL) {
+    perror(path);
+    return false;
+  }
+
+  char line[128];
+  while (fgets(line, sizeof(line), f)) {
+    TraceRow row;
+    int anchoring;
+    if (sscanf(line, "%u,%d,%f,%f", &row.timestamp, &anchoring, &row.yaw,
+               &row.servo) != 4)
+      continue; // header
+    row.anchoring = anchoring;
+    trace->push_back(row);
+  }
+
+  fclose(f);
+  return true;
+}
+
+static int replayLog(const char *path, const ReplayOptions &opt) {
+  std::vector<ReplayInput> inputs;
+  BlackboxLog log;
+  if (!readInputs(path, opt, &inputs, &log))
+    return 1;
+  if (inputs.empty()) {
+    fprintf(stderr, "%s: no samples\n", path);
+    return 1;
+  }
+
+  calibration = CalibrationStore();
+  setupPID();
+  if (log.hasHeader) {
+    calibration = log.header.calibration;
+    pid = log.header.pid;
+  }
+  if (!isnan(opt.kp))
+    pid.setKp(opt.kp);
+  if (!isnan(opt.ki))
+    pid.setKi(opt.ki);
+  if (!isnan(opt.kd))
+    pid.setKd(opt.kd);
+
+  std::vector<TraceRow> trace, recorded;
+  trace.reserve(inputs.size());
+  auto start = std::chrono::steady_clock::now();
+
+  FusionFilter fusion;
+  fusion.begin(SAMPLE_RATE);
+  EstimatorState state = {};
+  for (int i = 0; i < opt.warmup; i++)
+    fuseSample(&fusion, &inputs[0].raw, &calibration,
+               inputs[0].timestamp - (opt.warmup - i) * (1000000 / SAMPLE_RATE),
+               &state);
+  state.sample = 0;
+
+  bool everySample = true;
+  for (auto &input : inputs)
+    everySample &= !(input.flags & BB_CONTROL);
+
+  // same order as imuTask -> executiveSample
+  float servo = 0, controlDt = 0;
+  for (auto &input : inputs) {
+    nativeSetClock(input.timestamp);
+
+    bool stale = input.flags & BB_STALE;
+    if (stale)
+      state.stale = true;
+    else
+      fuseSample(&fusion, &input.raw, &calibration, input.timestamp, &state);
+
+    bool anchoring = input.flags & BB_ANCHORING;
+    if (!stale)
+      controlDt += state.dt;
+    if (everySample || input.flags & BB_CONTROL) {
+      float dt = everySample ? (stale ? 0 : state.dt) : controlDt;
+      servo = anchoring ? tickPID(input.anchor, state.yaw, dt) : 0;
+      controlDt = 0;
+    } else if (!anchoring) {
+      servo = 0;
+    }
+    trace.push_back({input.timestamp, anchoring, state.yaw, servo});
+  }
+
+  double wallS = std::chrono::duration<double>(
+                     std::chrono::steady_clock::now() - start)
+                     .count();
+  double logS = (inputs.back().timestamp - inputs.front().timestamp) / 1e6 +
+                1.0 / SAMPLE_RATE;
+
+  printf("%s: %zu samples, %.1f s in %.1f ms (%.0fx realtime)%s\n", path,
+         inputs.size(), logS, wallS * 1e3, logS / wallS,
+         log.hasHeader ? "" : ", default calibration and gains");
+
+  if (inputs[0].recorded) {
+    for (auto &input : inputs)
+      recorded.push_back({input.timestamp, (input.flags & BB_ANCHORING) != 0,
+                          input.yaw, input.servo});
+    printDiff(compareTraces(trace, recorded, opt.tolerance));
+  }
+
+  return writeTrace(std::string(path) + "." + opt.tag + ".csv", trace) ? 0 : 1;
+}
+
+static int diffMain(int argc, char **argv, float tolerance) {
+  std::vector<TraceRow> a, b;
+  if (argc < 2 || !readTrace(argv[0], &a) || !readTrace(argv[1], &b)) {
+    fprintf(stderr, "usage: replay diff <a.csv> <b.csv> [tol=deg]\n");
+    return 2;
+  }
+
+  TraceDiff diff = compareTraces(a, b, tolerance);
+  printf("%zu / %zu rows\n", a.size(), b.size());
+  printDiff(diff);
+  return diff.diverged ? 1 : 0;
+}
+
+int replayMain(int argc, char **argv) {
+  ReplayOptions opt;
+  std::vector<char *> args;
+
+  for (int i = 0; i < argc; i++) {
+    char tag[64];
+    if (sscanf(argv[i], "kp=%f", &opt.kp) == 1 ||
+        sscanf(argv[i], "ki=%f", &opt.ki) == 1 ||
+        sscanf(argv[i], "kd=%f", &opt.kd) == 1 ||
+        sscanf(argv[i], "anchor=%f", &opt.anchor) == 1 ||
+        sscanf(argv[i], "warmup=%d", &opt.warmup) == 1 ||
+        sscanf(argv[i], "tol=%f", &opt.tolerance) == 1)
+      continue;
+    if (sscanf(argv[i], "tag=%63s", tag) == 1) {
+      opt.tag = tag;
+      continue;
+    }
+    args.push_back(argv[i]);
+  }
+
+  if (!args.empty() && strcmp(args[0], "diff") == 0)
+    return diffMain(args.size() - 1, args.data() + 1, opt.tolerance);
+
+  if (args.empty()) {
+    fprintf(stderr, "usage: replay <log>... [kp= ki= kd= anchor= warmup= "
+                    "tag= tol=]\n"
+                    "       replay diff <a.csv> <b.csv> [tol=]\n");
+    return 2;
+  }
+
+  int failed = 0;
+  for (char *path : args)
+    failed += replayLog(path, opt) != 0;
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,159 @@
+#include "native.h"
+#include "packet_schema.h"
+#include "params.h"
+#include <stdio.h>
+
+// Prints the TypeScript side of include/packet_schema.h: builders for
+// incoming packets, parsers for outgoing ones, and the ParamId order of the
+// Params/SetParams values. Regenerate with
+//   .pio/build/native/program schema > web/src/schema.ts
+
+struct SchemaType {
+  const char *ts;     // TypeScript type of one element
+  const char *access; // DataView accessor suffix
+  uint8_t size;
+};
+
+static const SchemaType schemaFloat = {"number", "Float32", 4};
+static const SchemaType schemaUint8 = {"number", "Uint8", 1};
+static const SchemaType schemaUint32 = {"number", "Uint32", 4};
+static const SchemaType schemaBool = {"boolean", "Uint8", 1};
+
+static const SchemaType *schemaType(float *) { return &schemaFloat; }
+static const SchemaType *schemaType(uint8_t *) { return &schemaUint8; }
+static const SchemaType *schemaType(uint32_t *) { return &schemaUint32; }
+static const SchemaType *schemaType(bool *) { return &schemaBool; }
+
+struct SchemaField {
+  const char *name;
+  const SchemaType *type;
+  uint8_t count; // 0 for a scalar
+};
+
+struct SchemaPacket {
+  PacketDirection direction;
+  uint8_t id;
+  const char *name;
+  const SchemaField *fields;
+  size_t fieldCount;
+};
+
+#define SCHEMA_FIELD(type, name) {#name, schemaType((type *)0), 0},
+#define SCHEMA_ARRAY(type, name, n) {#name, schemaType((type *)0), n},
+#define SCHEMA_FIELDS(dir, packetId, Name, fields)                             \
+  static const SchemaField Name##Fields[] = {fields{NULL, NULL, 0}};
+#define SCHEMA_PACKET(dir, packetId, Name, fields)                             \
+  {PACKET_##dir, packetId, #Name, Name##Fields,                                \
+   sizeof(Name##Fields) / sizeof(SchemaField) - 1},
+
+PACKET_SCHEMA(SCHEMA_FIELDS, SCHEMA_FIELD, SCHEMA_ARRAY)
+
+static const SchemaPacket packets[] = {
+    PACKET_SCHEMA(SCHEMA_PACKET, SCHEMA_FIELD, SCHEMA_ARRAY)};
+
+static void printType(const SchemaPacket &packet) {
+  printf("export type %sPacket = {", packet.name);
+  for (size_t i = 0; i < packet.fieldCount; i++) {
+    const SchemaField &field = packet.fields[i];
+    printf("%s %s: %s%s", i ? ";" : "", field.name, field.type->ts,
+           field.count ? "[]" : "");
+  }
+  printf("%s}\n", packet.fieldCount ? " " : "");
+}
+
+static void printBuilder(const SchemaPacket &packet) {
+  size_t size = 0;
+  for (size_t i = 0; i < packet.fieldCount; i++) {
+    const SchemaField &field = packet.fields[i];
+    size += field.type->size * (field.count ? field.count : 1);
+  }
+
+  if (packet.fieldCount)
+    printf("export function build%sPacket(packet: %sPacket) {\n", packet.name,
+           packet.name);
+  else
+    printf("export function build%sPacket() {\n", packet.name);
+
+  printf("  const buffer = new ArrayBuffer(%zu)\n", 1 + size);
+  printf("  const view = new DataView(buffer)\n\n");
+  printf("  view.setUint8(0, PacketId.%s)\n", packet.name);
+
+  size_t offset = 1;
+  for (size_t i = 0; i < packet.fieldCount; i++) {
+    const SchemaField &field = packet.fields[i];
+    const char *le = field.type->size > 1 ? ", true" : "";
+    const char *cast = field.type == &schemaBool ? "+" : "";
+
+    if (field.count)
+      printf("  packet.%s.forEach((n, i) => view.set%s(%zu + i * %u, %sn%s))\n",
+             field.name, field.type->access, offset, field.type->size, cast,
+             le);
+    else
+      printf("  view.set%s(%zu, %spacket.%s%s)\n", field.type->access, offset,
+             cast, field.name, le);
+
+    offset += field.type->size * (field.count ? field.count : 1);
+  }
+
+  printf("\n  return buffer\n}\n");
+}
+
+static void printParser(const SchemaPacket &packet) {
+  printf("export function parse%sPacket(view: DataView): %sPacket {\n",
+         packet.name, packet.name);
+  printf("  return {\n");
+
+  size_t offset = 0;
+  for (size_t i = 0; i < packet.fieldCount; i++) {
+    const SchemaField &field = packet.fields[i];
+    const char *le = field.type->size > 1 ? ", true" : "";
+    const char *cast = field.type == &schemaBool ? "!!" : "";
+
+    if (field.count)
+      printf("    %s: Array.from({ length: %u }, (_, i) => %sview.get%s(%zu + "
+             "i * %u%s)),\n",
+             field.name, field.count, cast, field.type->access, offset,
+             field.type->size, le);
+    else
+      printf("    %s: %sview.get%s(%zu%s),\n", field.name, cast,
+             field.type->access, offset, le);
+
+    offset += field.type->size * (field.count ? field.count : 1);
+  }
+
+  printf("  }\n}\n");
+}
+
+int schemaMain(int argc, char **argv) {
+  printf("// Generated by `program schema` from include/packet_schema.h, do "
+         "not edit.\n\n");
+
+  printf("export const PacketId = {\n");
+  for (auto &packet : packets)
+    printf("  %s: 0x%02x,\n", packet.name, packet.id);
+  printf("} as const\n\n");
+
+#define SCHEMA_PARAM(name, legacy) "  \"" #name "\",\n"
+  printf("export const ParamNames = [\n" PARAM_LIST(SCHEMA_PARAM) "] as const\n");
+#undef SCHEMA_PARAM
+  printf("export const ParamsPerPacket = %d\n", PARAMS_PER_PACKET);
+
+  for (auto &packet : packets) {
+    if (packet.direction == PACKET_IN && packet.fieldCount == 0) {
+      printf("\n");
+      printBuilder(packet);
+      continue;
+    }
+
+    printf("\n");
+    printType(packet);
+    printf("\n");
+
+    if (packet.direction == PACKET_IN)
+      printBuilder(packet);
+    else
+      printParser(packet);
+  }
+
+  return 0;
+}
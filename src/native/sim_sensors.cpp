@@ -0,0 +1,179 @@
+#include "acquisition.h"
+#include "native.h"
+#include <deque>
+#include <stdlib.h>
+
+// Register-level MPU6050 + HMC5883 on the native I2C bus. Only the registers
+// the firmware touches are modelled: sample rate, DLPF, FIFO enable/reset,
+// FIFO count/data, the 0x3B data burst and the HMC5883 data output rate.
+
+#define MPU_SMPLRT_DIV 0x19
+#define MPU_CONFIG 0x1A
+#define MPU_FIFO_EN 0x23
+#define MPU_DATA 0x3B
+#define MPU_USER_CTRL 0x6A
+#define MPU_FIFO_COUNTH 0x72
+#define MPU_FIFO_COUNTL 0x73
+#define MPU_FIFO_R_W 0x74
+#define MPU_WHO_AM_I 0x75
+#define MPU_FIFO_SIZE 1024
+
+#define HMC_CONFIG_A 0x00
+#define HMC_DATA 0x03
+#define HMC_STATUS 0x09
+
+static uint8_t mpuRegs[128];
+static uint8_t hmcRegs[13];
+static std::deque<uint8_t> mpuFifo;
+
+static uint64_t simTimeUs = 0;
+static uint64_t nextFrameUs = 0;
+static uint64_t nextMagUs = 0;
+static uint32_t framesProduced = 0;
+static uint32_t magSamples = 0;
+static float mpuClock = 1;
+
+static void putBE(uint8_t *buf, float value) {
+  int16_t v = (int16_t)fmaxf(-32768.0f, fminf(32767.0f, roundf(value)));
+  buf[0] = (uint16_t)v >> 8;
+  buf[1] = (uint16_t)v & 0xff;
+}
+
+static float noise(float amplitude) {
+  return amplitude * ((float)rand() / RAND_MAX * 2.0f - 1.0f);
+}
+
+// Slow +-40 deg swing around north with a 3 Hz, 3 deg wobble on top, roughly
+// what the hull does in chop.
+float simHeading(float t) {
+  return 40.0f * sinf(0.2f * t) + 3.0f * sinf(2.0f * PI * 3.0f * t);
+}
+
+static float simYawRate(float t) {
+  return 40.0f * 0.2f * cosf(0.2f * t) +
+         3.0f * 2.0f * PI * 3.0f * cosf(2.0f * PI * 3.0f * t);
+}
+
+void simEncodeMPU(float t, uint8_t *buf) {
+  putBE(buf + 0, noise(0.02f) * 4096.0f);
+  putBE(buf + 2, noise(0.02f) * 4096.0f);
+  putBE(buf + 4, (1.0f + noise(0.02f)) * 4096.0f);
+  putBE(buf + 6, (25.0f - 36.53f) * 340.0f); // 25 C
+  putBE(buf + 8, noise(0.5f) * 32.8f);
+  putBE(buf + 10, noise(0.5f) * 32.8f);
+  putBE(buf + 12, (simYawRate(t) + noise(0.5f)) * 32.8f);
+}
+
+void simEncodeMag(float t, uint8_t *buf) {
+  float heading = simHeading(t) * DEG_TO_RAD;
+
+  putBE(buf + 0, (20.0f * cosf(heading) + noise(0.3f)) / 0.0909090909f);
+  putBE(buf + 2, (-40.0f + noise(0.3f)) / 0.0909090909f);
+  putBE(buf + 4, (-20.0f * sinf(heading) + noise(0.3f)) / 0.1020408163f);
+}
+
+static uint32_t mpuFramePeriodUs() {
+  uint32_t gyroRate = (mpuRegs[MPU_CONFIG] & 7) ? 1000 : 8000;
+  return 1000000 / gyroRate * (1 + mpuRegs[MPU_SMPLRT_DIV]);
+}
+
+static uint32_t hmcPeriodUs() {
+  static const uint32_t periods[8] = {1333333, 666667, 333333, 133333,
+                                      66667,   33333,  13333,  4545};
+  return periods[(hmcRegs[HMC_CONFIG_A] >> 2) & 7];
+}
+
+static bool mpuRead(uint8_t reg, uint8_t *buf, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    if (reg == MPU_FIFO_R_W) {
+      buf[i] = mpuFifo.empty() ? 0 : mpuFifo.front();
+      if (!mpuFifo.empty())
+        mpuFifo.pop_front();
+      continue;
+    }
+
+    uint8_t r = reg + i;
+    if (r == MPU_FIFO_COUNTH)
+      buf[i] = mpuFifo.size() >> 8;
+    else if (r == MPU_FIFO_COUNTL)
+      buf[i] = mpuFifo.size() & 0xff;
+    else if (r == MPU_WHO_AM_I)
+      buf[i] = MPU6050_ADDR;
+    else
+      buf[i] = mpuRegs[r & 0x7f];
+  }
+  return true;
+}
+
+static bool mpuWrite(uint8_t reg, uint8_t value) {
+  mpuRegs[reg & 0x7f] = value;
+
+  if (reg == MPU_USER_CTRL && (value & 0x04)) {
+    mpuFifo.clear();
+    mpuRegs[MPU_USER_CTRL] &= ~0x04;
+  }
+  return true;
+}
+
+static bool hmcRead(uint8_t reg, uint8_t *buf, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    uint8_t r = reg + i;
+    buf[i] = r < sizeof(hmcRegs) ? hmcRegs[r] : 0;
+    if (r == HMC_DATA + 5)
+      hmcRegs[HMC_STATUS] &= ~0x01;
+  }
+  return true;
+}
+
+static bool hmcWrite(uint8_t reg, uint8_t value) {
+  if (reg < 3)
+    hmcRegs[reg] = value;
+  return true;
+}
+
+void simSensorsAttach() {
+  memset(mpuRegs, 0, sizeof(mpuRegs));
+  memset(hmcRegs, 0, sizeof(hmcRegs));
+  mpuRegs[0x6B] = 0x40; // sleeping after reset
+  hmcRegs[HMC_CONFIG_A] = 0x10;
+  hmcRegs[0x0A] = 'H';
+  hmcRegs[0x0B] = '4';
+  hmcRegs[0x0C] = '3';
+  mpuFifo.clear();
+  simTimeUs = nextFrameUs = nextMagUs = 0;
+  framesProduced = magSamples = 0;
+
+  nativeAttachI2C(MPU6050_ADDR, {mpuRead, mpuWrite});
+  nativeAttachI2C(HMC5883_ADDR, {hmcRead, hmcWrite});
+}
+
+void simSensorsAdvance(uint32_t us) {
+  simTimeUs += us;
+
+  while (nextFrameUs <= simTimeUs) {
+    uint8_t frame[MPU_BURST_LEN];
+    simEncodeMPU(nextFrameUs / 1e6f, frame);
+    memcpy(mpuRegs + MPU_DATA, frame, MPU_BURST_LEN);
+
+    if ((mpuRegs[MPU_USER_CTRL] & 0x40) && mpuRegs[MPU_FIFO_EN] == 0xF8) {
+      mpuFifo.insert(mpuFifo.end(), frame, frame + MPU_BURST_LEN);
+      while (mpuFifo.size() > MPU_FIFO_SIZE)
+        mpuFifo.pop_front();
+    }
+
+    framesProduced++;
+    nextFrameUs += lroundf(mpuFramePeriodUs() / mpuClock);
+  }
+
+  while (nextMagUs <= simTimeUs) {
+    simEncodeMag(nextMagUs / 1e6f, hmcRegs + HMC_DATA);
+    hmcRegs[HMC_STATUS] |= 0x01;
+    magSamples++;
+    nextMagUs += hmcPeriodUs();
+  }
+}
+
+void simSetMPUClock(float ratio) { mpuClock = ratio; }
+uint64_t simTime() { return simTimeUs; }
+uint32_t simFramesProduced() { return framesProduced; }
+uint32_t simMagSamples() { return magSamples; }
@@ -0,0 +1,137 @@
+#include "native.h"
+#include "pipeline.h"
+#include "seqlock.h"
+#include "spsc_ring.h"
+#include <atomic>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include <vector>
+
+static SeqLock<EstimatorState> stressState;
+
+// Every field of sample n carries n, so a snapshot mixing two writes shows up
+// as a field that disagrees with the sample counter.
+static EstimatorState makeState(uint32_t n) {
+  EstimatorState state;
+  float v = (float)(n % 1000000);
+  float *fields = &state.yaw;
+  size_t count = (sizeof(EstimatorState) - offsetof(EstimatorState, yaw)) /
+                 sizeof(float);
+
+  state.timestamp = n;
+  state.sample = n;
+  for (size_t i = 0; i < count; i++)
+    fields[i] = v;
+  return state;
+}
+
+static bool isConsistent(const EstimatorState &state) {
+  float v = (float)(state.sample % 1000000);
+  const float *fields = &state.yaw;
+  size_t count = (sizeof(EstimatorState) - offsetof(EstimatorState, yaw)) /
+                 sizeof(float);
+
+  if (state.timestamp != state.sample)
+    return false;
+  for (size_t i = 0; i < count; i++)
+    if (fields[i] != v)
+      return false;
+  return true;
+}
+
+static SPSCRing<uint64_t, 16> stressRing;
+
+// One producer, one consumer; every value has to come out exactly once and
+// in order. Returns the number of values that did not.
+static uint64_t stressRingOrder(int seconds, uint64_t *pushed) {
+  std::atomic<bool> running{true};
+  uint64_t errors = 0;
+
+  std::thread consumer([&] {
+    uint64_t expected = 0, value;
+
+    while (running.load(std::memory_order_relaxed) || stressRing.size()) {
+      if (!stressRing.pop(&value)) {
+        std::this_thread::yield();
+        continue;
+      }
+      if (value != expected)
+        errors++;
+      expected = value + 1;
+    }
+  });
+
+  uint64_t n = 0;
+  auto end = std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
+  while (std::chrono::steady_clock::now() < end) {
+    for (int i = 0; i < 1000; i++) {
+      if (stressRing.push(n))
+        n++;
+      else
+        std::this_thread::yield();
+    }
+  }
+
+  running = false;
+  consumer.join();
+  *pushed = n;
+  return errors;
+}
+
+int stressMain(int argc, char **argv) {
+  int readers = argc > 0 ? atoi(argv[0]) : 4;
+  int seconds = argc > 1 ? atoi(argv[1]) : 5;
+  if (readers <= 0 || seconds <= 0) {
+    fprintf(stderr, "usage: stress [readers] [seconds]\n");
+    return 1;
+  }
+
+  std::atomic<bool> running{true};
+  std::atomic<uint64_t> reads{0}, torn{0}, backwards{0};
+  uint32_t writes = 0;
+
+  std::vector<std::thread> threads;
+  for (int r = 0; r < readers; r++) {
+    threads.emplace_back([&] {
+      uint64_t localReads = 0, localTorn = 0, localBackwards = 0;
+      uint32_t last = 0;
+
+      while (running.load(std::memory_order_relaxed)) {
+        auto state = stressState.read();
+        localReads++;
+        if (!isConsistent(state))
+          localTorn++;
+        if (state.sample < last)
+          localBackwards++;
+        last = state.sample;
+      }
+
+      reads += localReads;
+      torn += localTorn;
+      backwards += localBackwards;
+    });
+  }
+
+  auto end = std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
+  while (std::chrono::steady_clock::now() < end) {
+    for (int i = 0; i < 1000; i++)
+      stressState.write(makeState(++writes));
+  }
+
+  running = false;
+  for (auto &thread : threads)
+    thread.join();
+
+  printf("%u writes, %llu reads by %d readers: %llu torn, %llu out of order\n",
+         writes, (unsigned long long)reads.load(), readers,
+         (unsigned long long)torn.load(), (unsigned long long)backwards.load());
+
+  uint64_t pushed;
+  uint64_t misordered = stressRingOrder(seconds, &pushed);
+  printf("%llu packets through the command ring: %llu lost or out of order\n",
+         (unsigned long long)pushed, (unsigned long long)misordered);
+
+  return torn == 0 && backwards == 0 && misordered == 0 ? 0 : 1;
+}
@@ -0,0 +1,167 @@
+#include "native.h"
+#include "packets.h"
+#include "telemetry.h"
+#include "ws_queue.h"
+#include <atomic>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+
+// Three browsers on the outgoing queues for a while of loop() traffic:
+// telemetry every 10 ms, stats every second and an ack (YawAnchor carrying
+// a sequence number) every 100 ms. The control page takes everything, the
+// calibration page one frame per slow ms and the third one stops reading
+// after a second. The acks come from a thread of their own through the
+// handoff ring, as the IMU task's frames do. Acks have to reach the first
+// two complete and in order, telemetry in order, and the stalled one has to
+// be closed without holding more than its queue.
+
+#define SIM_STEP_US 10000
+#define SIM_ACK_US 100000
+#define SIM_STALL_US 1000000
+
+struct SimClient {
+  const char *name;
+  uint32_t id;
+  uint32_t interval; // us per frame it reads, 0 for no limit
+  uint32_t nextRead;
+  uint32_t telemetry, acks, stats, disorder;
+  uint32_t lastTimestamp, maxBytes;
+  float lastAck;
+};
+
+int wsMain(int argc, char **argv) {
+  int seconds = argc > 0 ? atoi(argv[0]) : 10;
+  int slowMs = argc > 1 ? atoi(argv[1]) : 100;
+  if (seconds <= 0 || slowMs <= 0) {
+    fprintf(stderr, "usage: ws [seconds] [slow ms per frame]\n");
+    return 1;
+  }
+
+  SimClient clients[] = {
+      {"control", 1, 0},
+      {"calibration", 2, (uint32_t)slowMs * 1000},
+      {"stalled", 3, 0},
+  };
+  uint32_t now = 0;
+
+  for (auto &c : clients) {
+    c.lastAck = -1;
+    wsOpen(c.id);
+  }
+
+  const uint8_t control[] = {2, 2, 2, 2, 0, 0};
+  const uint8_t calibration[] = {10, 0, 0, 0, 10, 0};
+  wsSubscribe(1, WS_STREAM_STATS | WS_STREAM_AUTOTUNE, control, 6);
+  wsSubscribe(2, WS_STREAM_CALIBRATION | WS_STREAM_CAPTURE, calibration, 6);
+  wsSubscribe(3, WS_STREAM_STATS | WS_STREAM_AUTOTUNE, control, 6);
+
+  nativeSetWSSink([&](uint32_t id, const uint8_t *data, size_t len) {
+    SimClient &c = clients[id - 1];
+
+    if (c.id == 3 && now >= SIM_STALL_US)
+      return false;
+    if (c.interval) {
+      if (now < c.nextRead)
+        return false;
+      c.nextRead = now + c.interval;
+    }
+
+    if (data[0] == 0x20) {
+      uint32_t timestamp;
+      memcpy(&timestamp, data + 1, 4);
+      if (c.telemetry && timestamp <= c.lastTimestamp)
+        c.disorder++;
+      c.lastTimestamp = timestamp;
+      c.telemetry++;
+    } else if (data[0] == YawAnchorPacket::id) {
+      YawAnchorPacket packet;
+      decodePacket(data + 1, &packet);
+      if (packet.yaw != c.lastAck + 1)
+        c.disorder++;
+      c.lastAck = packet.yaw;
+      c.acks++;
+    } else if (data[0] == StatsPacket::id) {
+      c.stats++;
+    }
+    return true;
+  });
+
+  uint32_t acksSent = 0;
+  TelemetrySample sample = {};
+
+  // -1 when idle, otherwise the sequence number to send
+  std::atomic<int> ackRequest{-1};
+  std::atomic<bool> done{false};
+  std::thread imu([&] {
+    wsUseHandoff();
+    while (!done) {
+      int sequence = ackRequest.load();
+      if (sequence < 0) {
+        std::this_thread::yield();
+        continue;
+      }
+      sendPacket(YawAnchorPacket{(float)sequence});
+      ackRequest = -1;
+    }
+  });
+
+  for (; now < (uint32_t)seconds * 1000000; now += SIM_STEP_US) {
+    uint16_t masks[WS_MAX_CLIENTS];
+
+    sample.estimator.timestamp = now;
+    if (nextTelemetryMasks(masks))
+      sendTelemetry(masks, &sample);
+
+    if (now % SIM_ACK_US == 0) {
+      ackRequest = acksSent++;
+      while (ackRequest >= 0)
+        std::this_thread::yield();
+    }
+    if (now % 1000000 == 0)
+      sendPacket(StatsPacket{}, WS_LATEST, WS_STREAM_STATS);
+
+    for (int i = 0; i < WS_MAX_CLIENTS; i++)
+      for (auto &c : clients)
+        if (wsClientStats[i].id == c.id && wsClientStats[i].bytes > c.maxBytes)
+          c.maxBytes = wsClientStats[i].bytes;
+
+    wsPump();
+  }
+
+  done = true;
+  imu.join();
+
+  // what the slow page still has queued, without new traffic
+  for (int i = 0; i < 1000; i++, now += SIM_STEP_US)
+    wsPump();
+
+  printf("%u frames built, %u acks sent, %u dropped, %u clients closed\n",
+         wsStats.frames, acksSent, wsStats.dropped, wsStats.closed);
+  printf("%-12s %6s %9s %5s %5s %9s %8s %7s\n", "client", "open", "telemetry",
+         "acks", "stats", "disorder", "dropped", "bytes");
+
+  bool ok = true;
+  for (int n = 0; n < 3; n++) {
+    SimClient &c = clients[n];
+    const WSClientStats *s = NULL;
+    for (int i = 0; i < WS_MAX_CLIENTS; i++)
+      if (wsClientStats[i].id == c.id)
+        s = &wsClientStats[i];
+
+    char dropped[12] = "-";
+    if (s)
+      snprintf(dropped, sizeof(dropped), "%u", s->dropped);
+    printf("%-12s %6s %9u %5u %5u %9u %8s %7u\n", c.name, s ? "yes" : "closed",
+           c.telemetry, c.acks, c.stats, c.disorder, dropped, c.maxBytes);
+
+    ok &= c.disorder == 0 && c.maxBytes <= WS_QUEUE_BYTES;
+    if (c.id == 3)
+      ok &= s == NULL;
+    else
+      ok &= s != NULL && c.acks == acksSent;
+  }
+
+  return ok ? 0 : 1;
+}
@@ -1,110 +1,128 @@
 #include "packets.h"
+#include "spsc_ring.h"
 
-void sendMessagePacket(String str) {
-  auto buf = ws.makeBuffer(1 + str.length());
-  uint8_t *p = buf->get();
+struct PacketRoute {
+  PacketThunk thunk;
+  PacketCallback handler;
+  uint16_t len;
+  bool coalesce;
+};
 
-  p[0] = 0xbb;
-  memcpy(p + 1, str.c_str(), str.length());
-
-  ws.binaryAll(buf);
-}
+struct QueuedPacket {
+  uint8_t len;
+  uint8_t data[PACKET_MAX_LEN];
+};
 
-void sendInitPacket(float kp, float ki, float kd) {
-  auto buf = ws.makeBuffer(1 + 3 * 4);
-  uint8_t *p = buf->get();
+PacketQueueStats packetQueueStats;
 
-  p[0] = 0x01;
-  memcpy(p + 1, &kp, 4);
-  memcpy(p + 1 + 4, &ki, 4);
-  memcpy(p + 1 + 2 * 4, &kd, 4);
+static PacketRoute routes[256];
+static SPSCRing<QueuedPacket, PACKET_QUEUE_LEN> queue;
 
-  ws.binaryAll(buf);
+void routePacket(uint8_t id, size_t len, PacketThunk thunk,
+                 PacketCallback handler, bool coalesce) {
+  routes[id] = {thunk, handler, (uint16_t)len, coalesce};
 }
 
-void sendAnchoringPacket(bool *anchoring) {
-  auto buf = ws.makeBuffer(1 + sizeof(bool));
-  uint8_t *p = buf->get();
+static const PacketRoute *findRoute(const uint8_t *frame, size_t len) {
+  if (len == 0)
+    return NULL;
 
-  p[0] = 0x0a;
-  memcpy(p + 1, anchoring, sizeof(bool));
+  const PacketRoute *route = &routes[frame[0]];
+  if (route->thunk == NULL || route->len != len - 1)
+    return NULL;
 
-  ws.binaryAll(buf);
+  return route;
 }
 
-void sendRotationPacket(float yaw) {
-  auto buf = ws.makeBuffer(1 + sizeof(yaw));
-  uint8_t *p = buf->get();
+bool dispatchPacket(const uint8_t *frame, size_t len) {
+  const PacketRoute *route = findRoute(frame, len);
+  if (route == NULL)
+    return false;
 
-  p[0] = 0x10;
-  memcpy(p + 1, &yaw, sizeof(yaw));
-
-  ws.binaryAll(buf);
+  route->thunk(frame + 1, route->handler);
+  return true;
 }
 
-void sendYawAnchorPacket(float yaw) {
-  auto buf = ws.makeBuffer(1 + sizeof(yaw));
-  uint8_t *p = buf->get();
-
-  p[0] = 0x11;
-  memcpy(p + 1, &yaw, sizeof(yaw));
+bool queuePacket(const uint8_t *frame, size_t len) {
+  if (findRoute(frame, len) == NULL)
+    return false;
 
-  ws.binaryAll(buf);
-}
+  QueuedPacket packet;
+  packet.len = len;
+  memcpy(packet.data, frame, len);
 
-void sendMagPointPacket(float mx, float my, float mz) {
-  auto buf = ws.makeBuffer(1 + 4 * 3);
-  uint8_t *p = buf->get();
+  if (!queue.push(packet)) {
+    packetQueueStats.dropped++;
+    return true;
+  }
 
-  p[0] = 0xc0;
-  memcpy(p + 1, &mx, 4);
-  memcpy(p + 5, &my, 4);
-  memcpy(p + 9, &mz, 4);
-
-  ws.binaryAll(buf);
+  packetQueueStats.queued++;
+  uint32_t depth = queue.size();
+  if (depth > packetQueueStats.maxDepth)
+    packetQueueStats.maxDepth = depth;
+  return true;
 }
 
-void sendGyroCalibrationProgressPacket(float percentage) {
-  auto buf = ws.makeBuffer(1 + 4);
-  uint8_t *p = buf->get();
+void applyQueuedPackets() {
+  QueuedPacket packet;
 
-  p[0] = 0xc2;
-  memcpy(p + 1, &percentage, 4);
+  // bounded, so a flood cannot stretch one control cycle
+  for (int i = 0; i < PACKET_QUEUE_LEN && queue.pop(&packet); i++) {
+    const QueuedPacket *next = queue.peek();
 
-  ws.binaryAll(buf);
-}
+    if (next != NULL && next->data[0] == packet.data[0] &&
+        routes[packet.data[0]].coalesce) {
+      packetQueueStats.coalesced++;
+      continue;
+    }
 
-void sendAccelCalibrationProgressPacket(uint8_t axis, float percentage) {
-  auto buf = ws.makeBuffer(1 + 4 + 1);
-  uint8_t *p = buf->get();
-
-  p[0] = 0xc6;
-  memcpy(p + 1, &percentage, 4);
-  memcpy(p + 5, &axis, 1);
-
-  ws.binaryAll(buf);
+    dispatchPacket(packet.data, packet.len);
+    packetQueueStats.applied++;
+  }
 }
 
-void sendAccelCalibrationDataPacket(uint8_t axis, float ax, float ay,
-                                    float az) {
-  auto buf = ws.makeBuffer(1 + 4 * 3 + 1);
-  uint8_t *p = buf->get();
+size_t packetQueueDepth() { return queue.size(); }
 
-  p[0] = 0xc7;
-  memcpy(p + 1, &axis, 1);
-  memcpy(p + 2, &ax, 4);
-  memcpy(p + 6, &ay, 4);
-  memcpy(p + 10, &az, 4);
+void sendMessagePacket(String str) {
+  auto frame = wsFrame(1 + str.length());
+  uint8_t *p = frame.data;
+  if (p == NULL)
+    return;
 
-  ws.binaryAll(buf);
-}
+  p[0] = 0xbb;
+  memcpy(p + 1, str.c_str(), str.length());
 
-void sendCalibrationDataPacket(CalibrationStore *cal) {
-  auto buf = ws.makeBuffer(1 + sizeof(CalibrationStore));
-  uint8_t *p = buf->get();
+  wsSend(frame, WS_RELIABLE, wsSubscribers(0));
+}
 
-  p[0] = 0xa0;
-  memcpy(p + 1, cal, sizeof(CalibrationStore));
+void sendCalibrationPacket(const CalibrationStore *cal) {
+  CalibrationPacket packet = {
+      {cal->gyroX, cal->gyroY, cal->gyroZ},
+      {cal->accelX, cal->accelY, cal->accelZ},
+      {cal->magX, cal->magY, cal->magZ},
+      {},
+      cal->north,
+      cal->servoMiddle,
+      cal->maxAPSpeed,
+  };
+  memcpy(packet.magScale, cal->magScale, sizeof(packet.magScale));
+
+  sendPacket(packet);
+}
 
-  ws.binaryAll(buf);
-}
\ No newline at end of file
+void storeCalibrationPacket(const SetCalibrationPacket &packet,
+                            CalibrationStore *cal) {
+  cal->gyroX = packet.gyro[0];
+  cal->gyroY = packet.gyro[1];
+  cal->gyroZ = packet.gyro[2];
+  cal->accelX = packet.accel[0];
+  cal->accelY = packet.accel[1];
+  cal->accelZ = packet.accel[2];
+  cal->magX = packet.mag[0];
+  cal->magY = packet.mag[1];
+  cal->magZ = packet.mag[2];
+  memcpy(cal->magScale, packet.magScale, sizeof(cal->magScale));
+  cal->north = packet.north;
+  cal->servoMiddle = packet.servoMiddle;
+  cal->maxAPSpeed = packet.maxAPSpeed;
+}
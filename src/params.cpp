@@ -0,0 +1,224 @@
+#include "params.h"
+#include "pid.h"
+#include "seqlock.h"
+#include <Preferences.h>
+
+#define PARAMS_MAGIC 0x4d524150 // "PARM"
+#define MISSION_MAGIC 0x4e53494d // "MISN"
+#define MISSION_KEY "mission"
+
+// Both slots hold a whole blob; saves alternate between them, so a reset
+// during a write leaves the other one intact. The higher sequence wins.
+struct ParamBlob {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t size; // of values, smaller for a blob saved by older firmware
+  uint32_t sequence;
+  ParamValues values;
+  uint32_t crc; // of everything above, right after values[size]
+};
+
+static_assert(offsetof(ParamBlob, crc) ==
+                  offsetof(ParamBlob, values) + sizeof(ParamValues),
+              "ParamBlob must be packed");
+
+// Written whole and rarely, a single slot is enough: a torn write fails the
+// CRC and the boat falls back to the default run.
+struct MissionBlob {
+  uint32_t magic;
+  uint32_t crc; // of plan
+  MissionPlan plan;
+};
+
+static const char *const slotKeys[2] = {"a", "b"};
+
+ParamsStats paramsStats;
+MissionPlan missionPlan;
+
+static Preferences prefs;
+static SeqLock<ParamValues> published; // control -> writer
+static SeqLock<MissionPlan> publishedMission;
+static std::atomic<uint32_t> lastChange{0};
+static TaskHandle_t writerTaskHandle = NULL;
+
+static uint32_t crc32(const uint8_t *data, size_t len) {
+  uint32_t crc = 0xffffffff;
+  while (len--) {
+    crc ^= *data++;
+    for (int i = 0; i < 8; i++)
+      crc = crc >> 1 ^ (0xedb88320 & -(crc & 1));
+  }
+  return ~crc;
+}
+
+static size_t blobLength(const ParamBlob *blob) {
+  return offsetof(ParamBlob, values) + blob->size + sizeof(uint32_t);
+}
+
+static bool readSlot(int slot, ParamBlob *blob) {
+  size_t len = prefs.getBytes(slotKeys[slot], blob, sizeof(ParamBlob));
+  if (len < offsetof(ParamBlob, values) || blob->magic != PARAMS_MAGIC ||
+      blob->version != PARAMS_VERSION || blob->size % sizeof(float) ||
+      blob->size > sizeof(ParamValues) || len != blobLength(blob))
+    return false;
+
+  uint32_t crc;
+  uint8_t *end = (uint8_t *)&blob->values + blob->size;
+  memcpy(&crc, end, sizeof(crc));
+  return crc == crc32((const uint8_t *)blob, end - (uint8_t *)blob);
+}
+
+static bool writeSlot(int slot, ParamBlob *blob) {
+  blob->magic = PARAMS_MAGIC;
+  blob->version = PARAMS_VERSION;
+  blob->size = sizeof(ParamValues);
+  blob->crc = crc32((const uint8_t *)blob, offsetof(ParamBlob, crc));
+  return prefs.putBytes(slotKeys[slot], blob, blobLength(blob)) ==
+         blobLength(blob);
+}
+
+static void defaultParams(ParamValues *values) {
+  *values = ParamValues();
+  values->calibration.servoMiddle = 91.5;
+  values->calibration.maxAPSpeed = 25;
+  values->gyroTemp.reference = 25;
+}
+
+static bool loadLegacy(ParamValues *values) {
+  Preferences legacy;
+  float *flat = (float *)values;
+  bool found = false;
+
+#define PARAM_LEGACY(name, ns)                                                 \
+  if (legacy.begin(#ns, true)) {                                               \
+    if (legacy.isKey(#name)) {                                                 \
+      flat[PARAM_##name] = legacy.getFloat(#name);                             \
+      found = true;                                                            \
+    }                                                                          \
+    legacy.end();                                                              \
+  }
+  PARAM_LIST(PARAM_LEGACY)
+#undef PARAM_LEGACY
+
+  return found;
+}
+
+void getParams(ParamValues *values) {
+  values->calibration = calibration;
+  values->kp = pid.getKp();
+  values->ki = pid.getKi();
+  values->kd = pid.getKd();
+  values->gyroTemp = gyroTempModel;
+}
+
+void setParams(const ParamValues *values) {
+  calibration = values->calibration;
+  pid.setKp(values->kp);
+  pid.setKi(values->ki);
+  pid.setKd(values->kd);
+  gyroTempModel = values->gyroTemp;
+}
+
+static bool readMission(MissionPlan *plan) {
+  MissionBlob blob;
+
+  if (prefs.getBytes(MISSION_KEY, &blob, sizeof(blob)) != sizeof(blob) ||
+      blob.magic != MISSION_MAGIC ||
+      blob.crc != crc32((const uint8_t *)&blob.plan, sizeof(blob.plan)) ||
+      missionValidate(&blob.plan))
+    return false;
+
+  *plan = blob.plan;
+  return true;
+}
+
+static bool writeMission(const MissionPlan *plan) {
+  MissionBlob blob;
+  blob.magic = MISSION_MAGIC;
+  blob.plan = *plan;
+  blob.crc = crc32((const uint8_t *)&blob.plan, sizeof(blob.plan));
+  return prefs.putBytes(MISSION_KEY, &blob, sizeof(blob)) == sizeof(blob);
+}
+
+void missionChanged() { publishedMission.write(missionPlan); }
+
+void paramsChanged() {
+  ParamValues values;
+  getParams(&values);
+  published.write(values);
+  lastChange = millis();
+}
+
+static void writerTask(void *pvParameters) {
+  uint32_t saved = 0, savedMission = publishedMission.version();
+  ParamBlob blob;
+
+  for (;;) {
+    vTaskDelay(pdMS_TO_TICKS(100));
+
+    // a failed write stays unsaved and is tried again on the next wake
+    uint32_t missionVersion = publishedMission.version();
+    if (missionVersion != savedMission) {
+      MissionPlan plan = publishedMission.read();
+      if (writeMission(&plan))
+        savedMission = missionVersion;
+      else
+        paramsStats.writeErrors++;
+    }
+
+    uint32_t version = published.version();
+    if (version == saved || millis() - lastChange < PARAMS_DEBOUNCE_MS)
+      continue;
+
+    blob.values = published.read();
+    blob.sequence = paramsStats.sequence + 1;
+
+    // the slot follows the sequence, so a retry never overwrites the only
+    // good copy
+    uint32_t start = micros();
+    if (writeSlot(blob.sequence & 1, &blob)) {
+      paramsStats.sequence = blob.sequence;
+      paramsStats.saves++;
+      saved = version;
+    } else {
+      paramsStats.writeErrors++;
+    }
+
+    uint32_t elapsed = micros() - start;
+    if (elapsed > paramsStats.maxWriteUs)
+      paramsStats.maxWriteUs = elapsed;
+  }
+}
+
+bool setupParams() {
+  ParamValues values;
+  ParamBlob slots[2];
+  defaultParams(&values);
+
+  if (!prefs.begin("params", false)) {
+    setParams(&values);
+    return false;
+  }
+
+  bool valid[2] = {readSlot(0, &slots[0]), readSlot(1, &slots[1])};
+  int newest = valid[1] && (!valid[0] ||
+                            (int32_t)(slots[1].sequence - slots[0].sequence) > 0);
+
+  if (valid[newest]) {
+    memcpy(&values, &slots[newest].values, slots[newest].size);
+    paramsStats.sequence = slots[newest].sequence;
+    setParams(&values);
+  } else {
+    loadLegacy(&values);
+    setParams(&values);
+    paramsChanged(); // first blob, saved by the task
+  }
+
+  if (!readMission(&missionPlan))
+    missionPlan.count = 0;
+
+  // priority of loop(); NVS writes stall it, never the IMU task
+  xTaskCreatePinnedToCore(writerTask, "Params Task", 4096, NULL, 1,
+                          &writerTaskHandle, 0);
+  return writerTaskHandle != NULL;
+}
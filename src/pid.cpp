@@ -1,50 +1,59 @@
 #include "pid.h"
-#include "sensor.h"
+#include "fastmath.h"
+#include "metrics.h"
+#include "pipeline.h"
+#include "seqlock.h"
 #include <Arduino.h>
-#include <Preferences.h>
-#include <uPID.h>
 
-Preferences pidPrefs;
-uPIDfast<I_SATURATE | PID_REVERSE> pid;
+HeadingPID pid;
+static SeqLock<PIDTerms> publishedTerms;
+
+float HeadingPID::compute(float input, float dt) {
+  float error = input - setpoint;
+
+  integral += ki * error * dt;
+  integral = fmaxf(outMin, fminf(outMax, integral));
+
+  terms.error = error;
+  terms.p = kp * error;
+  terms.i = integral;
+  if (dt > 0) {
+    terms.d = kd * (error - prevError) / dt;
+    prevError = error;
+  }
+  terms.output = fmaxf(outMin, fminf(outMax, terms.p + terms.i + terms.d));
+
+  return terms.output;
+}
+
+void HeadingPID::reset() {
+  integral = prevError = 0;
+  terms = {};
+}
 
 void setupPID() {
-  pid = uPIDfast<I_SATURATE | PID_REVERSE>(1000.0f / SAMPLE_RATE);
+  pid = HeadingPID(1000.0f / SAMPLE_RATE);
   pid.outMax = SERVO_MAX_DIFF;
   pid.outMin = -SERVO_MAX_DIFF;
   pid.setpoint = 0;
 }
 
-float tickPID(float yawAnchor, float yaw) {
-  float a = fmodf(yaw - yawAnchor + 540.0f, 360.0f) - 180.0f;
+float headingError(float yawAnchor, float yaw) {
+  float a = mathWrap180(yaw - yawAnchor);
 
   if (a < -90)
     a += 180;
   else if (a > 90)
     a -= 180;
 
-  return pid.compute(a);
+  return a;
 }
 
-void saveCoefficients() {
-  pidPrefs.putFloat("kp", pid.getKp());
-  pidPrefs.putFloat("ki", pid.getKi());
-  pidPrefs.putFloat("kd", pid.getKd());
+float tickPID(float yawAnchor, float yaw, float dt) {
+  PROBE_SCOPE(pid);
+  float output = pid.compute(headingError(yawAnchor, yaw), dt);
+  publishedTerms.write(pid.getTerms());
+  return output;
 }
 
-bool loadCoefficients() {
-  if (!pidPrefs.begin("pid"))
-    return false;
-
-  if (!pidPrefs.isKey("kp") || !pidPrefs.isKey("ki") || !pidPrefs.isKey("kd")) {
-    pid.setKp(0);
-    pid.setKi(0);
-    pid.setKd(0);
-    saveCoefficients();
-  } else {
-    pid.setKp(pidPrefs.getFloat("kp"));
-    pid.setKi(pidPrefs.getFloat("ki"));
-    pid.setKd(pidPrefs.getFloat("kd"));
-  }
-
-  return true;
-}
\ No newline at end of file
+PIDTerms getPIDTerms() { return publishedTerms.read(); }
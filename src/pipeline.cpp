@@ -0,0 +1,131 @@
+#include "pipeline.h"
+#include "fastmath.h"
+#include "filters.h"
+#include "fusion.h"
+#include "gyro_bias.h"
+#include "metrics.h"
+#include <Arduino.h>
+
+#if FAST_MATH
+// multiplies by the reciprocal; 1/4096 is exact, the others round within an
+// ulp of the division, so the counts still round-trip (rawToCounts)
+#define SCALE(counts, lsb) ((counts) * (1.0f / (lsb)))
+#else
+#define SCALE(counts, lsb) ((counts) / (lsb))
+#endif
+
+void decodeMPU6050(const uint8_t *buf, RawICUData *raw) {
+  raw->ax = SCALE((int16_t)(buf[0] << 8 | buf[1]), ACCEL_LSB_PER_G);
+  raw->ay = SCALE((int16_t)(buf[2] << 8 | buf[3]), ACCEL_LSB_PER_G);
+  raw->az = SCALE((int16_t)(buf[4] << 8 | buf[5]), ACCEL_LSB_PER_G); // g
+  raw->gx = SCALE((int16_t)(buf[8] << 8 | buf[9]), GYRO_LSB_PER_DPS);
+  raw->gy = SCALE((int16_t)(buf[10] << 8 | buf[11]), GYRO_LSB_PER_DPS);
+  raw->gz = SCALE((int16_t)(buf[12] << 8 | buf[13]), GYRO_LSB_PER_DPS); // dps
+  raw->temp = (int16_t)(buf[6] << 8 | buf[7]) * (1.0f / 340) + 36.53f;
+}
+
+// always scaled by the reciprocal, as it was before FAST_MATH
+void decodeHMC5883(const uint8_t *buf, RawICUData *raw) {
+  raw->mx = (int16_t)(buf[1] | buf[0] << 8) * (1.0f / MAG_LSB_PER_UT_XZ);
+  raw->mz = (int16_t)(buf[3] | buf[2] << 8) * (1.0f / MAG_LSB_PER_UT_XZ);
+  raw->my = (int16_t)(buf[5] | buf[4] << 8) * (1.0f / MAG_LSB_PER_UT_Y); // uT
+}
+
+#if FAST_MATH
+// Q16 copy of the mag calibration, rebuilt when the float one changes
+static Q16Affine3 magTransform;
+static float magSource[12];
+
+static void applyMagCalibration(const RawICUData *raw,
+                                const CalibrationStore *cal,
+                                CalibratedICUData *out) {
+  if (memcmp(magSource, &cal->magX, 3 * sizeof(float)) != 0 ||
+      memcmp(magSource + 3, cal->magScale, 9 * sizeof(float)) != 0) {
+    memcpy(magSource, &cal->magX, 3 * sizeof(float));
+    memcpy(magSource + 3, cal->magScale, 9 * sizeof(float));
+    magTransform.set(&cal->magX, cal->magScale);
+  }
+
+  magTransform.apply(&raw->mx, &out->mx);
+}
+#else
+static void applyMagCalibration(const RawICUData *raw,
+                                const CalibrationStore *cal,
+                                CalibratedICUData *out) {
+  float mx = raw->mx - cal->magX;
+  float my = raw->my - cal->magY;
+  float mz = raw->mz - cal->magZ;
+
+  out->mx = cal->magScale[0][0] * mx + cal->magScale[0][1] * my +
+            cal->magScale[0][2] * mz;
+  out->my = cal->magScale[1][0] * mx + cal->magScale[1][1] * my +
+            cal->magScale[1][2] * mz;
+  out->mz = cal->magScale[2][0] * mx + cal->magScale[2][1] * my +
+            cal->magScale[2][2] * mz;
+}
+#endif
+
+void applyCalibration(const RawICUData *raw, const CalibrationStore *cal,
+                      CalibratedICUData *out) {
+  out->ax = raw->ax - cal->accelX;
+  out->ay = raw->ay - cal->accelY;
+  out->az = raw->az - cal->accelZ;
+  out->gx = raw->gx - cal->gyroX;
+  out->gy = raw->gy - cal->gyroY;
+  out->gz = raw->gz - cal->gyroZ;
+  applyMagCalibration(raw, cal, out);
+}
+
+template <typename Filter>
+void fuseSample(Filter *fusion, const RawICUData *raw,
+                const CalibrationStore *cal, uint32_t timestamp,
+                EstimatorState *state, GyroBiasEstimator *gyroBias,
+                const GyroTempModel *gyroModel) {
+  CalibratedICUData c;
+  {
+    PROBE_SCOPE(calibration);
+    applyCalibration(raw, cal, &c);
+    if (gyroBias)
+      gyroBias->correct(raw, cal, gyroModel, &c);
+  }
+
+  float dt = 1.0f / SAMPLE_RATE;
+  if (state->sample)
+    dt = fminf(fmaxf((int32_t)(timestamp - state->timestamp) * 1e-6f, 0),
+               SAMPLE_DT_MAX_PERIODS * dt);
+  {
+    PROBE_SCOPE(fusion);
+    fusion->update(c, dt);
+  }
+
+  state->timestamp = timestamp;
+  state->dt = dt;
+  state->sample++;
+  state->yaw = wrapYaw(fusion->getYaw(), cal->north);
+  // state->yaw = filterYaw(state->yaw);
+  fusion->getQuaternion(&state->q[0], &state->q[1], &state->q[2],
+                        &state->q[3]);
+  state->yawRate = c.gz;
+  state->stale = false;
+  state->raw = *raw;
+  state->cal = c;
+}
+
+#define FUSE_SAMPLE(Filter)                                                    \
+  template void fuseSample<Filter>(Filter *, const RawICUData *,              \
+                                   const CalibrationStore *, uint32_t,         \
+                                   EstimatorState *, GyroBiasEstimator *,      \
+                                   const GyroTempModel *);
+FUSE_SAMPLE(NXPFusion)
+FUSE_SAMPLE(MadgwickFusion)
+FUSE_SAMPLE(MahonyFusion)
+FUSE_SAMPLE(ComplementaryFusion)
+
+float wrapYaw(float fusionYaw, float north) {
+  return mathWrap360(fusionYaw - north);
+}
+
+#define YAW_WINDOW 37
+static CircularMean<YAW_WINDOW> yawMean;
+
+float filterYaw(float newYawDeg) { return yawMean.update(newYawDeg); }
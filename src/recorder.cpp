@@ -0,0 +1,255 @@
+#include "recorder.h"
+#include "calibration.h"
+#include "pid.h"
+#include "spsc_ring.h"
+#include "strprintf.h"
+#include <LittleFS.h>
+
+// Markers sent through fullBlocks next to block indices. A run starts with
+// BB_RUN | the index of the block holding its header.
+#define BB_RUN 0x80
+#define BB_END 0xff
+
+enum RecorderRequest : uint8_t { REQ_NONE, REQ_START, REQ_STOP };
+
+struct RecorderBlock {
+  uint16_t len;
+  uint8_t data[BB_BLOCK_SIZE];
+};
+
+RecorderStats recorderStats;
+
+static RecorderBlock blocks[BB_BLOCKS];
+static SPSCRing<uint8_t, 2 * BB_BLOCKS> fullBlocks; // control -> flush
+static SPSCRing<uint8_t, BB_BLOCKS> freeBlocks;     // flush -> control
+static TaskHandle_t flushTaskHandle = NULL;
+
+static std::atomic<uint8_t> request{REQ_NONE};
+static std::atomic<bool> fileOpen{false};
+static std::atomic<bool> recording{false};
+static int current = -1;
+static BlackboxCodec codec;
+
+static_assert(sizeof(BlackboxHeader) <= BB_BLOCK_SIZE,
+              "the run header must fit a block");
+static_assert(BB_BLOCKS <= BB_RUN, "block indices must not look like markers");
+
+static void post(uint8_t item) {
+  fullBlocks.push(item);
+  xTaskNotifyGive(flushTaskHandle);
+}
+
+static void sealBlock() {
+  if (current < 0)
+    return;
+  post(current);
+  current = -1;
+}
+
+// The header is taken here, on the control task that owns the PID, and
+// travels to the flush task in a block of its own.
+static void startRun() {
+  uint8_t i;
+
+  if (!freeBlocks.pop(&i)) {
+    // flash is behind, try again on the next sample unless a stop came in
+    uint8_t none = REQ_NONE;
+    request.compare_exchange_strong(none, REQ_START);
+    return;
+  }
+
+  BlackboxHeader header = {calibration, pid};
+  memcpy(blocks[i].data, &header, sizeof(header));
+  blocks[i].len = sizeof(header);
+  post(BB_RUN | i);
+  recording = true;
+}
+
+void recordSample(const TelemetrySample *sample, uint8_t flags) {
+  // Block indices fill at most BB_BLOCKS slots of fullBlocks. Leaving a
+  // request for later while more than that minus two are queued keeps room
+  // for its two markers.
+  uint8_t req = fullBlocks.size() <= BB_BLOCKS - 2 ? request.exchange(REQ_NONE)
+                                                   : REQ_NONE;
+
+  if (req != REQ_NONE && recording) {
+    sealBlock();
+    post(BB_END);
+    recording = false;
+  }
+  if (req == REQ_START)
+    startRun();
+
+  if (!recording)
+    return;
+
+  if (current >= 0 && blocks[current].len + BB_MAX_RECORD > BB_BLOCK_SIZE)
+    sealBlock();
+
+  if (current < 0) {
+    uint8_t i;
+    if (!freeBlocks.pop(&i)) {
+      recorderStats.dropped++;
+      return;
+    }
+
+    current = i;
+    blocks[i].len = 0;
+    blackboxBeginBlock(&codec);
+  }
+
+  RecorderBlock &block = blocks[current];
+  block.len += blackboxEncode(&codec, sample, flags, block.data + block.len);
+  recorderStats.samples++;
+}
+
+// Run files are <number>.bbx, anything else in BB_DIR is left alone.
+static bool runNumber(const char *name, uint32_t *n) {
+  const char *slash = strrchr(name, '/');
+  char *end;
+
+  if (slash != NULL)
+    name = slash + 1;
+  if (!isdigit((unsigned char)name[0]))
+    return false;
+  *n = strtoul(name, &end, 10);
+  return strcmp(end, ".bbx") == 0;
+}
+
+#define BB_SCAN_RUNS (2 * BB_MAX_RUNS)
+
+// Deletes the oldest runs, by number, until a new one leaves BB_MAX_RUNS.
+// Numbers can have gaps (a failed open, a file deleted by hand), so each
+// pass sorts the BB_SCAN_RUNS lowest; more than that take another pass.
+static void removeOldRuns(uint32_t *next) {
+  for (;;) {
+    uint32_t lowest[BB_SCAN_RUNS], kept = 0, count = 0, last = 0;
+
+    File dir = LittleFS.open(BB_DIR);
+    for (File f = dir.openNextFile(); f; f = dir.openNextFile()) {
+      uint32_t n, i = 0;
+      if (!runNumber(f.name(), &n))
+        continue;
+      count++;
+      last = max(last, n);
+
+      while (i < kept && lowest[i] < n)
+        i++;
+      if (i == BB_SCAN_RUNS)
+        continue;
+      if (kept < BB_SCAN_RUNS)
+        kept++;
+      memmove(&lowest[i + 1], &lowest[i], (kept - 1 - i) * sizeof(uint32_t));
+      lowest[i] = n;
+    }
+    dir.close();
+
+    *next = count ? last + 1 : 0;
+
+    bool removed = false;
+    for (uint32_t i = 0; i < kept && count >= BB_MAX_RUNS; i++)
+      if (LittleFS.remove(strf(BB_DIR "/%05u.bbx", lowest[i]))) {
+        removed = true;
+        count--;
+      }
+
+    if (count < BB_MAX_RUNS || !removed)
+      return;
+  }
+}
+
+static File openRun(const RecorderBlock &header) {
+  uint32_t next;
+
+  if (!LittleFS.exists(BB_DIR))
+    LittleFS.mkdir(BB_DIR);
+  removeOldRuns(&next);
+
+  File file = LittleFS.open(strf(BB_DIR "/%05u.bbx", next), "w");
+  if (file) {
+    file.write((const uint8_t *)BB_MAGIC, 4);
+    file.write((const uint8_t *)&header.len, 2);
+    file.write(header.data, header.len);
+  }
+  return file;
+}
+
+static void flushTask(void *pvParameters) {
+  File file;
+
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+    uint8_t item;
+    while (fullBlocks.pop(&item)) {
+      if (item == BB_END) {
+        if (file)
+          file.close();
+        fileOpen = false;
+        continue;
+      }
+
+      if (item & BB_RUN) {
+        uint8_t header = item & ~BB_RUN;
+        file = openRun(blocks[header]);
+        fileOpen = true;
+        freeBlocks.push(header);
+        continue;
+      }
+
+      RecorderBlock &block = blocks[item];
+      uint32_t start = micros();
+
+      if (!file || file.write((const uint8_t *)&block.len, 2) != 2 ||
+          file.write(block.data, block.len) != block.len)
+        recorderStats.writeErrors++;
+
+      uint32_t elapsed = micros() - start;
+      if (elapsed > recorderStats.maxWriteUs)
+        recorderStats.maxWriteUs = elapsed;
+      recorderStats.blocks++;
+      recorderStats.bytes += 2 + block.len;
+
+      freeBlocks.push(item);
+    }
+  }
+}
+
+bool setupRecorder() {
+  if (!LittleFS.begin())
+    return false;
+
+  for (uint8_t i = 0; i < BB_BLOCKS; i++)
+    freeBlocks.push(i);
+
+  // priority of loop(); it only ever waits on flash, never on the IMU task
+  xTaskCreatePinnedToCore(flushTask, "Blackbox Task", 4096, NULL, 1,
+                          &flushTaskHandle, 0);
+  return flushTaskHandle != NULL;
+}
+
+void recorderStart() {
+  if (flushTaskHandle == NULL)
+    return;
+
+  request = REQ_START;
+}
+
+void recorderStop() { request = REQ_STOP; }
+
+bool recorderActive() {
+  return recording || request.load() == REQ_START || fullBlocks.size() ||
+         fileOpen;
+}
+
+String listRecorderRuns() {
+  String list;
+
+  File dir = LittleFS.open(BB_DIR);
+  if (!dir)
+    return list;
+
+  for (File f = dir.openNextFile(); f; f = dir.openNextFile())
+    list += strf("%s %u\n", f.name(), (unsigned)f.size());
+  return list;
+}
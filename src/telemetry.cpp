@@ -0,0 +1,111 @@
+#include "telemetry.h"
+
+#define TLM_HEADER_LEN (1 + 4 + 2)
+
+static const uint8_t channelSizes[TLM_CHANNEL_COUNT] = {
+    2 * 4, 4, 5 * 4, 2 * 4, sizeof(RawICUData), sizeof(CalibratedICUData)};
+
+static_assert(TLM_CHANNEL_COUNT <= WS_CHANNELS,
+              "a subscription has no room for every telemetry channel");
+static_assert(TLM_HEADER_LEN + 2 * 4 + 4 + 5 * 4 + 2 * 4 + sizeof(RawICUData) +
+                      sizeof(CalibratedICUData) <=
+                  WS_POOL_SLACK,
+              "a frame with every channel does not fit the frame pool slack");
+
+static uint32_t tick = 0;
+
+bool nextTelemetryMasks(uint16_t masks[WS_MAX_CLIENTS]) {
+  WSSubscription subs[WS_MAX_CLIENTS];
+  uint32_t clients = wsSubscriptions(subs);
+  bool due = false;
+
+  for (int c = 0; c < WS_MAX_CLIENTS; c++) {
+    masks[c] = 0;
+    if (!(clients & (1u << c)))
+      continue;
+
+    for (int i = 0; i < TLM_CHANNEL_COUNT; i++) {
+      uint8_t decimation = subs[c].decimation[i];
+      if (decimation && tick % decimation == 0)
+        masks[c] |= 1 << i;
+    }
+    due |= masks[c] != 0;
+  }
+
+  tick++;
+  return due;
+}
+
+size_t telemetryFrameSize(uint16_t mask) {
+  size_t size = TLM_HEADER_LEN;
+
+  for (int i = 0; i < TLM_CHANNEL_COUNT; i++)
+    if (mask & (1 << i))
+      size += channelSizes[i];
+
+  return size;
+}
+
+size_t packTelemetry(uint8_t *buf, uint16_t mask,
+                     const TelemetrySample *sample) {
+  uint8_t *p = buf;
+  auto put = [&p](const void *src, size_t len) {
+    memcpy(p, src, len);
+    p += len;
+  };
+
+  *p++ = 0x20;
+  put(&sample->estimator.timestamp, 4);
+  put(&mask, 2);
+
+  if (mask & (1 << TLM_YAW)) {
+    put(&sample->estimator.yaw, 4);
+    put(&sample->yawAnchor, 4);
+  }
+
+  if (mask & (1 << TLM_YAW_RATE))
+    put(&sample->estimator.yawRate, 4);
+
+  if (mask & (1 << TLM_PID)) {
+    put(&sample->pid.error, 4);
+    put(&sample->pid.p, 4);
+    put(&sample->pid.i, 4);
+    put(&sample->pid.d, 4);
+    put(&sample->pid.output, 4);
+  }
+
+  if (mask & (1 << TLM_OUTPUT)) {
+    put(&sample->servo, 4);
+    put(&sample->motor, 4);
+  }
+
+  if (mask & (1 << TLM_RAW))
+    put(&sample->estimator.raw, sizeof(RawICUData));
+
+  if (mask & (1 << TLM_CAL))
+    put(&sample->estimator.cal, sizeof(CalibratedICUData));
+
+  return p - buf;
+}
+
+void sendTelemetry(const uint16_t masks[WS_MAX_CLIENTS],
+                   const TelemetrySample *sample) {
+  uint32_t sent = 0;
+
+  for (int c = 0; c < WS_MAX_CLIENTS; c++) {
+    if (masks[c] == 0 || (sent & (1u << c)))
+      continue;
+
+    uint32_t clients = 0;
+    for (int other = c; other < WS_MAX_CLIENTS; other++)
+      if (masks[other] == masks[c])
+        clients |= 1u << other;
+    sent |= clients;
+
+    auto frame = wsFrame(telemetryFrameSize(masks[c]));
+    if (frame.data == NULL)
+      continue;
+    packTelemetry(frame.data, masks[c], sample);
+    wsSend(frame, WS_DROP_OLDEST, clients);
+  }
+}
@@ -1,5 +1,9 @@
 #include "ws.h"
 #include "Arduino.h"
+#include "boot.h"
+#include "metrics.h"
+#include "recorder.h"
+#include "ws_queue.h"
 #include <AsyncTCP.h>
 #include <ESPAsyncWebServer.h>
 #include <ElegantOTA.h>
@@ -7,7 +11,10 @@
 #include <WiFi.h>
 #include <esp_wifi.h>
 
+#define INDEX_ETAG_PATH "/index.html.etag"
+
 static AsyncWebServer server(80);
+static String indexETag;
 static AsyncWebSocketMessageHandler wsHandler;
 AsyncWebSocket ws("/ws", wsHandler.eventHandler());
 
@@ -20,38 +27,177 @@ bool setupWS(
     // Serial.println("LittleFS mount failed!");
     return false;
   }
-  // Serial.println("LittleFS mounted, connecting to WiFi");
-
-  WiFi.mode(WIFI_STA);
-  esp_wifi_set_ps(WIFI_PS_NONE);
-  WiFi.setTxPower(WIFI_POWER_15dBm);
-  WiFi.begin(SSID, PASSWORD);
 
-  while (WiFi.status() != WL_CONNECTED) {
-    delay(500);
-    // Serial.print(WiFi.status());
+  // The page is only on LittleFS as index.html.gz (web/scripts/compress.js):
+  // the file response picks the .gz and sets Content-Encoding. Browsers
+  // revalidate it on every load and get a bodyless 304 until it changes.
+  File etagFile = LittleFS.open(INDEX_ETAG_PATH, "r");
+  if (etagFile) {
+    indexETag = etagFile.readString();
+    indexETag.trim();
+    etagFile.close();
   }
 
-  // Serial.println("\nWiFi connected");
-  // Serial.print("IP address: ");
-  // Serial.println(WiFi.localIP());
-
-  // serves root html page
   server.on("/", HTTP_GET, [](AsyncWebServerRequest *request) {
-    request->send(LittleFS, "/index.html", "text/html");
+    const AsyncWebHeader *match = request->getHeader("If-None-Match");
+    AsyncWebServerResponse *response;
+
+    if (indexETag.length() && match && match->value().indexOf(indexETag) >= 0)
+      response = request->beginResponse(304);
+    else
+      response = request->beginResponse(LittleFS, "/index.html", "text/html");
+
+    if (indexETag.length())
+      response->addHeader("ETag", indexETag);
+    response->addHeader("Cache-Control", "no-cache");
+    request->send(response);
+  });
+
+  // blackbox runs: list at /blackbox, files under /bb/
+  server.on("/blackbox", HTTP_GET, [](AsyncWebServerRequest *request) {
+    request->send(200, "text/plain", listRecorderRuns());
+  });
+  server.serveStatic(BB_DIR "/", LittleFS, BB_DIR "/")
+      .setCacheControl("no-cache");
+
+  // Prometheus scrape target; the async server runs one request at a time
+  server.on("/metrics", HTTP_GET, [](AsyncWebServerRequest *request) {
+    static char text[METRICS_MAX_LEN];
+    formatMetrics(text, sizeof(text));
+    request->send(200, "text/plain; version=0.0.4", text);
   });
 
   ElegantOTA.begin(&server);
 
+  // every client past WS_MAX_CLIENTS would have no queue to send from
+  wsHandler.onConnect([](AsyncWebSocket *server, AsyncWebSocketClient *client) {
+    if (wsOpen(client->id()) < 0)
+      client->close();
+  });
+  wsHandler.onDisconnect(
+      [](AsyncWebSocket *server, uint32_t clientId) { wsClose(clientId); });
   wsHandler.onMessage(onMessage);
 
   server.addHandler(&ws);
+  return true;
+}
+
+static bool serverStarted = false;
+
+void startWS() {
   server.begin();
+  serverStarted = true;
+}
 
-  return true;
+// from CONNECTED on, the page is reachable
+enum WiFiState : uint8_t {
+  WIFI_STATE_OFF,
+  WIFI_STATE_CONNECTING,
+  WIFI_STATE_CONNECTED,
+  WIFI_STATE_SOFTAP,
+  WIFI_STATE_SOFTAP_RETRY, // the access point is still up
+};
+
+// WPA2 takes 8 to 63 characters, softAP() fails on anything else
+static_assert(sizeof(SOFTAP_PASSWORD) - 1 >= 8 &&
+                  sizeof(SOFTAP_PASSWORD) - 1 <= 63,
+              "SOFTAP_PASSWORD has to be 8 to 63 characters");
+
+static WiFiState state = WIFI_STATE_OFF;
+static uint8_t attempts;
+static uint32_t attemptStart;
+
+static void beginAttempt() {
+  WiFi.begin(SSID, PASSWORD);
+  attemptStart = millis();
+}
+
+void startWiFi() {
+  WiFi.mode(WIFI_STA);
+  esp_wifi_set_ps(WIFI_PS_NONE);
+  WiFi.setTxPower(WIFI_POWER_15dBm);
+
+  state = WIFI_STATE_CONNECTING;
+  attempts = 0;
+  beginAttempt();
+}
+
+void stopWiFi() {
+  WiFi.disconnect(true);
+  WiFi.mode(WIFI_OFF);
+  state = WIFI_STATE_OFF;
+}
+
+static void tickWiFi() {
+  switch (state) {
+  case WIFI_STATE_CONNECTING:
+    if (WiFi.status() == WL_CONNECTED) {
+      state = WIFI_STATE_CONNECTED;
+      bootMark(BOOT_wifi);
+      break;
+    }
+    if (millis() - attemptStart < WIFI_ATTEMPT_MS)
+      break;
+
+    if (++attempts < WIFI_ATTEMPTS) {
+      WiFi.disconnect();
+      beginAttempt();
+      break;
+    }
+
+    // the station keeps scanning otherwise, which takes the AP off its
+    // channel; the station side stays for the retries
+    WiFi.disconnect();
+    WiFi.mode(WIFI_AP_STA);
+    WiFi.softAP(SOFTAP_SSID, SOFTAP_PASSWORD);
+    state = WIFI_STATE_SOFTAP;
+    attemptStart = millis();
+    bootMark(BOOT_softap);
+    break;
+
+  case WIFI_STATE_SOFTAP:
+    // a scan would take the page off its channel under whoever is on it
+    if (millis() - attemptStart >= WIFI_RETRY_MS &&
+        WiFi.softAPgetStationNum() == 0) {
+      state = WIFI_STATE_SOFTAP_RETRY;
+      beginAttempt();
+    }
+    break;
+
+  case WIFI_STATE_SOFTAP_RETRY:
+    if (WiFi.status() == WL_CONNECTED) {
+      WiFi.mode(WIFI_STA); // closes our own
+      state = WIFI_STATE_CONNECTED;
+      bootMark(BOOT_wifi);
+      break;
+    }
+    if (millis() - attemptStart >= WIFI_ATTEMPT_MS) {
+      WiFi.disconnect();
+      state = WIFI_STATE_SOFTAP;
+      attemptStart = millis();
+    }
+    break;
+
+  case WIFI_STATE_CONNECTED:
+    // lost the access point: the same tries again before falling back
+    if (WiFi.status() != WL_CONNECTED) {
+      state = WIFI_STATE_CONNECTING;
+      attempts = 0;
+      attemptStart = millis();
+    }
+    break;
+
+  default:
+    break;
+  }
 }
 
 void tickWS() {
+  tickWiFi();
+  if (serverStarted && state >= WIFI_STATE_CONNECTED)
+    bootMark(BOOT_controllable);
+
+  wsPump();
   ws.cleanupClients();
   ElegantOTA.loop();
 }
\ No newline at end of file
@@ -0,0 +1,431 @@
+#include "ws_queue.h"
+#include "hal.h"
+#include <atomic>
+#include <mutex>
+#include <string.h>
+
+// The payload follows the header in the same run of pool chunks. refs is
+// only touched under the lock.
+struct WSBuffer {
+  uint16_t refs;
+  uint16_t len;
+
+  uint8_t *data() { return reinterpret_cast<uint8_t *>(this + 1); }
+};
+
+static size_t chunksFor(size_t len) {
+  return (sizeof(WSBuffer) + len + WS_POOL_CHUNK - 1) / WS_POOL_CHUNK;
+}
+
+// Every client's queue full to its byte cap, each message wasting up to a
+// chunk, and the frames being built or written on top.
+#define WS_POOL_CHUNKS                                                         \
+  ((WS_MAX_CLIENTS * (WS_QUEUE_BYTES + WS_QUEUE_MESSAGES * WS_POOL_CHUNK) +    \
+    WS_POOL_SLACK) /                                                           \
+   WS_POOL_CHUNK)
+
+struct WSEntry {
+  WSBuffer *buffer;
+  WSDelivery delivery;
+};
+
+struct WSClient {
+  bool active;
+  bool sending;    // entries[0] is being written by wsPump
+  bool overflowed; // a reliable frame did not fit
+  bool closing;
+  uint32_t id, generation;
+  WSSubscription subscription;
+  uint8_t count;
+  WSEntry entries[WS_QUEUE_MESSAGES];
+};
+
+WSStats wsStats;
+WSClientStats wsClientStats[WS_MAX_CLIENTS];
+
+// senders run on the clock tasks and the loop, the server events on the
+// network task, wsPump on the loop; the handoff task never takes it
+static std::mutex lock;
+static WSClient clients[WS_MAX_CLIENTS];
+// what wsSubscribers() needs, kept in step under the lock and read without
+static std::atomic<uint32_t> activeClients{0};
+static std::atomic<uint8_t> clientStreams[WS_MAX_CLIENTS];
+
+// Frames built on the handoff task wait here, a WSHandoff each followed by
+// the payload and rounded up to the header size, until wsPump() copies them
+// into the pool. One producer, one consumer, the counters run free.
+struct WSHandoff {
+  uint16_t len; // WS_HANDOFF_WRAP: the rest of the ring is unused
+  WSDelivery delivery;
+  uint32_t mask;
+};
+
+#define WS_HANDOFF_WRAP UINT16_MAX
+static_assert((WS_HANDOFF_BYTES & (WS_HANDOFF_BYTES - 1)) == 0 &&
+                  WS_HANDOFF_BYTES % sizeof(WSHandoff) == 0,
+              "WS_HANDOFF_BYTES has to be a power of two");
+
+alignas(WSHandoff) static uint8_t ring[WS_HANDOFF_BYTES];
+static std::atomic<uint32_t> ringHead{0}, ringTail{0};
+static std::atomic<uint32_t> handoffDropped{0};
+static std::atomic<void *> handoffTask{NULL};
+static uint32_t ringReserved; // the producer's head after the frame it builds
+
+alignas(4) static uint8_t pool[WS_POOL_CHUNKS][WS_POOL_CHUNK];
+static uint32_t poolUsed[(WS_POOL_CHUNKS + 31) / 32]; // a bit per chunk
+
+static bool chunkUsed(size_t i) { return poolUsed[i / 32] & (1u << (i % 32)); }
+
+static void markChunks(size_t first, size_t n, bool used) {
+  for (size_t i = first; i < first + n; i++) {
+    if (used)
+      poolUsed[i / 32] |= 1u << (i % 32);
+    else
+      poolUsed[i / 32] &= ~(1u << (i % 32));
+  }
+}
+
+// First fit, under the lock. NULL when no run of free chunks is long enough.
+static WSBuffer *allocBuffer(size_t len) {
+  size_t n = chunksFor(len), run = 0;
+
+  for (size_t i = 0; i < WS_POOL_CHUNKS; i++) {
+    if (i % 32 == 0 && poolUsed[i / 32] == UINT32_MAX) {
+      i += 31;
+      run = 0;
+      continue;
+    }
+    if (chunkUsed(i)) {
+      run = 0;
+      continue;
+    }
+    if (++run < n)
+      continue;
+
+    size_t first = i + 1 - n;
+    markChunks(first, n, true);
+    return reinterpret_cast<WSBuffer *>(pool[first]);
+  }
+
+  return NULL;
+}
+
+static void unref(WSBuffer *buffer) {
+  if (--buffer->refs == 0)
+    markChunks((uint8_t(*)[WS_POOL_CHUNK])buffer - pool, chunksFor(buffer->len),
+               false);
+}
+
+static size_t handoffSize(size_t len) {
+  return (sizeof(WSHandoff) + len + sizeof(WSHandoff) - 1) /
+         sizeof(WSHandoff) * sizeof(WSHandoff);
+}
+
+static bool inRing(void *handle) {
+  auto p = static_cast<uint8_t *>(handle);
+  return p >= ring && p < ring + WS_HANDOFF_BYTES;
+}
+
+// Producer side: a frame that does not fit before the end of the ring
+// starts over at its beginning, behind a wrap marker.
+static WSFrame handoffFrame(size_t len) {
+  uint32_t head = ringHead.load(std::memory_order_relaxed);
+  uint32_t pos = head % WS_HANDOFF_BYTES, size = handoffSize(len);
+  uint32_t pad = pos + size > WS_HANDOFF_BYTES ? WS_HANDOFF_BYTES - pos : 0;
+  uint32_t used = head - ringTail.load(std::memory_order_acquire);
+
+  if (len >= WS_HANDOFF_WRAP || pad + size > WS_HANDOFF_BYTES - used) {
+    handoffDropped++;
+    return {NULL, NULL};
+  }
+
+  if (pad)
+    reinterpret_cast<WSHandoff *>(&ring[pos])->len = WS_HANDOFF_WRAP;
+  auto h = reinterpret_cast<WSHandoff *>(&ring[(pos + pad) % WS_HANDOFF_BYTES]);
+  h->len = len;
+  ringReserved = head + pad + size;
+  return {h, reinterpret_cast<uint8_t *>(h + 1)};
+}
+
+static void removeEntry(int slot, int i) {
+  WSClient &c = clients[slot];
+  WSClientStats &s = wsClientStats[slot];
+
+  s.bytes -= c.entries[i].buffer->len;
+  unref(c.entries[i].buffer);
+  memmove(&c.entries[i], &c.entries[i + 1],
+          (c.count - i - 1) * sizeof(WSEntry));
+  s.depth = --c.count;
+}
+
+// everything but a frame wsPump is writing
+static void clearQueue(int slot) {
+  WSClient &c = clients[slot];
+
+  while (c.count > (c.sending ? 1 : 0))
+    removeEntry(slot, c.count - 1);
+}
+
+static void countDrop(int slot) {
+  wsClientStats[slot].dropped++;
+  wsStats.dropped++;
+}
+
+static void enqueue(int slot, WSBuffer *buffer, WSDelivery delivery) {
+  WSClient &c = clients[slot];
+  WSClientStats &s = wsClientStats[slot];
+  int first = c.sending ? 1 : 0;
+
+  if (delivery == WS_LATEST)
+    for (int i = first; i < c.count; i++) {
+      WSEntry &e = c.entries[i];
+
+      if (e.delivery == WS_LATEST && e.buffer->data()[0] == buffer->data()[0]) {
+        s.bytes = s.bytes - e.buffer->len + buffer->len;
+        unref(e.buffer);
+        e.buffer = buffer;
+        buffer->refs++;
+        s.replaced++;
+        return;
+      }
+    }
+
+  while (c.count == WS_QUEUE_MESSAGES ||
+         s.bytes + buffer->len > WS_QUEUE_BYTES) {
+    int oldest = first;
+    while (oldest < c.count && c.entries[oldest].delivery == WS_RELIABLE)
+      oldest++;
+
+    if (oldest < c.count) {
+      removeEntry(slot, oldest);
+      countDrop(slot);
+      continue;
+    }
+
+    // nothing left to give up but the new frame
+    countDrop(slot);
+    if (delivery == WS_RELIABLE) {
+      c.overflowed = true;
+      wsStats.closed++;
+      clearQueue(slot);
+    }
+    return;
+  }
+
+  c.entries[c.count++] = {buffer, delivery};
+  buffer->refs++;
+  s.bytes += buffer->len;
+  s.depth = c.count;
+  if (s.depth > s.maxDepth)
+    s.maxDepth = s.depth;
+}
+
+// under the lock, gives up the sender's reference
+static void sendBuffer(WSBuffer *buffer, WSDelivery delivery, uint32_t mask) {
+  wsStats.frames++;
+  for (int i = 0; i < WS_MAX_CLIENTS; i++)
+    if ((mask & (1u << i)) && clients[i].active && !clients[i].overflowed)
+      enqueue(i, buffer, delivery);
+  unref(buffer);
+}
+
+// Consumer side, under the lock.
+static void drainHandoff() {
+  uint32_t tail = ringTail.load(std::memory_order_relaxed);
+  uint32_t head = ringHead.load(std::memory_order_acquire);
+
+  while (tail != head) {
+    auto h = reinterpret_cast<WSHandoff *>(&ring[tail % WS_HANDOFF_BYTES]);
+    if (h->len == WS_HANDOFF_WRAP) {
+      tail += WS_HANDOFF_BYTES - tail % WS_HANDOFF_BYTES;
+      continue;
+    }
+
+    WSBuffer *buffer = allocBuffer(h->len);
+    if (buffer == NULL) {
+      wsStats.dropped++;
+    } else {
+      buffer->refs = 1;
+      buffer->len = h->len;
+      memcpy(buffer->data(), h + 1, h->len);
+      sendBuffer(buffer, h->delivery, h->mask);
+    }
+    tail += handoffSize(h->len);
+  }
+
+  ringTail.store(tail, std::memory_order_release);
+  wsStats.dropped += handoffDropped.exchange(0);
+}
+
+void wsUseHandoff() { handoffTask = halTaskCurrent(); }
+
+WSFrame wsFrame(size_t len) {
+  void *task = handoffTask.load(std::memory_order_relaxed);
+  if (task != NULL && task == halTaskCurrent())
+    return handoffFrame(len);
+
+  std::lock_guard<std::mutex> guard(lock);
+  WSBuffer *buffer = len <= UINT16_MAX ? allocBuffer(len) : NULL;
+
+  if (buffer == NULL) {
+    wsStats.dropped++;
+    return {NULL, NULL};
+  }
+
+  buffer->refs = 1; // the sender's, given up at the end of wsSend
+  buffer->len = len;
+  return {buffer, buffer->data()};
+}
+
+void wsSend(WSFrame frame, WSDelivery delivery, uint32_t mask) {
+  auto buffer = static_cast<WSBuffer *>(frame.handle);
+  if (buffer == NULL)
+    return;
+
+  if (inRing(buffer)) {
+    auto h = static_cast<WSHandoff *>(frame.handle);
+    h->delivery = delivery;
+    h->mask = mask;
+    ringHead.store(ringReserved, std::memory_order_release);
+    return;
+  }
+
+  std::lock_guard<std::mutex> guard(lock);
+  sendBuffer(buffer, delivery, mask);
+}
+
+uint32_t wsSubscribers(uint8_t stream) {
+  uint32_t active = activeClients.load(std::memory_order_acquire);
+  uint32_t mask = 0;
+
+  for (int i = 0; i < WS_MAX_CLIENTS; i++)
+    if ((active & (1u << i)) && (stream == 0 || (clientStreams[i] & stream)))
+      mask |= 1u << i;
+
+  return mask;
+}
+
+static int findClient(uint32_t id) {
+  for (int i = 0; i < WS_MAX_CLIENTS; i++)
+    if (clients[i].active && clients[i].id == id)
+      return i;
+  return -1;
+}
+
+int wsOpen(uint32_t id) {
+  std::lock_guard<std::mutex> guard(lock);
+
+  for (int i = 0; i < WS_MAX_CLIENTS; i++) {
+    WSClient &c = clients[i];
+    if (c.active)
+      continue;
+
+    c.active = true;
+    c.sending = c.overflowed = c.closing = false;
+    c.id = id;
+    c.generation++;
+    c.subscription = WS_DEFAULT_SUBSCRIPTION;
+    c.count = 0;
+    wsClientStats[i] = {id};
+    clientStreams[i] = c.subscription.streams;
+    activeClients |= 1u << i;
+    return i;
+  }
+
+  return -1;
+}
+
+void wsClose(uint32_t id) {
+  std::lock_guard<std::mutex> guard(lock);
+  int slot = findClient(id);
+  if (slot < 0)
+    return;
+
+  // a frame wsPump holds is freed by its own reference
+  clients[slot].sending = false;
+  clearQueue(slot);
+  clients[slot].active = false;
+  activeClients &= ~(1u << slot);
+  wsClientStats[slot].id = 0;
+}
+
+void wsSubscribe(uint32_t id, uint8_t streams, const uint8_t *decimation,
+                 size_t len) {
+  std::lock_guard<std::mutex> guard(lock);
+  int slot = findClient(id);
+  if (slot < 0)
+    return;
+
+  WSSubscription &sub = clients[slot].subscription;
+  sub.streams = streams;
+  clientStreams[slot] = streams;
+  for (int i = 0; i < WS_CHANNELS; i++)
+    sub.decimation[i] = i < (int)len ? decimation[i] : 0;
+}
+
+uint32_t wsSubscriptions(WSSubscription *subs) {
+  std::lock_guard<std::mutex> guard(lock);
+  uint32_t mask = 0;
+
+  for (int i = 0; i < WS_MAX_CLIENTS; i++)
+    if (clients[i].active) {
+      subs[i] = clients[i].subscription;
+      mask |= 1u << i;
+    }
+
+  return mask;
+}
+
+// The socket copies the frame, so the write happens outside the lock with a
+// reference of its own; senders leave entries[0] alone meanwhile.
+void wsPump() {
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    drainHandoff();
+  }
+
+  for (int slot = 0; slot < WS_MAX_CLIENTS; slot++) {
+    for (;;) {
+      WSClient &c = clients[slot];
+      WSBuffer *buffer = NULL;
+      uint32_t id, generation;
+      bool close = false;
+
+      {
+        std::lock_guard<std::mutex> guard(lock);
+        if (!c.active || c.closing)
+          break;
+
+        id = c.id;
+        generation = c.generation;
+        if (c.overflowed)
+          close = c.closing = true;
+        else if (c.count) {
+          buffer = c.entries[0].buffer;
+          buffer->refs++;
+          c.sending = true;
+        }
+      }
+
+      if (close)
+        halWSClose(id);
+      if (buffer == NULL)
+        break;
+
+      bool written = halWSWrite(id, buffer->data(), buffer->len);
+
+      std::lock_guard<std::mutex> guard(lock);
+      if (c.active && c.generation == generation && c.sending) {
+        c.sending = false;
+        if (written) {
+          removeEntry(slot, 0);
+          wsClientStats[slot].sent++;
+        }
+      }
+      unref(buffer);
+
+      if (!written)
+        break;
+    }
+  }
+}
@@ -0,0 +1,17 @@
+// Gzips the single-file build into ../data for LittleFS, next to the strong
+// ETag the firmware compares If-None-Match with. Part of `build`, which
+// buildfs runs through scripts/build_web.py; neither file is committed.
+import { createHash } from "node:crypto"
+import { mkdirSync, readFileSync, rmSync, writeFileSync } from "node:fs"
+import { constants, gzipSync } from "node:zlib"
+
+const html = readFileSync("dist/index.html")
+const gz = gzipSync(html, { level: constants.Z_BEST_COMPRESSION })
+const etag = `"${createHash("sha256").update(gz).digest("hex").slice(0, 16)}"`
+
+mkdirSync("../data", { recursive: true })
+writeFileSync("../data/index.html.gz", gz)
+writeFileSync("../data/index.html.etag", etag)
+rmSync("../data/index.html", { force: true })
+
+console.log(`index.html: ${html.length} -> ${gz.length} bytes gzipped, ETag ${etag}`)
@@ -3,7 +3,7 @@ import { createWS, createWSState } from "@solid-primitives/websocket"
 import { createEffect, createSignal, on, Show } from "solid-js"
 import CalibrationPage from "./CalibrationPage"
 import ControlPage from "./ControlPage"
-import { buildInitPacket, buildPingPacket, getPacketData } from "./packets"
+import { buildInitRequestPacket, buildPingPacket, buildSubscription, getPacketData, PacketId } from "./packets"
 import createPersistent from "solid-persistent"
 
 export default function App() {
@@ -13,15 +13,27 @@ export default function App() {
   const stateIndex = createWSState(ws)
   const state = () => ["Connecting", "Connected", "Disconnecting", "Disconnected"][stateIndex()]
 
+  const [calibrating, setCalibrating] = createSignal(false)
+
   // let pingInvervalHandle: number
   const openEvent = createEventSignal(ws, "open")
   createEffect(
     on(openEvent, () => {
-      ws.send(buildInitPacket())
+      ws.send(buildInitRequestPacket())
       // pingInvervalHandle = setInterval(() => ws.send(buildPingPacket()), 100)
     })
   )
 
+  // only the visible page's channels and streams are sent
+  createEffect(
+    on([openEvent, calibrating], () => {
+      if (ws.readyState !== WebSocket.OPEN) return
+
+      if (calibrating()) ws.send(buildSubscription({ YAW: 10, RAW: 10 }, ["CALIBRATION", "CAPTURE"]))
+      else ws.send(buildSubscription({ YAW: 2, YAW_RATE: 2, PID: 2, OUTPUT: 2 }, ["STATS", "AUTOTUNE", "MISSION"]))
+    })
+  )
+
   // const closeEvent = createEventSignal(ws, "close")
   // createEffect(on(closeEvent, () => clearInterval(pingInvervalHandle)))
 
@@ -34,7 +46,7 @@ export default function App() {
 
       const [id, _] = getPacketData(buffer)
 
-      if (id === 0xbb) {
+      if (id === PacketId.Message) {
         const strBuf = new Uint8Array(buffer, 1)
         const decoder = new TextDecoder("utf-8")
         const str = decoder.decode(strBuf)
@@ -43,8 +55,6 @@ export default function App() {
     })
   )
 
-  const [calibrating, setCalibrating] = createSignal(false)
-
   const controlPage = createPersistent(() => <ControlPage ws={ws} message={message} />)
   const calibrationPage = createPersistent(() => <CalibrationPage ws={ws} message={message} />)
 
@@ -1,21 +1,31 @@
 import { createEffect, createSignal, For, on, Show } from "solid-js"
 import PointSpace from "./PointSpace"
-import { calibrateAccelerometer, calibrateMagnetometer, Point, MagCalibrationData } from "./math"
+import { calibrateAccelerometer, Point, MagCalibrationData } from "./math"
 import {
-  buildAccelCalibrationDataPacket,
-  buildCalibrationDataPacket,
-  buildCalibrationDataRequestPacket,
-  buildMagCalibrationDataPacket,
-  buildMagCalibrationStopPacket,
+  buildAccelCalibrationPacket,
+  buildCalibrationRequestPacket,
+  buildCapturePacket,
+  buildSetCalibrationPacket,
   buildSetNorthPacket,
   buildStartAccelCalibrationPacket,
   buildStartGyroCalibrationPacket,
   buildStartMagCalibrationPacket,
+  buildStopMagCalibrationPacket,
+  calibrationFromArray,
+  calibrationToArray,
   getPacketData,
+  magCalibrationFromStatus,
+  PacketId,
+  parseAccelCalibrationDataPacket,
+  parseAccelCalibrationProgressPacket,
+  parseCalibrationPacket,
+  parseGyroCalibrationProgressPacket,
+  parseMagCalibrationStatusPacket,
+  parseTelemetry,
 } from "./packets"
 import { createSessionSignal } from "./signal"
 
-const MIN_MAG_POINTS = 100
+const MIN_MAG_POINTS = 150 // MAG_FIT_MIN_POINTS, readings the boat fits
 
 export default function CalibrationPage(props: { ws: WebSocket; message: () => ArrayBuffer }) {
   const zeroPoint = [0, 0, 0] as Point
@@ -23,6 +33,7 @@ export default function CalibrationPage(props: { ws: WebSocket; message: () => A
   const [collectedPoints, setCollectedPoints] = createSessionSignal<Point[]>("points", -1, [], localStorage)
   const [calibratingMag, setCalibratingMag] = createSignal(false)
   const [magCalData, setMagCalData] = createSignal<MagCalibrationData | undefined>()
+  const [magFitPoints, setMagFitPoints] = createSignal(0)
   const [displayFixed, setDisplayFixed] = createSignal(false)
 
   const [gyroPercentage, setGyroPercentage] = createSignal(100)
@@ -39,50 +50,56 @@ export default function CalibrationPage(props: { ws: WebSocket; message: () => A
   const defaultCalData = [0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 0, 91.5, 25]
   const [calibrationData, setCalibrationData] = createSignal<number[]>(defaultCalData)
 
+  // raw capture frames are kept as received and saved as one file, split on
+  // the host with `program capture <file>`
+  let captureFrames: ArrayBuffer[] = []
+  const [capturing, setCapturing] = createSignal(false)
+  const [captureSamples, setCaptureSamples] = createSignal(0)
+
   createEffect(
     on(props.message, buffer => {
       if (!buffer) return
       const [id, view] = getPacketData(buffer)
 
-      if (id === 0xc0) {
-        const newPoints = [
-          ...collectedPoints(),
-          [view.getFloat32(0, true), view.getFloat32(4, true), view.getFloat32(8, true)] as Point,
-        ]
-        setCollectedPoints(newPoints)
-
-        if (calibratingMag() && newPoints.length >= MIN_MAG_POINTS) {
-          if (newPoints.length % 5 != 0) return
-
-          const calData = calibrateMagnetometer(newPoints)
-          setMagCalData(calData)
-        } else {
-          setMagCalData()
-        }
+      // raw magnetometer points arrive as telemetry while the page is open,
+      // they are only plotted, the boat fits every fresh reading itself
+      if (id === PacketId.Telemetry && calibratingMag()) {
+        const raw = parseTelemetry(view).raw
+        if (!raw) return
+
+        setCollectedPoints([...collectedPoints(), raw.slice(6, 9) as Point])
+      }
+
+      if (id === PacketId.MagCalibrationStatus && calibratingMag()) {
+        const status = parseMagCalibrationStatusPacket(view)
+        setMagFitPoints(status.points)
+        setMagCalData(magCalibrationFromStatus(status))
       }
 
-      if (id === 0xc2) {
-        setGyroPercentage(view.getFloat32(0, true))
+      if (id === PacketId.CaptureData && capturing()) {
+        captureFrames.push(buffer)
+        setCaptureSamples(n => n + view.getUint8(8))
       }
 
-      if (id === 0xc6) {
-        setAccelPercentages(accelPercentages().with(view.getUint8(4), view.getFloat32(0, true)))
+      if (id === PacketId.GyroCalibrationProgress) {
+        setGyroPercentage(parseGyroCalibrationProgressPacket(view).percentage)
       }
 
-      if (id === 0xc7) {
-        setAccelPoints(
-          accelPoints().with(view.getUint8(0), [
-            view.getFloat32(1, true),
-            view.getFloat32(5, true),
-            view.getFloat32(9, true),
-          ])
-        )
-        setAccelPercentages(accelPercentages().with(view.getUint8(0), 100))
+      if (id === PacketId.AccelCalibrationProgress) {
+        const progress = parseAccelCalibrationProgressPacket(view)
+        setAccelPercentages(accelPercentages().with(progress.axis, progress.percentage))
       }
 
-      if (id === 0xa0) {
-        console.log(view)
-        setCalibrationData(Array.from({ length: 21 }).map((_, i) => view.getFloat32(i * 4, true)))
+      if (id === PacketId.AccelCalibrationData) {
+        const data = parseAccelCalibrationDataPacket(view)
+        setAccelPoints(accelPoints().with(data.axis, [data.ax, data.ay, data.az]))
+        setAccelPercentages(accelPercentages().with(data.axis, 100))
+      }
+
+      if (id === PacketId.Calibration) {
+        // sent when the boat applies a mag fit, also one it accepted by itself
+        setCalibratingMag(false)
+        setCalibrationData(calibrationToArray(parseCalibrationPacket(view)))
       }
     })
   )
@@ -104,11 +121,13 @@ export default function CalibrationPage(props: { ws: WebSocket; message: () => A
           onClick={() => {
             if (calibratingMag()) {
               setCalibratingMag(false)
-              props.ws.send(buildMagCalibrationStopPacket())
+              props.ws.send(buildStopMagCalibrationPacket({ apply: false }))
               return
             }
 
             setCollectedPoints([])
+            setMagCalData()
+            setMagFitPoints(0)
           }}
           class="rounded-lg bg-red-300 px-4 py-2">
           {calibratingMag() ? "Stop" : "Clear"}
@@ -116,27 +135,23 @@ export default function CalibrationPage(props: { ws: WebSocket; message: () => A
         <button
           onClick={() => {
             if (!calibratingMag()) {
+              setMagCalData()
+              setMagFitPoints(0)
               props.ws.send(buildStartMagCalibrationPacket())
             } else {
-              console.log(magCalData())
-
-              if (!magCalData()) {
-                props.ws.send(buildMagCalibrationStopPacket())
-                return void console.log("Failed to calibrate")
-              }
-
-              props.ws.send(buildMagCalibrationDataPacket(magCalData()))
+              // the boat applies its latest fit if it is good enough
+              props.ws.send(buildStopMagCalibrationPacket({ apply: true }))
             }
 
             setCalibratingMag(v => !v)
           }}
           class={"rounded-lg px-4 py-2 " + (calibratingMag() ? "bg-blue-300" : "bg-cyan-300")}>
-          {calibratingMag() ? "Send Calibration" : "Start Calibration"}
+          {calibratingMag() ? "Apply Calibration" : "Start Calibration"}
         </button>
       </div>
 
       <p class="mt-0.5 text-gray-600">
-        Points collected: {collectedPoints().length} / {MIN_MAG_POINTS}
+        Points fitted: {magFitPoints()} / {MIN_MAG_POINTS} ({collectedPoints().length} plotted)
       </p>
       <div class="mt-1 text-sm text-gray-700">
         <p>Fit Error: {magCalData()?.fitError.toFixed(2) ?? "N/A"}%</p>
@@ -169,7 +184,7 @@ export default function CalibrationPage(props: { ws: WebSocket; message: () => A
         <For each={Array.from({ length: 6 })}>
           {(_, i) => (
             <button
-              onClick={() => props.ws.send(buildStartAccelCalibrationPacket(i()))}
+              onClick={() => props.ws.send(buildStartAccelCalibrationPacket({ axis: i() }))}
               class="rounded-lg px-4 py-2 inset-ring-2 inset-ring-green-400"
               style={{
                 "--percentage": `${accelPercentages()[i()]}%`,
@@ -184,7 +199,7 @@ export default function CalibrationPage(props: { ws: WebSocket; message: () => A
 
       <button
         onClick={() => {
-          props.ws.send(buildAccelCalibrationDataPacket(calibrateAccelerometer(accelPoints())))
+          props.ws.send(buildAccelCalibrationPacket({ bias: calibrateAccelerometer(accelPoints()) }))
           setAccelPercentages([0, 0, 0, 0, 0, 0])
         }}
         class="mt-4 rounded-lg bg-fuchsia-300 px-4 py-2">
@@ -198,6 +213,30 @@ export default function CalibrationPage(props: { ws: WebSocket; message: () => A
         Set North (0°)
       </button>
 
+      <h3 class="text-md mt-6">Raw Capture</h3>
+      <button
+        onClick={() => {
+          if (!capturing()) {
+            captureFrames = []
+            setCaptureSamples(0)
+            props.ws.send(buildCapturePacket({ enabled: true }))
+            return void setCapturing(true)
+          }
+
+          props.ws.send(buildCapturePacket({ enabled: false }))
+          setCapturing(false)
+
+          const link = document.createElement("a")
+          link.href = URL.createObjectURL(new Blob(captureFrames))
+          link.download = `capture-${Date.now()}.cap`
+          link.click()
+          setTimeout(() => URL.revokeObjectURL(link.href))
+        }}
+        class={"mt-1 w-40 rounded-lg px-4 py-2 " + (capturing() ? "bg-red-300" : "bg-orange-200")}>
+        {capturing() ? "Stop & Save" : "Start Capture"}
+      </button>
+      <p class="mt-0.5 text-gray-600">Samples captured: {captureSamples()}</p>
+
       <h3 class="text-md mt-6">Parameters</h3>
       <h4 class="mt-1 text-sm">Gyro Biases</h4>
       <div class="grid grid-cols-3 gap-2">
@@ -481,7 +520,7 @@ export default function CalibrationPage(props: { ws: WebSocket; message: () => A
 
       <div class="mt-4 flex gap-4">
         <button
-          onClick={() => props.ws.send(buildCalibrationDataRequestPacket())}
+          onClick={() => props.ws.send(buildCalibrationRequestPacket())}
           class="rounded-lg bg-yellow-200 px-4 py-2">
           Get
         </button>
@@ -489,7 +528,7 @@ export default function CalibrationPage(props: { ws: WebSocket; message: () => A
           Reset
         </button>
         <button
-          onClick={() => props.ws.send(buildCalibrationDataPacket(calibrationData()))}
+          onClick={() => props.ws.send(buildSetCalibrationPacket(calibrationFromArray(calibrationData())))}
           class="rounded-lg bg-emerald-300 px-4 py-2">
           Save
         </button>
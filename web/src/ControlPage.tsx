@@ -1,6 +1,37 @@
 import { GamepadPlugin, Joystick, PointerPlugin } from "solid-joystick"
-import { createEffect, createSignal, on, Show } from "solid-js"
-import { buildControlPacket, buildUpdateAnchoringPacket, buildUpdateCoeffPacket, getPacketData } from "./packets"
+import { createEffect, createSignal, on, onMount, Show } from "solid-js"
+import {
+  AutotuneResultPacket,
+  buildApplyAutotunePacket,
+  buildControlPacket,
+  buildSetAnchoringPacket,
+  buildSetKdPacket,
+  buildSetKiPacket,
+  buildSetKpPacket,
+  buildSetYawAnchorPacket,
+  buildStartAutotunePacket,
+  buildStartMissionPacket,
+  buildStopAutotunePacket,
+  buildStopMissionPacket,
+  getPacketData,
+  GROUP_NAMES,
+  LoopTimingPacket,
+  MissionProgressPacket,
+  loopJitterPercentile,
+  PROBE_NAMES,
+  StatsPacket,
+  PacketId,
+  parseAnchoringPacket,
+  parseAutotuneProgressPacket,
+  parseAutotuneResultPacket,
+  parseInitPacket,
+  parseLoopTimingPacket,
+  parseMissionProgressPacket,
+  parseStatsPacket,
+  parseTelemetry,
+  parseYawAnchorPacket,
+  Telemetry,
+} from "./packets"
 
 type OnJoystickMove = {
   offset: { pixels: { x: number; y: number }; percentage: { x: number; y: number } }
@@ -8,6 +39,55 @@ type OnJoystickMove = {
   pressure: { pixels: number; percentage: number }
 }
 
+const PLOT_SECONDS = 10
+const CONTROL_INTERVAL_MS = 50
+// AutotunePhase in autotune.h
+const AUTOTUNE_RUNNING = 1
+const AUTOTUNE_RULES = ["Ziegler–Nichols", "Tyreus–Luyben"]
+// MissionState in mission.h
+const MISSION_RUNNING = 1
+
+// PID error and output over the last PLOT_SECONDS, redrawn once per animation frame
+function TelemetryPlot(props: { samples: Telemetry[] }) {
+  let canvas!: HTMLCanvasElement
+
+  onMount(() => {
+    const draw = () => {
+      if (!canvas.isConnected) return
+      const ctx = canvas.getContext("2d")!
+      const { width, height } = canvas
+      ctx.clearRect(0, 0, width, height)
+
+      const samples = props.samples
+      if (samples.length > 1) {
+        const end = samples[samples.length - 1].timestamp
+        const x = (t: number) => width - ((end - t) / (PLOT_SECONDS * 1e6)) * width
+        const y = (v: number, range: number) => height / 2 - (v / range) * (height / 2)
+
+        const line = (color: string, range: number, value: (s: Telemetry) => number | undefined) => {
+          ctx.strokeStyle = color
+          ctx.beginPath()
+          samples.forEach((s, i) => {
+            const v = value(s)
+            if (v === undefined) return
+            if (i === 0) ctx.moveTo(x(s.timestamp), y(v, range))
+            else ctx.lineTo(x(s.timestamp), y(v, range))
+          })
+          ctx.stroke()
+        }
+
+        line("#b91c1c", 90, s => s.pid?.error)
+        line("#1d4ed8", 50, s => s.output?.servo)
+      }
+
+      requestAnimationFrame(draw)
+    }
+    requestAnimationFrame(draw)
+  })
+
+  return <canvas ref={canvas} width={320} height={100} class="my-2 w-full rounded-lg bg-gray-100" />
+}
+
 export default function ControlPage(props: { ws: WebSocket; message: () => ArrayBuffer }) {
   const [anchoring, setAnchoring] = createSignal(false)
   const [kp, setKp] = createSignal(0)
@@ -17,6 +97,14 @@ export default function ControlPage(props: { ws: WebSocket; message: () => Array
   const [settings, setSettings] = createSignal({ speed: 1500, rotation: 0 })
   const [yaw, setYaw] = createSignal(0)
   const [yawAnchor, setYawAnchor] = createSignal(0)
+  const [tuneRule, setTuneRule] = createSignal(0)
+  const [tuneAmplitude, setTuneAmplitude] = createSignal(15)
+  const [tuneProgress, setTuneProgress] = createSignal<number | undefined>()
+  const [tuneResult, setTuneResult] = createSignal<AutotuneResultPacket | undefined>()
+  const [mission, setMission] = createSignal<MissionProgressPacket | undefined>()
+  const [timing, setTiming] = createSignal<LoopTimingPacket | undefined>()
+  const [stats, setStats] = createSignal<StatsPacket | undefined>()
+  let samples: Telemetry[] = []
 
   createEffect(
     on(props.message, buffer => {
@@ -25,18 +113,50 @@ export default function ControlPage(props: { ws: WebSocket; message: () => Array
       const [id, view] = getPacketData(buffer)
       // console.log(id.toString(16), view)
 
-      if (id === 0x01) {
-        setKp(view.getFloat32(0, true))
-        setKi(view.getFloat32(4, true))
-        setKd(view.getFloat32(8, true))
+      if (id === PacketId.Init) {
+        const init = parseInitPacket(view)
+        setKp(init.kp)
+        setKi(init.ki)
+        setKd(init.kd)
       }
 
-      if (id === 0x0a) setAnchoring(!!view.getUint8(0))
-      if (id === 0x10) setYaw(view.getFloat32(0, true))
-      if (id === 0x11) setYawAnchor(view.getFloat32(0, true))
+      if (id === PacketId.Anchoring) setAnchoring(parseAnchoringPacket(view).anchoring)
+      if (id === PacketId.Telemetry) {
+        const telemetry = parseTelemetry(view)
+        if (telemetry.yaw) setYaw(telemetry.yaw.yaw)
+
+        samples.push(telemetry)
+        while (samples[0].timestamp < telemetry.timestamp - PLOT_SECONDS * 1e6) samples.shift()
+      }
+      if (id === PacketId.YawAnchor) setYawAnchor(parseYawAnchorPacket(view).yaw)
+      if (id === PacketId.AutotuneProgress) {
+        const progress = parseAutotuneProgressPacket(view)
+        setTuneProgress(progress.phase === AUTOTUNE_RUNNING ? progress.percentage : undefined)
+      }
+      if (id === PacketId.AutotuneResult) setTuneResult(parseAutotuneResultPacket(view))
+      if (id === PacketId.MissionProgress) setMission(parseMissionProgressPacket(view))
+      if (id === PacketId.LoopTiming) setTiming(parseLoopTimingPacket(view))
+      if (id === PacketId.Stats) setStats(parseStatsPacket(view))
+    })
+  )
+
+  // at most one control packet per CONTROL_INTERVAL_MS, the last one always carries the latest settings
+  let lastControlSent = 0
+  let controlTimer: number | undefined
+  const sendControl = () => {
+    lastControlSent = performance.now()
+    controlTimer = undefined
+    props.ws.send(buildControlPacket({ angle: settings().rotation, speed: settings().speed }))
+  }
+  createEffect(
+    on(settings, () => {
+      if (controlTimer !== undefined) return
+
+      const wait = lastControlSent + CONTROL_INTERVAL_MS - performance.now()
+      if (wait <= 0) sendControl()
+      else controlTimer = setTimeout(sendControl, wait)
     })
   )
-  createEffect(() => props.ws.send(buildControlPacket(settings().rotation, settings().speed)))
 
   return (
     <>
@@ -55,6 +175,28 @@ export default function ControlPage(props: { ws: WebSocket; message: () => Array
         />
       </div>
 
+      <TelemetryPlot samples={samples} />
+
+      <Show when={timing()}>
+        {t => (
+          <p class="font-mono text-xs text-gray-400">
+            {t().periodUs.toFixed(1)} us/sample, jitter p99 &lt; {loopJitterPercentile(t(), 0.99)} us, {t().overruns}{" "}
+            overruns, {t().resyncs} resyncs, max cycle {t().maxCycleUs} us
+          </p>
+        )}
+      </Show>
+      <Show when={stats()}>
+        {s => (
+          <p class="font-mono text-xs text-gray-400">
+            mean/p99 {PROBE_NAMES.map((name, i) => `${name} ${s().meanUs[i].toFixed(0)}/${s().p99Us[i].toFixed(0)}`).join(" ")} us,
+            ws {s().wsDropped}/{s().wsFrames} dropped, {s().wsClosed} closed, queued/dropped per client{" "}
+            {s().wsDepth.map((depth, i) => `${depth}/${s().wsClientDropped[i]}`).join(" ")}, heap {(s().freeHeap / 1024).toFixed(0)}k (min{" "}
+            {(s().minFreeHeap / 1024).toFixed(0)}k), load/overruns{" "}
+            {GROUP_NAMES.map((name, i) => `${name} ${s().groupLoad[i].toFixed(1)}%/${s().groupOverruns[i]}`).join(" ")}
+          </p>
+        )}
+      </Show>
+
       <div class="w-full grow" />
 
       <div class="mb-1 flex w-full flex-row items-center justify-center gap-2">
@@ -69,7 +211,7 @@ export default function ControlPage(props: { ws: WebSocket; message: () => Array
           class="w-full"
           onInput={e => {
             setKp(e.target.valueAsNumber)
-            props.ws.send(buildUpdateCoeffPacket("p", e.target.valueAsNumber))
+            props.ws.send(buildSetKpPacket({ value: e.target.valueAsNumber }))
           }}
         />
       </div>
@@ -85,7 +227,7 @@ export default function ControlPage(props: { ws: WebSocket; message: () => Array
           class="w-full"
           onInput={e => {
             setKi(e.target.valueAsNumber)
-            props.ws.send(buildUpdateCoeffPacket("i", e.target.valueAsNumber))
+            props.ws.send(buildSetKiPacket({ value: e.target.valueAsNumber }))
           }}
         />
       </div> */}
@@ -101,11 +243,77 @@ export default function ControlPage(props: { ws: WebSocket; message: () => Array
           class="w-full"
           onInput={e => {
             setKd(e.target.valueAsNumber)
-            props.ws.send(buildUpdateCoeffPacket("d", e.target.valueAsNumber))
+            props.ws.send(buildSetKdPacket({ value: e.target.valueAsNumber }))
           }}
         />
       </div>
 
+      <div class="mb-1 flex w-full flex-row items-center justify-center gap-2">
+        <label class="text-nowrap">Autotune:</label>
+        <select
+          class="rounded-sm bg-gray-300"
+          name="Autotune Rule"
+          value={tuneRule()}
+          onInput={e => setTuneRule(+e.target.value)}>
+          {AUTOTUNE_RULES.map((name, i) => (
+            <option value={i}>{name}</option>
+          ))}
+        </select>
+        <input
+          class="w-14 rounded-sm bg-gray-300"
+          name="Relay Amplitude"
+          type="number"
+          value={tuneAmplitude()}
+          onInput={e => !isNaN(+e.target.value) && setTuneAmplitude(+e.target.value)}
+        />
+        °
+        <button
+          onClick={() => {
+            if (tuneProgress() !== undefined) return props.ws.send(buildStopAutotunePacket())
+
+            setTuneResult()
+            setTuneProgress(0)
+            props.ws.send(
+              buildStartAutotunePacket({ amplitude: tuneAmplitude(), hysteresis: 0.5, cycles: 4, rule: tuneRule() })
+            )
+          }}
+          class="rounded-lg bg-amber-300 px-3 py-1">
+          {tuneProgress() !== undefined ? `Stop ${tuneProgress()!.toFixed(0)}%` : "Start"}
+        </button>
+      </div>
+      <Show when={tuneResult()}>
+        {result => (
+          <div class="mb-4 flex w-full flex-row items-center justify-center gap-2 font-mono text-sm">
+            Ku {result().ku.toFixed(2)} Tu {result().tu.toFixed(2)}s → P {result().kp.toFixed(2)} I{" "}
+            {result().ki.toFixed(2)} D {result().kd.toFixed(2)}
+            <button
+              onClick={() => props.ws.send(buildApplyAutotunePacket())}
+              class="rounded-lg bg-emerald-300 px-3 py-1 font-sans">
+              Apply
+            </button>
+          </div>
+        )}
+      </Show>
+
+      <div class="mb-4 flex w-full flex-row items-center justify-center gap-2">
+        <label class="text-nowrap">Mission:</label>
+        <Show when={mission()?.state === MISSION_RUNNING}>
+          <span class="font-mono text-sm">
+            leg {mission()!.leg + 1}/{mission()!.legs} {mission()!.elapsed.toFixed(0)}/
+            {mission()!.duration.toFixed(0)}s {mission()!.heading.toFixed(0)}° {mission()!.speed.toFixed(0)}%
+          </span>
+        </Show>
+        <button
+          onClick={() =>
+            props.ws.send(
+              mission()?.state === MISSION_RUNNING ? buildStopMissionPacket() : buildStartMissionPacket()
+            )
+          }
+          class="rounded-lg bg-amber-300 px-3 py-1">
+          {mission()?.state === MISSION_RUNNING ? "Stop" : "Start"}
+        </button>
+      </div>
+
       <div class="mb-4 flex w-full flex-row items-center justify-center">
         <label for="anchoring" class="me-2 text-nowrap">
           Anchoring:
@@ -118,7 +326,7 @@ export default function ControlPage(props: { ws: WebSocket; message: () => Array
           class="me-4"
           onInput={e => {
             setAnchoring(e.target.checked)
-            props.ws.send(buildUpdateAnchoringPacket(anchoring()))
+            props.ws.send(buildSetAnchoringPacket({ anchoring: anchoring() }))
           }}
         />
         at:
@@ -131,7 +339,7 @@ export default function ControlPage(props: { ws: WebSocket; message: () => Array
           onInput={e => {
             if (!isNaN(+e.target.value) && yawAnchor() !== +e.target.value) {
               setYawAnchor(+e.target.value)
-              props.ws.send(buildUpdateAnchoringPacket(yawAnchor()))
+              props.ws.send(buildSetYawAnchorPacket({ yaw: yawAnchor() }))
             }
           }}
         />
@@ -1,117 +1,139 @@
-import { MagCalibrationData, Point } from "./math"
-
-function makePacketView(id: number, size: number) {
-  console.log(`sending packet with id 0x${id.toString(16)}`)
-
-  const buffer = new ArrayBuffer(1 + size)
-  const view = new DataView(buffer)
-
-  view.setUint8(0, id)
-
-  const packetView = new DataView(buffer, 1)
-
-  return [buffer, packetView] as const
-}
-
-export function buildControlPacket(angle: number, speed: number) {
-  const [buffer, view] = makePacketView(0x0c, 4 + 4)
-
-  view.setFloat32(0, angle, true)
-  view.setFloat32(4, speed, true)
-
-  return buffer
-}
-
-export function buildUpdateAnchoringPacket(yawAnchor: number): ArrayBuffer
-export function buildUpdateAnchoringPacket(anchoring: boolean): ArrayBuffer
-export function buildUpdateAnchoringPacket(value: number | boolean): ArrayBuffer {
-  if (value === true || value === false) {
-    const [buffer, view] = makePacketView(0x0a, 1)
-    view.setUint8(0, +value)
-
-    return buffer
+import { MagCalibrationData } from "./math"
+import {
+  buildSubscribePacket,
+  CalibrationPacket,
+  LoopTimingPacket,
+  MagCalibrationStatusPacket,
+  PacketId as SchemaPacketId,
+  SetCalibrationPacket,
+} from "./schema"
+
+// Fixed-layout packets are generated from the firmware schema, see schema.ts
+export * from "./schema"
+
+export const PacketId = {
+  ...SchemaPacketId,
+  Message: 0xbb,
+  Telemetry: 0x20,
+  CaptureData: 0x31,
+} as const
+
+// The fit runs on the boat, the page only displays it
+export function magCalibrationFromStatus(status: MagCalibrationStatusPacket): MagCalibrationData {
+  return {
+    offset: status.offset as [number, number, number],
+    matrix: [status.scale.slice(0, 3), status.scale.slice(3, 6), status.scale.slice(6, 9)],
+    fitError: status.fitError,
+    fieldStrength: status.fieldStrength,
   }
-
-  const [buffer, view] = makePacketView(0x0a, 4)
-  view.setFloat32(0, value, true)
-
-  return buffer
-}
-
-export function buildUpdateCoeffPacket(coeff: "p" | "i" | "d", value: number) {
-  const [buffer, view] = makePacketView(coeff.charCodeAt(0), 4)
-
-  view.setFloat32(0, value, true)
-
-  return buffer
-}
-
-export function buildStartAccelCalibrationPacket(i: number) {
-  const [buffer, view] = makePacketView(0xc4, 1)
-
-  view.setUint8(0, i)
-
-  return buffer
-}
-
-export function buildStartMagCalibrationPacket() {
-  const [buffer, _] = makePacketView(0xc3, 0)
-  return buffer
 }
 
-export function buildStartGyroCalibrationPacket() {
-  const [buffer, _] = makePacketView(0xc2, 0)
-  return buffer
-}
-
-export function buildMagCalibrationDataPacket(data: MagCalibrationData) {
-  const [buffer, view] = makePacketView(0xc1, 12 * 4)
+// PROBE_LIST in metrics.h, the order of the Stats arrays
+export const PROBE_NAMES = ["i2c", "calibration", "fusion", "callback", "pid", "loop"] as const
 
-  const values = data.offset.concat(data.matrix.flatMap(r => r))
-  values.forEach((n, i) => view.setFloat32(i * 4, n, true))
+// RATE_GROUP_LIST in executive.h, the order of groupLoad and groupOverruns
+export const GROUP_NAMES = ["sensor", "control", "telemetry", "housekeeping"] as const
 
-  return buffer
-}
-
-export function buildMagCalibrationStopPacket() {
-  const [buffer, _] = makePacketView(0xc1, 0)
-  return buffer
-}
+// TIMING_BIN_US in acquisition.h; the last bin is open ended
+const TIMING_BIN_US = 100
 
-export function buildAccelCalibrationDataPacket(biases: Point) {
-  const [buffer, view] = makePacketView(0xc5, 3 * 4)
+// Upper edge of the jitter bin below which `fraction` of the wake-ups fall,
+// Infinity when that is the open last bin.
+export function loopJitterPercentile(timing: LoopTimingPacket, fraction: number) {
+  const total = timing.jitter.reduce((sum, count) => sum + count, 0)
+  let seen = 0
 
-  biases.forEach((n, i) => view.setFloat32(i * 4, n, true))
-
-  return buffer
+  for (let i = 0; i < timing.jitter.length - 1; i++) {
+    seen += timing.jitter[i]
+    if (seen >= total * fraction) return (i + 1) * TIMING_BIN_US
+  }
+  return Infinity
 }
 
-export function buildCalibrationDataRequestPacket() {
-  const [buffer, _] = makePacketView(0xa0, 0)
-  return buffer
+// The calibration page edits the 21 calibration values as one flat list
+export function calibrationToArray(packet: CalibrationPacket) {
+  return [...packet.gyro, ...packet.accel, ...packet.mag, ...packet.magScale, packet.north, packet.servoMiddle, packet.maxAPSpeed]
 }
 
-export function buildCalibrationDataPacket(calibrationData: number[]) {
-  const [buffer, view] = makePacketView(0xa1, 21 * 4)
-
-  calibrationData.forEach((n, i) => view.setFloat32(i * 4, n, true))
-
-  return buffer
+export function calibrationFromArray(values: number[]): SetCalibrationPacket {
+  return {
+    gyro: values.slice(0, 3),
+    accel: values.slice(3, 6),
+    mag: values.slice(6, 9),
+    magScale: values.slice(9, 18),
+    north: values[18],
+    servoMiddle: values[19],
+    maxAPSpeed: values[20],
+  }
 }
 
-export function buildSetNorthPacket() {
-  const [buffer, _] = makePacketView(0xc9, 0)
-  return buffer
-}
+export const TelemetryChannel = {
+  YAW: 0,
+  YAW_RATE: 1,
+  PID: 2,
+  OUTPUT: 3,
+  RAW: 4,
+  CAL: 5,
+} as const
+const TELEMETRY_CHANNELS = 6
+const TELEMETRY_SIZES = [2, 1, 5, 2, 10, 9]
+
+// optional streams (WSStream in include/ws_queue.h), the rest goes to every page
+export const Stream = {
+  STATS: 1 << 0,
+  AUTOTUNE: 1 << 1,
+  CALIBRATION: 1 << 2,
+  CAPTURE: 1 << 3,
+  MISSION: 1 << 4,
+} as const
+
+// decimations relative to the 100 Hz telemetry tick, channels left out are off
+export function buildSubscription(
+  decimations: Partial<Record<keyof typeof TelemetryChannel, number>>,
+  streams: (keyof typeof Stream)[]
+) {
+  const decimation = Array<number>(TELEMETRY_CHANNELS).fill(0)
+
+  for (const [name, value] of Object.entries(decimations))
+    decimation[TelemetryChannel[name as keyof typeof TelemetryChannel]] = value
+
+  return buildSubscribePacket({ decimation, streams: streams.reduce((mask, name) => mask | Stream[name], 0) })
+}
+
+export type Telemetry = {
+  timestamp: number
+  yaw?: { yaw: number; anchor: number }
+  yawRate?: number
+  pid?: { error: number; p: number; i: number; d: number; output: number }
+  output?: { servo: number; motor: number }
+  raw?: number[]
+  cal?: number[]
+}
+
+// view starts after the 0x20 id
+export function parseTelemetry(view: DataView): Telemetry {
+  const mask = view.getUint16(4, true)
+  const channels: number[][] = []
+  let offset = 6
+
+  for (let i = 0; i < TELEMETRY_CHANNELS; i++) {
+    if (!(mask & (1 << i))) continue
+
+    channels[i] = Array.from({ length: TELEMETRY_SIZES[i] }).map((_, j) => view.getFloat32(offset + j * 4, true))
+    offset += TELEMETRY_SIZES[i] * 4
+  }
 
-export function buildInitPacket() {
-  const [buffer, _] = makePacketView(0x01, 0)
-  return buffer
-}
+  const [yaw, yawRate, pid, output, raw, cal] = channels
 
-export function buildPingPacket() {
-  const [buffer, _] = makePacketView(0xff, 0)
-  return buffer
+  return {
+    timestamp: view.getUint32(0, true),
+    yaw: yaw && { yaw: yaw[0], anchor: yaw[1] },
+    yawRate: yawRate?.[0],
+    pid: pid && { error: pid[0], p: pid[1], i: pid[2], d: pid[3], output: pid[4] },
+    output: output && { servo: output[0], motor: output[1] },
+    raw,
+    cal,
+  }
 }
 
 export function getPacketData(packet: ArrayBuffer) {
@@ -0,0 +1,575 @@
+// Generated by `program schema` from include/packet_schema.h, do not edit.
+
+export const PacketId = {
+  InitRequest: 0x01,
+  Init: 0x01,
+  SetAnchoring: 0x0a,
+  Anchoring: 0x0a,
+  Control: 0x0c,
+  SetYawAnchor: 0x11,
+  YawAnchor: 0x11,
+  Subscribe: 0x21,
+  LoopTiming: 0x22,
+  Stats: 0x23,
+  Capture: 0x30,
+  StartAutotune: 0x40,
+  AutotuneProgress: 0x40,
+  StopAutotune: 0x41,
+  AutotuneResult: 0x41,
+  ApplyAutotune: 0x42,
+  SetMission: 0x50,
+  Mission: 0x50,
+  MissionRequest: 0x51,
+  StartMission: 0x52,
+  MissionProgress: 0x52,
+  StopMission: 0x53,
+  SetKp: 0x70,
+  SetKi: 0x69,
+  SetKd: 0x64,
+  CalibrationRequest: 0xa0,
+  Calibration: 0xa0,
+  SetCalibration: 0xa1,
+  ParamsRequest: 0xa2,
+  Params: 0xa2,
+  SetParams: 0xa3,
+  MagCalibration: 0xc1,
+  StartGyroCalibration: 0xc2,
+  GyroCalibrationProgress: 0xc2,
+  StartMagCalibration: 0xc3,
+  MagCalibrationStatus: 0xc3,
+  StartAccelCalibration: 0xc4,
+  AccelCalibration: 0xc5,
+  AccelCalibrationProgress: 0xc6,
+  AccelCalibrationData: 0xc7,
+  StopMagCalibration: 0xc8,
+  SetNorth: 0xc9,
+  Ping: 0xff,
+} as const
+
+export const ParamNames = [
+  "gyroX",
+  "gyroY",
+  "gyroZ",
+  "accelX",
+  "accelY",
+  "accelZ",
+  "magX",
+  "magY",
+  "magZ",
+  "magScale0",
+  "magScale1",
+  "magScale2",
+  "magScale3",
+  "magScale4",
+  "magScale5",
+  "magScale6",
+  "magScale7",
+  "magScale8",
+  "north",
+  "servoMiddle",
+  "maxAPSpeed",
+  "kp",
+  "ki",
+  "kd",
+  "gyroTempRef",
+  "gyroSlopeX",
+  "gyroSlopeY",
+  "gyroSlopeZ",
+] as const
+export const ParamsPerPacket = 16
+
+export function buildInitRequestPacket() {
+  const buffer = new ArrayBuffer(1)
+  const view = new DataView(buffer)
+
+  view.setUint8(0, PacketId.InitRequest)
+
+  return buffer
+}
+
+export type InitPacket = { kp: number; ki: number; kd: number }
+
+export function parseInitPacket(view: DataView): InitPacket {
+  return {
+    kp: view.getFloat32(0, true),
+    ki: view.getFloat32(4, true),
+    kd: view.getFloat32(8, true),
+  }
+}
+
+export type SetAnchoringPacket = { anchoring: boolean }
+
+export function buildSetAnchoringPacket(packet: SetAnchoringPacket) {
+  const buffer = new ArrayBuffer(2)
+  const view = new DataView(buffer)
+
+  view.setUint8(0, PacketId.SetAnchoring)
+  view.setUint8(1, +packet.anchoring)
+
+  return buffer
+}
+
+export type AnchoringPacket = { anchoring: boolean }
+
+export function parseAnchoringPacket(view: DataView): AnchoringPacket {
+  return {
+    anchoring: !!view.getUint8(0),
+  }
+}
+
+export type ControlPacket = { angle: number; speed: number }
+
+export function buildControlPacket(packet: ControlPacket) {
+  const buffer = new ArrayBuffer(9)
+  const view = new DataView(buffer)
+
+  view.setUint8(0, PacketId.Control)
+  view.setFloat32(1, packet.angle, true)
+  view.setFloat32(5, packet.speed, true)
+
+  return buffer
+}
+
+export type SetYawAnchorPacket = { yaw: number }
+
+export function buildSetYawAnchorPacket(packet: SetYawAnchorPacket) {
+  const buffer = new ArrayBuffer(5)
+  const view = new DataView(buffer)
+
+  view.setUint8(0, PacketId.SetYawAnchor)
+  view.setFloat32(1, packet.yaw, true)
+
+  return buffer
+}
+
+export type YawAnchorPacket = { yaw: number }
+
+export function parseYawAnchorPacket(view: DataView): YawAnchorPacket {
+  return {
+    yaw: view.getFloat32(0, true),
+  }
+}
+
+export type SubscribePacket = { decimation: number[]; streams: number }
+
+export function buildSubscribePacket(packet: SubscribePacket) {
+  const buffer = new ArrayBuffer(8)
+  const view = new DataView(buffer)
+
+  view.setUint8(0, PacketId.Subscribe)
+  packet.decimation.forEach((n, i) => view.setUint8(1 + i * 1, n))
+  view.setUint8(7, packet.streams)
+
+  return buffer
+}
+
+export type LoopTimingPacket = { periodUs: number; wakes: number; overruns: number; resyncs: number; maxCycleUs: number; jitter: number[] }
+
+export function parseLoopTimingPacket(view: DataView): LoopTimingPacket {
+  return {
+    periodUs: view.getFloat32(0, true),
+    wakes: view.getUint32(4, true),
+    overruns: view.getUint32(8, true),
+    resyncs: view.getUint32(12, true),
+    maxCycleUs: view.getUint32(16, true),
+    jitter: Array.from({ length: 12 }, (_, i) => view.getUint32(20 + i * 4, true)),
+  }
+}
+
+export type StatsPacket = { meanUs: number[]; p99Us: number[]; maxUs: number[]; wsFrames: number; wsDropped: number; wsClosed: number; wsDepth: number[]; wsClientDropped: number[]; packetsDropped: number; freeHeap: number; minFreeHeap: number; groupLoad: number[]; groupOverruns: number[] }
+
+export function parseStatsPacket(view: DataView): StatsPacket {
+  return {
+    meanUs: Array.from({ length: 6 }, (_, i) => view.getFloat32(0 + i * 4, true)),
+    p99Us: Array.from({ length: 6 }, (_, i) => view.getFloat32(24 + i * 4, true)),
+    maxUs: Array.from({ length: 6 }, (_, i) => view.getFloat32(48 + i * 4, true)),
+    wsFrames: view.getUint32(72, true),
+    wsDropped: view.getUint32(76, true),
+    wsClosed: view.getUint32(80, true),
+    wsDepth: Array.from({ length: 4 }, (_, i) => view.getUint32(84 + i * 4, true)),
+    wsClientDropped: Array.from({ length: 4 }, (_, i) => view.getUint32(100 + i * 4, true)),
+    packetsDropped: view.getUint32(116, true),
+    freeHeap: view.getUint32(120, true),
+    minFreeHeap: view.getUint32(124, true),
+    groupLoad: Array.from({ length: 4 }, (_, i) => view.getFloat32(128 + i * 4, true)),
+    groupOverruns: Array.from({ length: 4 }, (_, i) => view.getUint32(144 + i * 4, true)),
+  }
+}
+
+export type CapturePacket = { enabled: boolean }
+
+export function buildCapturePacket(packet: CapturePacket) {
+  const buffer = new ArrayBuffer(2)
+  const view = new DataView(buffer)
+
+  view.setUint8(0, PacketId.Capture)
+  view.setUint8(1, +packet.enabled)
+
+  return buffer
+}
+
+export type StartAutotunePacket = { amplitude: number; hysteresis: number; cycles: number; rule: number }
+
+export function buildStartAutotunePacket(packet: StartAutotunePacket) {
+  const buffer = new ArrayBuffer(11)
+  const view = new DataView(buffer)
+
+  view.setUint8(0, PacketId.StartAutotune)
+  view.setFloat32(1, packet.amplitude, true)
+  view.setFloat32(5, packet.hysteresis, true)
+  view.setUint8(9, packet.cycles)
+  view.setUint8(10, packet.rule)
+
+  return buffer
+}
+
+export type AutotuneProgressPacket = { phase: number; percentage: number }
+
+export function parseAutotuneProgressPacket(view: DataView): AutotuneProgressPacket {
+  return {
+    phase: view.getUint8(0),
+    percentage: view.getFloat32(1, true),
+  }
+}
+
+export function buildStopAutotunePacket() {
+  const buffer = new ArrayBuffer(1)
+  const view = new DataView(buffer)
+
+  view.setUint8(0, PacketId.StopAutotune)
+
+  return buffer
+}
+
+export type AutotuneResultPacket = { ku: number; tu: number; kp: number; ki: number; kd: number }
+
+export function parseAutotuneResultPacket(view: DataView): AutotuneResultPacket {
+  return {
+    ku: view.getFloat32(0, true),
+    tu: view.getFloat32(4, true),
+    kp: view.getFloat32(8, true),
+    ki: view.getFloat32(12, true),
+    kd: view.getFloat32(16, true),
+  }
+}
+
+export function buildApplyAutotunePacket() {
+  const buffer = new ArrayBuffer(1)
+  const view = new DataView(buffer)
+
+  view.setUint8(0, PacketId.ApplyAutotune)
+
+  return buffer
+}
+
+export type SetMissionPacket = { first: number; count: number; total: number; headingMode: number[]; speedProfile: number[]; heading: number[]; speed: number[]; duration: number[]; turnRate: number[] }
+
+export function buildSetMissionPacket(packet: SetMissionPacket) {
+  const buffer = new ArrayBuffer(76)
+  const view = new DataView(buffer)
+
+  view.setUint8(0, PacketId.SetMission)
+  view.setUint8(1, packet.first)
+  view.setUint8(2, packet.count)
+  view.setUint8(3, packet.total)
+  packet.headingMode.forEach((n, i) => view.setUint8(4 + i * 1, n))
+  packet.speedProfile.forEach((n, i) => view.setUint8(8 + i * 1, n))
+  packet.heading.forEach((n, i) => view.setFloat32(12 + i * 4, n, true))
+  packet.speed.forEach((n, i) => view.setFloat32(28 + i * 4, n, true))
+  packet.duration.forEach((n, i) => view.setFloat32(44 + i * 4, n, true))
+  packet.turnRate.forEach((n, i) => view.setFloat32(60 + i * 4, n, true))
+
+  return buffer
+}
+
+export type MissionPacket = { first: number; count: number; total: number; headingMode: number[]; speedProfile: number[]; heading: number[]; speed: number[]; duration: number[]; turnRate: number[] }
+
+export function parseMissionPacket(view: DataView): MissionPacket {
+  return {
+    first: view.getUint8(0),
+    count: view.getUint8(1),
+    total: view.getUint8(2),
+    headingMode: Array.from({ length: 4 }, (_, i) => view.getUint8(3 + i * 1)),
+    speedProfile: Array.from({ length: 4 }, (_, i) => view.getUint8(7 + i * 1)),
+    heading: Array.from({ length: 4 }, (_, i) => view.getFloat32(11 + i * 4, true)),
+    speed: Array.from({ length: 4 }, (_, i) => view.getFloat32(27 + i * 4, true)),
+    duration: Array.from({ length: 4 }, (_, i) => view.getFloat32(43 + i * 4, true)),
+    turnRate: Array.from({ length: 4 }, (_, i) => view.getFloat32(59 + i * 4, true)),
+  }
+}
+
+export function buildMissionRequestPacket() {
+  const buffer = new ArrayBuffer(1)
+  const view = new DataView(buffer)
+
+  view.setUint8(0, PacketId.MissionRequest)
+
+  return buffer
+}
+
+export function buildStartMissionPacket() {
+  const buffer = new ArrayBuffer(1)
+  const view = new DataView(buffer)
+
+  view.setUint8(0, PacketId.StartMission)
+
+  return buffer
+}
+
+export type MissionProgressPacket = { state: number; leg: number; legs: number; elapsed: number; duration: number; heading: number; speed: number }
+
+export function parseMissionProgressPacket(view: DataView): MissionProgressPacket {
+  return {
+    state: view.getUint8(0),
+    leg: view.getUint8(1),
+    legs: view.getUint8(2),
+    elapsed: view.getFloat32(3, true),
+    duration: view.getFloat32(7, true),
+    heading: view.getFloat32(11, true),
+    speed: view.getFloat32(15, true),
+  }
+}
+
+export function buildStopMissionPacket() {
+  const buffer = new ArrayBuffer(1)
+  const view = new DataView(buffer)
+
+  view.setUint8(0, PacketId.StopMission)
+
+  return buffer
+}
+
+export type SetKpPacket = { value: number }
+
+export function buildSetKpPacket(packet: SetKpPacket) {
+  const buffer = new ArrayBuffer(5)
+  const view = new DataView(buffer)
+
+  view.setUint8(0, PacketId.SetKp)
+  view.setFloat32(1, packet.value, true)
+
+  return buffer
+}
+
+export type SetKiPacket = { value: number }
+
+export function buildSetKiPacket(packet: SetKiPacket) {
+  const buffer = new ArrayBuffer(5)
+  const view = new DataView(buffer)
+
+  view.setUint8(0, PacketId.SetKi)
+  view.setFloat32(1, packet.value, true)
+
+  return buffer
+}
+
+export type SetKdPacket = { value: number }
+
+export function buildSetKdPacket(packet: SetKdPacket) {
+  const buffer = new ArrayBuffer(5)
+  const view = new DataView(buffer)
+
+  view.setUint8(0, PacketId.SetKd)
+  view.setFloat32(1, packet.value, true)
+
+  return buffer
+}
+
+export function buildCalibrationRequestPacket() {
+  const buffer = new ArrayBuffer(1)
+  const view = new DataView(buffer)
+
+  view.setUint8(0, PacketId.CalibrationRequest)
+
+  return buffer
+}
+
+export type CalibrationPacket = { gyro: number[]; accel: number[]; mag: number[]; magScale: number[]; north: number; servoMiddle: number; maxAPSpeed: number }
+
+export function parseCalibrationPacket(view: DataView): CalibrationPacket {
+  return {
+    gyro: Array.from({ length: 3 }, (_, i) => view.getFloat32(0 + i * 4, true)),
+    accel: Array.from({ length: 3 }, (_, i) => view.getFloat32(12 + i * 4, true)),
+    mag: Array.from({ length: 3 }, (_, i) => view.getFloat32(24 + i * 4, true)),
+    magScale: Array.from({ length: 9 }, (_, i) => view.getFloat32(36 + i * 4, true)),
+    north: view.getFloat32(72, true),
+    servoMiddle: view.getFloat32(76, true),
+    maxAPSpeed: view.getFloat32(80, true),
+  }
+}
+
+export type SetCalibrationPacket = { gyro: number[]; accel: number[]; mag: number[]; magScale: number[]; north: number; servoMiddle: number; maxAPSpeed: number }
+
+export function buildSetCalibrationPacket(packet: SetCalibrationPacket) {
+  const buffer = new ArrayBuffer(85)
+  const view = new DataView(buffer)
+
+  view.setUint8(0, PacketId.SetCalibration)
+  packet.gyro.forEach((n, i) => view.setFloat32(1 + i * 4, n, true))
+  packet.accel.forEach((n, i) => view.setFloat32(13 + i * 4, n, true))
+  packet.mag.forEach((n, i) => view.setFloat32(25 + i * 4, n, true))
+  packet.magScale.forEach((n, i) => view.setFloat32(37 + i * 4, n, true))
+  view.setFloat32(73, packet.north, true)
+  view.setFloat32(77, packet.servoMiddle, true)
+  view.setFloat32(81, packet.maxAPSpeed, true)
+
+  return buffer
+}
+
+export function buildParamsRequestPacket() {
+  const buffer = new ArrayBuffer(1)
+  const view = new DataView(buffer)
+
+  view.setUint8(0, PacketId.ParamsRequest)
+
+  return buffer
+}
+
+export type ParamsPacket = { first: number; count: number; values: number[] }
+
+export function parseParamsPacket(view: DataView): ParamsPacket {
+  return {
+    first: view.getUint8(0),
+    count: view.getUint8(1),
+    values: Array.from({ length: 16 }, (_, i) => view.getFloat32(2 + i * 4, true)),
+  }
+}
+
+export type SetParamsPacket = { first: number; count: number; values: number[] }
+
+export function buildSetParamsPacket(packet: SetParamsPacket) {
+  const buffer = new ArrayBuffer(67)
+  const view = new DataView(buffer)
+
+  view.setUint8(0, PacketId.SetParams)
+  view.setUint8(1, packet.first)
+  view.setUint8(2, packet.count)
+  packet.values.forEach((n, i) => view.setFloat32(3 + i * 4, n, true))
+
+  return buffer
+}
+
+export type MagCalibrationPacket = { offset: number[]; scale: number[] }
+
+export function buildMagCalibrationPacket(packet: MagCalibrationPacket) {
+  const buffer = new ArrayBuffer(49)
+  const view = new DataView(buffer)
+
+  view.setUint8(0, PacketId.MagCalibration)
+  packet.offset.forEach((n, i) => view.setFloat32(1 + i * 4, n, true))
+  packet.scale.forEach((n, i) => view.setFloat32(13 + i * 4, n, true))
+
+  return buffer
+}
+
+export function buildStartGyroCalibrationPacket() {
+  const buffer = new ArrayBuffer(1)
+  const view = new DataView(buffer)
+
+  view.setUint8(0, PacketId.StartGyroCalibration)
+
+  return buffer
+}
+
+export type GyroCalibrationProgressPacket = { percentage: number }
+
+export function parseGyroCalibrationProgressPacket(view: DataView): GyroCalibrationProgressPacket {
+  return {
+    percentage: view.getFloat32(0, true),
+  }
+}
+
+export function buildStartMagCalibrationPacket() {
+  const buffer = new ArrayBuffer(1)
+  const view = new DataView(buffer)
+
+  view.setUint8(0, PacketId.StartMagCalibration)
+
+  return buffer
+}
+
+export type MagCalibrationStatusPacket = { points: number; fitError: number; fieldStrength: number; offset: number[]; scale: number[] }
+
+export function parseMagCalibrationStatusPacket(view: DataView): MagCalibrationStatusPacket {
+  return {
+    points: view.getUint32(0, true),
+    fitError: view.getFloat32(4, true),
+    fieldStrength: view.getFloat32(8, true),
+    offset: Array.from({ length: 3 }, (_, i) => view.getFloat32(12 + i * 4, true)),
+    scale: Array.from({ length: 9 }, (_, i) => view.getFloat32(24 + i * 4, true)),
+  }
+}
+
+export type StartAccelCalibrationPacket = { axis: number }
+
+export function buildStartAccelCalibrationPacket(packet: StartAccelCalibrationPacket) {
+  const buffer = new ArrayBuffer(2)
+  const view = new DataView(buffer)
+
+  view.setUint8(0, PacketId.StartAccelCalibration)
+  view.setUint8(1, packet.axis)
+
+  return buffer
+}
+
+export type AccelCalibrationPacket = { bias: number[] }
+
+export function buildAccelCalibrationPacket(packet: AccelCalibrationPacket) {
+  const buffer = new ArrayBuffer(13)
+  const view = new DataView(buffer)
+
+  view.setUint8(0, PacketId.AccelCalibration)
+  packet.bias.forEach((n, i) => view.setFloat32(1 + i * 4, n, true))
+
+  return buffer
+}
+
+export type AccelCalibrationProgressPacket = { percentage: number; axis: number }
+
+export function parseAccelCalibrationProgressPacket(view: DataView): AccelCalibrationProgressPacket {
+  return {
+    percentage: view.getFloat32(0, true),
+    axis: view.getUint8(4),
+  }
+}
+
+export type AccelCalibrationDataPacket = { axis: number; ax: number; ay: number; az: number }
+
+export function parseAccelCalibrationDataPacket(view: DataView): AccelCalibrationDataPacket {
+  return {
+    axis: view.getUint8(0),
+    ax: view.getFloat32(1, true),
+    ay: view.getFloat32(5, true),
+    az: view.getFloat32(9, true),
+  }
+}
+
+export type StopMagCalibrationPacket = { apply: boolean }
+
+export function buildStopMagCalibrationPacket(packet: StopMagCalibrationPacket) {
+  const buffer = new ArrayBuffer(2)
+  const view = new DataView(buffer)
+
+  view.setUint8(0, PacketId.StopMagCalibration)
+  view.setUint8(1, +packet.apply)
+
+  return buffer
+}
+
+export function buildSetNorthPacket() {
+  const buffer = new ArrayBuffer(1)
+  const view = new DataView(buffer)
+
+  view.setUint8(0, PacketId.SetNorth)
+
+  return buffer
+}
+
+export function buildPingPacket() {
+  const buffer = new ArrayBuffer(1)
+  const view = new DataView(buffer)
+
+  view.setUint8(0, PacketId.Ping)
+
+  return buffer
+}